@@ -0,0 +1,132 @@
+#include "change_tracker.h"
+#include <algorithm>
+
+ChangeTracker::ChangeTracker()
+    : m_channels(ChannelCount)
+{
+}
+
+ChangeTracker::Frame ChangeTracker::getCurrentFrame() const {
+    return m_currentFrame;
+}
+
+ChangeTracker::Frame ChangeTracker::advanceFrame() {
+    return ++m_currentFrame;
+}
+
+void ChangeTracker::recordChange(EntityId id, ComponentType type) {
+    record(channelIndex(type), id);
+}
+
+void ChangeTracker::recordChange(EntityId id, Structural change) {
+    record(channelIndex(change), id);
+}
+
+quint64 ChangeTracker::getVersion(ComponentType type) const {
+    return m_channels[channelIndex(type)].version;
+}
+
+quint64 ChangeTracker::getVersion(Structural change) const {
+    return m_channels[channelIndex(change)].version;
+}
+
+bool ChangeTracker::getChangedSince(ComponentType type, Frame sinceFrame, QVector<EntityId>& out) const {
+    return collect(channelIndex(type), sinceFrame, out);
+}
+
+bool ChangeTracker::getChangedSince(Structural change, Frame sinceFrame, QVector<EntityId>& out) const {
+    return collect(channelIndex(change), sinceFrame, out);
+}
+
+bool ChangeTracker::hasChangesSince(Frame sinceFrame) const {
+    return sinceFrame < m_oldestFrame || m_lastChangeFrame >= sinceFrame;
+}
+
+void ChangeTracker::discardBefore(Frame frame) {
+    if (frame <= m_oldestFrame) {
+        return;
+    }
+
+    for (Channel& channel : m_channels) {
+        while (channel.journalStart < channel.journal.size() &&
+               channel.journal[channel.journalStart].frame < frame) {
+            const Entry& entry = channel.journal[channel.journalStart];
+            auto it = channel.lastChange.find(entry.id);
+            if (it != channel.lastChange.end() && it.value() == entry.frame) {
+                channel.lastChange.erase(it);
+            }
+            ++channel.journalStart;
+        }
+
+        // Compact once the discarded prefix dominates the journal
+        if (channel.journalStart > channel.journal.size() / 2) {
+            channel.journal.remove(0, channel.journalStart);
+            channel.journalStart = 0;
+        }
+    }
+
+    m_oldestFrame = frame;
+}
+
+ChangeTracker::Frame ChangeTracker::getOldestFrame() const {
+    return m_oldestFrame;
+}
+
+void ChangeTracker::clear() {
+    for (Channel& channel : m_channels) {
+        channel.journal.clear();
+        channel.journalStart = 0;
+        channel.lastChange.clear();
+        ++channel.version;
+    }
+
+    // Everything recorded so far is gone, so every consumer has to rescan
+    m_oldestFrame = ++m_currentFrame;
+    m_lastChangeFrame = m_currentFrame;
+}
+
+int ChangeTracker::channelIndex(ComponentType type) {
+    return static_cast<int>(type);
+}
+
+int ChangeTracker::channelIndex(Structural change) {
+    return ComponentChannelCount + static_cast<int>(change);
+}
+
+void ChangeTracker::record(int channelIdx, EntityId id) {
+    Channel& channel = m_channels[channelIdx];
+    ++channel.version;
+    m_lastChangeFrame = m_currentFrame;
+
+    // One journal entry per entity and frame is enough
+    auto it = channel.lastChange.find(id);
+    if (it != channel.lastChange.end()) {
+        if (it.value() == m_currentFrame) {
+            return;
+        }
+        it.value() = m_currentFrame;
+    } else {
+        channel.lastChange.insert(id, m_currentFrame);
+    }
+    channel.journal.append({m_currentFrame, id});
+}
+
+bool ChangeTracker::collect(int channelIdx, Frame sinceFrame, QVector<EntityId>& out) const {
+    if (sinceFrame < m_oldestFrame) {
+        return false;
+    }
+
+    const Channel& channel = m_channels[channelIdx];
+    auto begin = channel.journal.cbegin() + channel.journalStart;
+    auto first = std::lower_bound(begin, channel.journal.cend(), sinceFrame,
+        [](const Entry& entry, Frame frame) { return entry.frame < frame; });
+
+    // An entity changed in several frames has several entries; only the
+    // newest one matches lastChange, so each id is reported once.
+    for (auto it = first; it != channel.journal.cend(); ++it) {
+        if (channel.lastChange.value(it->id) == it->frame) {
+            out.append(it->id);
+        }
+    }
+    return true;
+}
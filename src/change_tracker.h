@@ -0,0 +1,79 @@
+#ifndef CHANGE_TRACKER_H
+#define CHANGE_TRACKER_H
+
+#include "types.h"
+#include <QHash>
+#include <QVector>
+
+// Records which entities changed, per component type, stamped with the frame
+// the change happened in. Consumers remember the last frame they synchronised
+// at and ask for the delta since then instead of rescanning the whole scene.
+class ChangeTracker {
+public:
+    using Frame = quint64;
+
+    // Structural changes that are not tied to a single component type
+    enum class Structural {
+        Created,
+        Destroyed,
+        Renamed,
+        ComponentsChanged, // A component was added or removed
+        Moved              // World matrix recomputed: the entity or an ancestor moved
+    };
+
+    ChangeTracker();
+
+    // Frames
+    Frame getCurrentFrame() const;
+    Frame advanceFrame();
+
+    // Recording
+    void recordChange(EntityId id, ComponentType type);
+    void recordChange(EntityId id, Structural change);
+
+    // Monotonic counter bumped on every recorded change of that type
+    quint64 getVersion(ComponentType type) const;
+    quint64 getVersion(Structural change) const;
+
+    // Appends every entity changed in `sinceFrame` or later (each id once)
+    // to `out`. Returns false if part of that history was already discarded,
+    // in which case the caller has to fall back to a full rescan. Consumers
+    // store getCurrentFrame() after syncing and pass it back next time.
+    bool getChangedSince(ComponentType type, Frame sinceFrame, QVector<EntityId>& out) const;
+    bool getChangedSince(Structural change, Frame sinceFrame, QVector<EntityId>& out) const;
+    bool hasChangesSince(Frame sinceFrame) const;
+
+    // History management
+    void discardBefore(Frame frame);
+    Frame getOldestFrame() const;
+    void clear();
+
+private:
+    struct Entry {
+        Frame frame;
+        EntityId id;
+    };
+
+    struct Channel {
+        QVector<Entry> journal;           // Sorted by frame
+        int journalStart = 0;             // Entries before this were discarded
+        QHash<EntityId, Frame> lastChange;
+        quint64 version = 0;
+    };
+
+    static constexpr int ComponentChannelCount = static_cast<int>(ComponentType::Sound) + 1;
+    static constexpr int ChannelCount = ComponentChannelCount + static_cast<int>(Structural::Moved) + 1;
+
+    static int channelIndex(ComponentType type);
+    static int channelIndex(Structural change);
+
+    void record(int channel, EntityId id);
+    bool collect(int channel, Frame sinceFrame, QVector<EntityId>& out) const;
+
+    QVector<Channel> m_channels;
+    Frame m_currentFrame = 1;
+    Frame m_oldestFrame = 1;
+    Frame m_lastChangeFrame = 0;
+};
+
+#endif // CHANGE_TRACKER_H
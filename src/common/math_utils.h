@@ -1,6 +1,7 @@
 #ifndef MATH_UTILS_H
 #define MATH_UTILS_H
 
+#include "types.h"
 #include <QVector3D>
 #include <QQuaternion>
 #include <QMatrix4x4>
@@ -153,6 +154,40 @@ inline bool rayIntersectsBox(const QVector3D& rayOrigin, const QVector3D& rayDir
     return true;
 }
 
+// Outward normal of the box face nearest to a point on its surface
+inline QVector3D boxNormalAt(const BoundingBox& box, const QVector3D& point) {
+    QVector3D normal(-1, 0, 0);
+    float nearest = qAbs(point.x() - box.min.x());
+    for (int axis = 0; axis < 3; ++axis) {
+        float toMin = qAbs(point[axis] - box.min[axis]);
+        float toMax = qAbs(point[axis] - box.max[axis]);
+        if (toMin < nearest) {
+            nearest = toMin;
+            normal = QVector3D();
+            normal[axis] = -1.0f;
+        }
+        if (toMax < nearest) {
+            nearest = toMax;
+            normal = QVector3D();
+            normal[axis] = 1.0f;
+        }
+    }
+    return normal;
+}
+
+// Axis-aligned bounds of a box after transformation (Arvo's method): the
+// center is transformed and the half extents are projected through |M|
+inline BoundingBox transformBox(const QMatrix4x4& matrix, const BoundingBox& box) {
+    QVector3D center = matrix.map(box.center());
+    QVector3D half = box.size() * 0.5f;
+    QVector3D extent(
+        qAbs(matrix(0, 0)) * half.x() + qAbs(matrix(0, 1)) * half.y() + qAbs(matrix(0, 2)) * half.z(),
+        qAbs(matrix(1, 0)) * half.x() + qAbs(matrix(1, 1)) * half.y() + qAbs(matrix(1, 2)) * half.z(),
+        qAbs(matrix(2, 0)) * half.x() + qAbs(matrix(2, 1)) * half.y() + qAbs(matrix(2, 2)) * half.z()
+    );
+    return BoundingBox(center - extent, center + extent);
+}
+
 // Utility functions for snapping
 inline float snapToGrid(float value, float gridSize) {
     return qRound(value / gridSize) * gridSize;
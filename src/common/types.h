@@ -17,6 +17,10 @@ class Component;
 using EntityId = uint32_t;
 using ComponentId = uint32_t;
 
+// Scenes keep GTA's coordinates as imported: Z is up and the ground is the
+// XY plane. The camera, grid, placement and tools all follow this axis.
+inline const QVector3D WorldUp{0.0f, 0.0f, 1.0f};
+
 // Common data structures
 struct Transform {
     QVector3D position{0.0f, 0.0f, 0.0f};
@@ -86,7 +90,7 @@ struct IDEObject {
     QString modelName;
     QString textureName;
     uint32_t meshCount;
-    float drawDistance;
+    float drawDistance;         // Farthest of the per-mesh distances
     uint32_t flags;
 };
 
@@ -96,7 +100,18 @@ struct IPLInstance {
     QString modelName;
     Transform transform;
     uint32_t interior;
-    uint32_t lod;
+    int32_t lod = -1;           // Index of the LOD instance in the same file, -1 if none
+};
+
+// IPL OCCL entry: a designer-placed box that hides whatever is behind it.
+// Position is the center of the footprint at ground level (Z-up).
+struct IPLOcclusionZone {
+    QVector3D position;            // Center X/Y, bottom Z
+    QVector3D size;                // Width X, width Y, height
+    QVector3D rotation;            // Degrees: heading about Z, then tilt about X and Y
+    uint32_t flags = 0;
+    
+    QVector3D center() const { return position + QVector3D(0.0f, 0.0f, size.z() * 0.5f); }
 };
 
 // Mission-related structures
@@ -0,0 +1,80 @@
+#ifndef COMPONENT_REGISTRY_H
+#define COMPONENT_REGISTRY_H
+
+#include "types.h"
+#include <array>
+#include <type_traits>
+
+class Component;
+
+// Compile-time registry over a fixed list of component classes. Each class
+// gets a dense id equal to its position in the list, so per-entity storage
+// is a plain array and typed lookups compile down to a constant index.
+// Registered classes provide `static constexpr ComponentType StaticType` and
+// `static constexpr const char* StaticTypeName`; the factory, name, size and
+// ComponentType tables below are generated from the list.
+template<typename... Ts>
+class ComponentRegistry {
+public:
+    static constexpr int Count = static_cast<int>(sizeof...(Ts));
+    static constexpr int TypeCount = static_cast<int>(ComponentType::Sound) + 1;
+
+    template<typename T>
+    static constexpr bool contains() {
+        return (std::is_same_v<T, Ts> || ...);
+    }
+
+    // Dense id of T; fails to compile for unregistered types
+    template<typename T>
+    static constexpr int id() {
+        static_assert(contains<T>(), "Component type is not registered");
+        int index = 0;
+        int result = -1;
+        ((std::is_same_v<T, Ts> ? (result = index, ++index) : ++index), ...);
+        return result;
+    }
+
+    // Runtime lookups (-1 if not registered)
+    static constexpr int idOf(ComponentType type) {
+        int index = static_cast<int>(type);
+        return index >= 0 && index < TypeCount ? s_idByType[index] : -1;
+    }
+
+    static int idOf(const QString& typeName) {
+        for (int i = 0; i < Count; ++i) {
+            if (typeName == QLatin1String(s_names[i])) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    static constexpr ComponentType typeOf(int id) { return s_types[id]; }
+    static constexpr const char* nameOf(int id) { return s_names[id]; }
+    static constexpr std::size_t sizeOf(int id) { return s_sizes[id]; }
+    static Ref<Component> create(int id) { return s_factories[id](); }
+
+private:
+    using Factory = Ref<Component> (*)();
+
+    template<typename T>
+    static Ref<Component> make() { return CreateRef<T>(); }
+
+    static constexpr std::array<int, TypeCount> buildIdByType() {
+        std::array<int, TypeCount> table{};
+        for (int& entry : table) {
+            entry = -1;
+        }
+        int index = 0;
+        ((table[static_cast<int>(Ts::StaticType)] = index++), ...);
+        return table;
+    }
+
+    static constexpr std::array<ComponentType, Count> s_types = { Ts::StaticType... };
+    static constexpr std::array<const char*, Count> s_names = { Ts::StaticTypeName... };
+    static constexpr std::array<std::size_t, Count> s_sizes = { sizeof(Ts)... };
+    static constexpr std::array<int, TypeCount> s_idByType = buildIdByType();
+    static constexpr std::array<Factory, Count> s_factories = { &make<Ts>... };
+};
+
+#endif // COMPONENT_REGISTRY_H
@@ -0,0 +1,269 @@
+#include "entity_query.h"
+#include "entity_system.h"
+#include <algorithm>
+
+namespace {
+const QVector<EntityId> kNoEntities;
+}
+
+// EntityQuery implementation
+EntityQuery& EntityQuery::withComponent(ComponentType type) {
+    m_components |= componentBit(type);
+    return *this;
+}
+
+EntityQuery& EntityQuery::inLayer(const QString& layer) {
+    m_layer = layer;
+    m_hasLayer = true;
+    return *this;
+}
+
+EntityQuery& EntityQuery::nameStartsWith(const QString& prefix) {
+    m_namePrefix = prefix.toLower();
+    return *this;
+}
+
+EntityQuery& EntityQuery::usingModel(const QString& model) {
+    m_model = EntityIndex::modelKey(model);
+    return *this;
+}
+
+EntityQuery& EntityQuery::limit(int maxResults) {
+    m_limit = maxResults;
+    return *this;
+}
+
+// EntitySet implementation
+void EntityIndex::EntitySet::insert(EntityId id) {
+    if (!positions.contains(id)) {
+        positions.insert(id, ids.size());
+        ids.append(id);
+    }
+}
+
+void EntityIndex::EntitySet::remove(EntityId id) {
+    auto it = positions.find(id);
+    if (it == positions.end()) {
+        return;
+    }
+
+    // Swap-remove to keep the list dense
+    int position = it.value();
+    EntityId last = ids.last();
+    ids[position] = last;
+    positions[last] = position;
+    ids.removeLast();
+    positions.remove(id);
+}
+
+void EntityIndex::EntitySet::clear() {
+    ids.clear();
+    positions.clear();
+}
+
+// EntityIndex implementation
+EntityIndex::EntityIndex(const ChangeTracker& tracker)
+    : m_tracker(tracker)
+{
+}
+
+void EntityIndex::sync() {
+    if (m_syncedFrame == 0) {
+        rebuild();
+        return;
+    }
+
+    QVector<EntityId> changed;
+    bool complete = m_tracker.getChangedSince(ChangeTracker::Structural::Created, m_syncedFrame, changed)
+        && m_tracker.getChangedSince(ChangeTracker::Structural::Destroyed, m_syncedFrame, changed)
+        && m_tracker.getChangedSince(ChangeTracker::Structural::Renamed, m_syncedFrame, changed)
+        && m_tracker.getChangedSince(ChangeTracker::Structural::ComponentsChanged, m_syncedFrame, changed)
+        && m_tracker.getChangedSince(ComponentType::Mesh, m_syncedFrame, changed);
+
+    if (!complete) {
+        rebuild();
+        return;
+    }
+
+    for (EntityId id : changed) {
+        refreshEntity(id);
+    }
+    m_syncedFrame = m_tracker.getCurrentFrame();
+}
+
+void EntityIndex::rebuild() {
+    clear();
+    for (Entity* entity : EntityManager::instance().getAllEntities()) {
+        refreshEntity(entity->getId());
+    }
+    m_syncedFrame = m_tracker.getCurrentFrame();
+}
+
+void EntityIndex::clear() {
+    for (EntitySet& set : m_components) {
+        set.clear();
+    }
+    m_sortedNames.clear();
+    m_pendingNames.clear();
+    m_staleNames = 0;
+    m_names.clear();
+    m_models.clear();
+    m_entityModels.clear();
+    m_syncedFrame = 0;
+}
+
+const QVector<EntityId>& EntityIndex::getWithComponent(ComponentType type) const {
+    int index = static_cast<int>(type);
+    return index >= 0 && index < TypeCount ? m_components[index].ids : kNoEntities;
+}
+
+bool EntityIndex::hasComponent(EntityId id, ComponentType type) const {
+    int index = static_cast<int>(type);
+    return index >= 0 && index < TypeCount && m_components[index].contains(id);
+}
+
+QVector<EntityId> EntityIndex::getByNamePrefix(const QString& prefix) const {
+    QPair<int, int> range = nameRange(prefix.toLower());
+    QVector<EntityId> result;
+    result.reserve(range.second - range.first);
+    for (int i = range.first; i < range.second; ++i) {
+        if (isCurrent(m_sortedNames[i])) {
+            result.append(m_sortedNames[i].id);
+        }
+    }
+    return result;
+}
+
+int EntityIndex::estimateByNamePrefix(const QString& prefix) const {
+    QPair<int, int> range = nameRange(prefix.toLower());
+    return range.second - range.first;
+}
+
+bool EntityIndex::matchesNamePrefix(EntityId id, const QString& lowerPrefix) const {
+    auto it = m_names.find(id);
+    return it != m_names.end() && it->name.startsWith(lowerPrefix);
+}
+
+const QVector<EntityId>& EntityIndex::getByModel(const QString& model) const {
+    auto it = m_models.find(modelKey(model));
+    return it != m_models.end() ? it->ids : kNoEntities;
+}
+
+bool EntityIndex::usesModelKey(EntityId id, const QString& key) const {
+    return m_entityModels.value(id) == key;
+}
+
+QString EntityIndex::modelKey(const QString& meshPath) {
+    int slash = qMax(meshPath.lastIndexOf('/'), meshPath.lastIndexOf('\\'));
+    QString key = meshPath.mid(slash + 1).toLower();
+    if (key.endsWith(".dff")) {
+        key.chop(4);
+    }
+    return key;
+}
+
+void EntityIndex::refreshEntity(EntityId id) {
+    Entity* entity = EntityManager::instance().getEntity(id);
+    if (!entity) {
+        removeEntity(id);
+        return;
+    }
+
+    for (int componentId = 0; componentId < Components::Count; ++componentId) {
+        ComponentType type = Components::typeOf(componentId);
+        EntitySet& set = m_components[static_cast<int>(type)];
+        if (entity->getComponent(type)) {
+            set.insert(id);
+        } else {
+            set.remove(id);
+        }
+    }
+
+    QString name = entity->getName().toLower();
+    auto it = m_names.find(id);
+    if (it == m_names.end() || it->name != name) {
+        setName(id, name);
+    }
+
+    MeshComponent* mesh = entity->getComponent<MeshComponent>();
+    setModel(id, mesh ? modelKey(mesh->meshPath) : QString());
+}
+
+void EntityIndex::removeEntity(EntityId id) {
+    for (EntitySet& set : m_components) {
+        set.remove(id);
+    }
+    removeName(id);
+    setModel(id, QString());
+}
+
+void EntityIndex::setName(EntityId id, const QString& lowerName) {
+    if (m_names.contains(id)) {
+        ++m_staleNames;
+    }
+    quint32 generation = ++m_nameGeneration;
+    m_names.insert(id, NameInfo{lowerName, generation});
+    m_pendingNames.append(NameEntry{lowerName, id, generation});
+}
+
+void EntityIndex::removeName(EntityId id) {
+    if (m_names.remove(id) > 0) {
+        ++m_staleNames;
+    }
+}
+
+void EntityIndex::setModel(EntityId id, const QString& key) {
+    auto it = m_entityModels.find(id);
+    if (it != m_entityModels.end()) {
+        if (it.value() == key) {
+            return;
+        }
+        auto modelIt = m_models.find(it.value());
+        if (modelIt != m_models.end()) {
+            modelIt->remove(id);
+            if (modelIt->ids.isEmpty()) {
+                m_models.erase(modelIt);
+            }
+        }
+        m_entityModels.erase(it);
+    }
+
+    if (!key.isEmpty()) {
+        m_models[key].insert(id);
+        m_entityModels.insert(id, key);
+    }
+}
+
+bool EntityIndex::isCurrent(const NameEntry& entry) const {
+    auto it = m_names.find(entry.id);
+    return it != m_names.end() && it->generation == entry.generation;
+}
+
+void EntityIndex::flushPendingNames() const {
+    int total = m_sortedNames.size() + m_pendingNames.size();
+    if (m_staleNames > 0 && m_staleNames * 2 >= total) {
+        auto stale = [this](const NameEntry& entry) { return !isCurrent(entry); };
+        m_sortedNames.erase(std::remove_if(m_sortedNames.begin(), m_sortedNames.end(), stale), m_sortedNames.end());
+        m_pendingNames.erase(std::remove_if(m_pendingNames.begin(), m_pendingNames.end(), stale), m_pendingNames.end());
+        m_staleNames = 0;
+    }
+
+    if (!m_pendingNames.isEmpty()) {
+        std::sort(m_pendingNames.begin(), m_pendingNames.end());
+        int middle = m_sortedNames.size();
+        m_sortedNames.append(m_pendingNames);
+        std::inplace_merge(m_sortedNames.begin(), m_sortedNames.begin() + middle, m_sortedNames.end());
+        m_pendingNames.clear();
+    }
+}
+
+QPair<int, int> EntityIndex::nameRange(const QString& lowerPrefix) const {
+    flushPendingNames();
+
+    // Entries sharing a prefix are contiguous in sorted order
+    auto first = std::lower_bound(m_sortedNames.begin(), m_sortedNames.end(), lowerPrefix,
+        [](const NameEntry& entry, const QString& prefix) { return entry.name < prefix; });
+    auto last = std::partition_point(first, m_sortedNames.end(),
+        [&lowerPrefix](const NameEntry& entry) { return entry.name.startsWith(lowerPrefix); });
+    return qMakePair(int(first - m_sortedNames.begin()), int(last - m_sortedNames.begin()));
+}
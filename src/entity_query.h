@@ -0,0 +1,119 @@
+#ifndef ENTITY_QUERY_H
+#define ENTITY_QUERY_H
+
+#include "types.h"
+#include "change_tracker.h"
+#include "system_scheduler.h"
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Description of an entity search. All set predicates must match; run it
+// with SceneManager::findEntities(), which starts from the most selective
+// index and only checks the remaining predicates on those candidates.
+class EntityQuery {
+public:
+    EntityQuery& withComponent(ComponentType type);
+    EntityQuery& inLayer(const QString& layer);
+    EntityQuery& nameStartsWith(const QString& prefix); // Case-insensitive
+    EntityQuery& usingModel(const QString& model);      // "lamppost", "lamppost.dff" or a full path
+    EntityQuery& limit(int maxResults);
+
+    ComponentMask getComponentMask() const { return m_components; }
+    const QString& getLayer() const { return m_layer; }
+    const QString& getNamePrefix() const { return m_namePrefix; }
+    const QString& getModel() const { return m_model; }
+    int getLimit() const { return m_limit; }
+
+    bool hasLayer() const { return m_hasLayer; }
+    bool hasNamePrefix() const { return !m_namePrefix.isEmpty(); }
+    bool hasModel() const { return !m_model.isEmpty(); }
+
+private:
+    ComponentMask m_components = 0;
+    QString m_layer;
+    bool m_hasLayer = false;
+    QString m_namePrefix;
+    QString m_model;
+    int m_limit = -1;
+};
+
+// Secondary indexes over the entity store: per-component membership, a
+// sorted name index for prefix lookups and a model-to-entities map. Kept up
+// to date from the change tracker; sync() applies only what changed since
+// the previous call and rebuilds if that history has been discarded.
+class EntityIndex {
+public:
+    explicit EntityIndex(const ChangeTracker& tracker);
+
+    void sync();
+    void rebuild();
+    void clear();
+
+    // Index lookups; results are in index order, not creation order
+    const QVector<EntityId>& getWithComponent(ComponentType type) const;
+    bool hasComponent(EntityId id, ComponentType type) const;
+
+    QVector<EntityId> getByNamePrefix(const QString& prefix) const;
+    int estimateByNamePrefix(const QString& prefix) const; // Upper bound
+    bool matchesNamePrefix(EntityId id, const QString& lowerPrefix) const;
+
+    const QVector<EntityId>& getByModel(const QString& model) const;
+    bool usesModelKey(EntityId id, const QString& key) const;
+
+    // "models/LampPost.DFF" -> "lamppost"
+    static QString modelKey(const QString& meshPath);
+
+private:
+    // Dense id list with O(1) insert, remove and membership test
+    struct EntitySet {
+        QVector<EntityId> ids;
+        QHash<EntityId, int> positions;
+
+        bool contains(EntityId id) const { return positions.contains(id); }
+        void insert(EntityId id);
+        void remove(EntityId id);
+        void clear();
+    };
+
+    struct NameEntry {
+        QString name; // Lower case
+        EntityId id;
+        quint32 generation; // Stale once the entity is renamed or removed
+        bool operator<(const NameEntry& other) const { return name < other.name; }
+    };
+
+    void refreshEntity(EntityId id);
+    void removeEntity(EntityId id);
+    void setName(EntityId id, const QString& lowerName);
+    void removeName(EntityId id);
+    void setModel(EntityId id, const QString& key);
+    bool isCurrent(const NameEntry& entry) const;
+    void flushPendingNames() const;
+    QPair<int, int> nameRange(const QString& lowerPrefix) const;
+
+    const ChangeTracker& m_tracker;
+    quint64 m_syncedFrame = 0;
+
+    static constexpr int TypeCount = static_cast<int>(ComponentType::Sound) + 1;
+    EntitySet m_components[TypeCount];
+
+    // Name index: sorted entries plus a buffer of unsorted inserts that is
+    // merged on the next lookup, so bulk loads do not pay per-insert moves.
+    // Renames and removals leave stale entries behind, which lookups skip
+    // and which are compacted away once they make up half the index.
+    struct NameInfo {
+        QString name;
+        quint32 generation;
+    };
+    mutable QVector<NameEntry> m_sortedNames;
+    mutable QVector<NameEntry> m_pendingNames;
+    mutable int m_staleNames = 0;
+    QHash<EntityId, NameInfo> m_names;
+    quint32 m_nameGeneration = 0;
+
+    QHash<QString, EntitySet> m_models;
+    QHash<EntityId, QString> m_entityModels;
+};
+
+#endif // ENTITY_QUERY_H
@@ -18,10 +18,52 @@ void Entity::setName(const QString& name) {
     }
 }
 
+Component* Entity::addComponent(ComponentType type) {
+    int id = Components::idOf(type);
+    if (id < 0) {
+        qWarning() << "Entity: Component type" << static_cast<int>(type) << "is not registered";
+        return nullptr;
+    }
+    return setComponent(id, Components::create(id));
+}
+
+Component* Entity::getComponent(ComponentType type) const {
+    int id = Components::idOf(type);
+    return id >= 0 ? m_components[id].get() : nullptr;
+}
+
+bool Entity::hasComponent(ComponentType type) const {
+    return getComponent(type) != nullptr;
+}
+
+void Entity::removeComponent(ComponentType type) {
+    int id = Components::idOf(type);
+    if (id >= 0) {
+        removeComponentById(id);
+    }
+}
+
+Component* Entity::setComponent(int id, Ref<Component> component) {
+    m_components[id] = component;
+    emit componentAdded(component.get());
+    return component.get();
+}
+
+void Entity::removeComponentById(int id) {
+    if (m_components[id]) {
+        // Keep the component alive until listeners have seen it
+        Ref<Component> component = m_components[id];
+        m_components[id].reset();
+        emit componentRemoved(component.get());
+    }
+}
+
 QVector<Component*> Entity::getAllComponents() const {
     QVector<Component*> components;
-    for (const auto& pair : m_components) {
-        components.append(pair.second.get());
+    for (const auto& component : m_components) {
+        if (component) {
+            components.append(component.get());
+        }
     }
     return components;
 }
@@ -32,9 +74,10 @@ QVariantMap Entity::serialize() const {
     data["name"] = m_name;
     
     QVariantMap componentsData;
-    for (const auto& pair : m_components) {
-        Component* component = pair.second.get();
-        componentsData[component->getTypeName()] = component->serialize();
+    for (const auto& component : m_components) {
+        if (component) {
+            componentsData[component->getTypeName()] = component->serialize();
+        }
     }
     data["components"] = componentsData;
     
@@ -48,37 +91,24 @@ void Entity::deserialize(const QVariantMap& data) {
     QVariantMap componentsData = data.value("components").toMap();
     
     // Clear existing components (except transform)
-    auto transformIt = m_components.find(std::type_index(typeid(TransformComponent)));
-    Ref<Component> transformComponent;
-    if (transformIt != m_components.end()) {
-        transformComponent = transformIt->second;
-    }
-    m_components.clear();
-    if (transformComponent) {
-        m_components[std::type_index(typeid(TransformComponent))] = transformComponent;
+    const int transformId = Components::id<TransformComponent>();
+    for (int id = 0; id < Components::Count; ++id) {
+        if (id != transformId) {
+            m_components[id].reset();
+        }
     }
     
     // Deserialize components
     for (auto it = componentsData.begin(); it != componentsData.end(); ++it) {
-        const QString& typeName = it.key();
-        const QVariantMap& componentData = it.value().toMap();
-        
-        if (typeName == "Transform") {
-            auto* transform = getComponent<TransformComponent>();
-            if (transform) {
-                transform->deserialize(componentData);
-            }
-        } else if (typeName == "Mesh") {
-            auto* mesh = addComponent<MeshComponent>();
-            mesh->deserialize(componentData);
-        } else if (typeName == "Light") {
-            auto* light = addComponent<LightComponent>();
-            light->deserialize(componentData);
-        } else if (typeName == "Script") {
-            auto* script = addComponent<ScriptComponent>();
-            script->deserialize(componentData);
+        int id = Components::idOf(it.key());
+        if (id < 0) {
+            qWarning() << "Entity: Unknown component type" << it.key();
+            continue;
         }
-        // Add more component types as needed
+        
+        Component* component = m_components[id] ? m_components[id].get()
+                                                : setComponent(id, Components::create(id));
+        component->deserialize(it.value().toMap());
     }
 }
 
@@ -89,18 +119,21 @@ Transform* Entity::getTransform() const {
 void Entity::setPosition(const QVector3D& position) {
     if (auto* transform = getTransform()) {
         transform->position = position;
+        markComponentChanged(ComponentType::Transform);
     }
 }
 
 void Entity::setRotation(const QQuaternion& rotation) {
     if (auto* transform = getTransform()) {
         transform->rotation = rotation;
+        markComponentChanged(ComponentType::Transform);
     }
 }
 
 void Entity::setScale(const QVector3D& scale) {
     if (auto* transform = getTransform()) {
         transform->scale = scale;
+        markComponentChanged(ComponentType::Transform);
     }
 }
 
@@ -125,6 +158,15 @@ QVector3D Entity::getScale() const {
     return QVector3D(1, 1, 1);
 }
 
+EntityId Entity::getParentId() const {
+    auto* transform = getComponent<TransformComponent>();
+    return transform ? transform->parentId : 0;
+}
+
+void Entity::markComponentChanged(ComponentType type) {
+    emit componentChanged(m_id, type);
+}
+
 // EntityManager implementation
 EntityManager& EntityManager::instance() {
     static EntityManager instance;
@@ -153,13 +195,14 @@ void EntityManager::destroyEntity(EntityId id) {
 
 Entity* EntityManager::getEntity(EntityId id) const {
     auto it = m_entities.find(id);
-    return it != m_entities.end() ? it->second.get() : nullptr;
+    return it != m_entities.end() ? it.value().get() : nullptr;
 }
 
 QVector<Entity*> EntityManager::getAllEntities() const {
     QVector<Entity*> entities;
-    for (const auto& pair : m_entities) {
-        entities.append(pair.second.get());
+    entities.reserve(m_entities.size());
+    for (const auto& entity : m_entities) {
+        entities.append(entity.get());
     }
     return entities;
 }
@@ -175,8 +218,8 @@ QVariantMap EntityManager::serialize() const {
     data["nextId"] = m_nextId;
     
     QVariantList entitiesData;
-    for (const auto& pair : m_entities) {
-        entitiesData.append(pair.second->serialize());
+    for (const auto& entity : m_entities) {
+        entitiesData.append(entity->serialize());
     }
     data["entities"] = entitiesData;
     
@@ -201,5 +244,5 @@ void EntityManager::deserialize(const QVariantMap& data) {
     }
 }
 
-#include "entity_system.moc"
+#include "moc_entity_system.cpp"
 
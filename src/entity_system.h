@@ -2,10 +2,10 @@
 #define ENTITY_SYSTEM_H
 
 #include "types.h"
+#include "component_registry.h"
 #include <QObject>
 #include <QVariant>
-#include <typeinfo>
-#include <typeindex>
+#include <array>
 
 // Base component class
 class Component {
@@ -21,19 +21,24 @@ public:
 // Transform component
 class TransformComponent : public Component {
 public:
-    Transform transform;
+    Transform transform; // Local to the parent entity, if any
+    EntityId parentId = 0;
     
     TransformComponent() = default;
     TransformComponent(const Transform& t) : transform(t) {}
     
-    ComponentType getType() const override { return ComponentType::Transform; }
-    QString getTypeName() const override { return "Transform"; }
+    static constexpr ComponentType StaticType = ComponentType::Transform;
+    static constexpr const char* StaticTypeName = "Transform";
+    
+    ComponentType getType() const override { return StaticType; }
+    QString getTypeName() const override { return StaticTypeName; }
     
     QVariantMap serialize() const override {
         QVariantMap data;
         data["position"] = QVariant::fromValue(transform.position);
         data["rotation"] = QVariant::fromValue(transform.rotation);
         data["scale"] = QVariant::fromValue(transform.scale);
+        data["parent"] = parentId;
         return data;
     }
     
@@ -44,6 +49,7 @@ public:
             transform.rotation = data["rotation"].value<QQuaternion>();
         if (data.contains("scale"))
             transform.scale = data["scale"].value<QVector3D>();
+        parentId = data.value("parent", 0).toUInt();
     }
 };
 
@@ -54,9 +60,15 @@ public:
     QString materialPath;
     bool isVisible = true;
     BoundingBox boundingBox;
+    float drawDistance = 0.0f; // From the IDE definition; 0 draws at any range
+    EntityId lodParent = 0;    // Low-detail stand-in drawn beyond drawDistance
+    uint32_t objectFlags = 0;  // IDE object flags (IDEParser::ObjectFlags)
+    
+    static constexpr ComponentType StaticType = ComponentType::Mesh;
+    static constexpr const char* StaticTypeName = "Mesh";
     
-    ComponentType getType() const override { return ComponentType::Mesh; }
-    QString getTypeName() const override { return "Mesh"; }
+    ComponentType getType() const override { return StaticType; }
+    QString getTypeName() const override { return StaticTypeName; }
     
     QVariantMap serialize() const override {
         QVariantMap data;
@@ -65,6 +77,9 @@ public:
         data["isVisible"] = isVisible;
         data["boundingBox_min"] = QVariant::fromValue(boundingBox.min);
         data["boundingBox_max"] = QVariant::fromValue(boundingBox.max);
+        data["drawDistance"] = drawDistance;
+        data["lodParent"] = lodParent;
+        data["objectFlags"] = objectFlags;
         return data;
     }
     
@@ -74,6 +89,9 @@ public:
         isVisible = data.value("isVisible", true).toBool();
         boundingBox.min = data.value("boundingBox_min").value<QVector3D>();
         boundingBox.max = data.value("boundingBox_max").value<QVector3D>();
+        drawDistance = data.value("drawDistance", 0.0f).toFloat();
+        lodParent = data.value("lodParent", 0).toUInt();
+        objectFlags = data.value("objectFlags", 0).toUInt();
     }
 };
 
@@ -89,8 +107,11 @@ public:
     float spotAngle = 45.0f; // For spot lights
     bool castShadows = true;
     
-    ComponentType getType() const override { return ComponentType::Light; }
-    QString getTypeName() const override { return "Light"; }
+    static constexpr ComponentType StaticType = ComponentType::Light;
+    static constexpr const char* StaticTypeName = "Light";
+    
+    ComponentType getType() const override { return StaticType; }
+    QString getTypeName() const override { return StaticTypeName; }
     
     QVariantMap serialize() const override {
         QVariantMap data;
@@ -119,8 +140,11 @@ public:
     QString scriptPath;
     QVariantMap scriptProperties;
     
-    ComponentType getType() const override { return ComponentType::Script; }
-    QString getTypeName() const override { return "Script"; }
+    static constexpr ComponentType StaticType = ComponentType::Script;
+    static constexpr const char* StaticTypeName = "Script";
+    
+    ComponentType getType() const override { return StaticType; }
+    QString getTypeName() const override { return StaticTypeName; }
     
     QVariantMap serialize() const override {
         QVariantMap data;
@@ -135,6 +159,14 @@ public:
     }
 };
 
+// All component classes an entity can hold. Dense ids follow this order.
+using Components = ComponentRegistry<
+    TransformComponent,
+    MeshComponent,
+    LightComponent,
+    ScriptComponent
+>;
+
 // Entity class
 class Entity : public QObject {
     Q_OBJECT
@@ -150,39 +182,30 @@ public:
     // Component management
     template<typename T>
     T* addComponent() {
-        static_assert(std::is_base_of_v<Component, T>, "T must derive from Component");
-        auto component = CreateRef<T>();
-        m_components[std::type_index(typeid(T))] = component;
-        emit componentAdded(component.get());
-        return component.get();
+        return static_cast<T*>(setComponent(Components::id<T>(), CreateRef<T>()));
     }
     
     template<typename T>
     T* getComponent() const {
-        static_assert(std::is_base_of_v<Component, T>, "T must derive from Component");
-        auto it = m_components.find(std::type_index(typeid(T)));
-        if (it != m_components.end()) {
-            return static_cast<T*>(it->second.get());
-        }
-        return nullptr;
+        return static_cast<T*>(m_components[Components::id<T>()].get());
     }
     
     template<typename T>
     bool hasComponent() const {
-        static_assert(std::is_base_of_v<Component, T>, "T must derive from Component");
-        return m_components.find(std::type_index(typeid(T))) != m_components.end();
+        return m_components[Components::id<T>()] != nullptr;
     }
     
     template<typename T>
     void removeComponent() {
-        static_assert(std::is_base_of_v<Component, T>, "T must derive from Component");
-        auto it = m_components.find(std::type_index(typeid(T)));
-        if (it != m_components.end()) {
-            emit componentRemoved(it->second.get());
-            m_components.erase(it);
-        }
+        removeComponentById(Components::id<T>());
     }
     
+    // Runtime-typed variants for UI and serialization code
+    Component* addComponent(ComponentType type);
+    Component* getComponent(ComponentType type) const;
+    bool hasComponent(ComponentType type) const;
+    void removeComponent(ComponentType type);
+    
     QVector<Component*> getAllComponents() const;
     
     // Serialization
@@ -198,15 +221,25 @@ public:
     QQuaternion getRotation() const;
     QVector3D getScale() const;
     
+    // Hierarchy (the link itself is maintained by SceneManager)
+    EntityId getParentId() const;
+    
+    // Notify listeners that a component's data was edited in place
+    void markComponentChanged(ComponentType type);
+    
 signals:
     void componentAdded(Component* component);
     void componentRemoved(Component* component);
     void nameChanged(const QString& newName);
+    void componentChanged(EntityId id, ComponentType type);
     
 private:
+    Component* setComponent(int id, Ref<Component> component);
+    void removeComponentById(int id);
+    
     EntityId m_id;
     QString m_name;
-    std::map<std::type_index, Ref<Component>> m_components;
+    std::array<Ref<Component>, Components::Count> m_components;
 };
 
 // Entity manager
@@ -290,6 +290,7 @@ bool DFFParser::parseMaterialList(QDataStream& stream, const RWChunk& chunk, QVe
         
         if (matChunk.type == rwMATERIAL) {
             GTAMaterial material;
+            material.name = QString("Material_%1").arg(materials.size());
             if (parseMaterial(stream, matChunk, material)) {
                 materials.append(material);
             }
@@ -319,8 +320,6 @@ bool DFFParser::parseMaterial(QDataStream& stream, const RWChunk& chunk, GTAMate
     stream >> flags >> r >> g >> b >> a >> unknown >> textured;
     
     material.diffuse = QVector3D(r, g, b);
-    material.name = QString("Material_%1").arg(materials.size());
-    
     skipChunk(stream, dataChunk);
     
     // Parse child chunks (texture)
@@ -138,7 +138,9 @@ bool IDEParser::parseObjsSection(QTextStream& stream, QVector<IDEObject>& object
 bool IDEParser::parseObjLine(const QString& line, IDEObject& object) {
     QStringList parts = splitLine(line);
     
-    // OBJS format: ID, ModelName, TxdName, MeshCount, DrawDist, Flags
+    // OBJS formats:
+    //   III/VC: ID, ModelName, TxdName, MeshCount, DrawDist x MeshCount, Flags
+    //   SA:     ID, ModelName, TxdName, DrawDist, Flags
     if (parts.size() < 5) {
         qWarning() << "IDEParser: Invalid OBJS line format:" << line;
         return false;
@@ -154,21 +156,33 @@ bool IDEParser::parseObjLine(const QString& line, IDEObject& object) {
     object.modelName = parts[1];
     object.textureName = parts[2];
     
-    object.meshCount = parts[3].toUInt(&ok);
-    if (!ok) {
-        qWarning() << "IDEParser: Invalid mesh count in OBJS line:" << parts[3];
-        return false;
+    int distanceIndex = 3;
+    if (parts.size() == 5) {
+        object.meshCount = 1;
+    } else {
+        object.meshCount = parts[3].toUInt(&ok);
+        if (!ok || object.meshCount == 0 || int(object.meshCount) > parts.size() - 4) {
+            qWarning() << "IDEParser: Invalid mesh count in OBJS line:" << parts[3];
+            return false;
+        }
+        distanceIndex = 4;
     }
     
-    object.drawDistance = parts[4].toFloat(&ok);
-    if (!ok) {
-        qWarning() << "IDEParser: Invalid draw distance in OBJS line:" << parts[4];
-        return false;
+    // One distance per mesh; the last mesh is visible the farthest out
+    object.drawDistance = 0.0f;
+    for (uint32_t i = 0; i < object.meshCount; ++i) {
+        float distance = parts[distanceIndex + i].toFloat(&ok);
+        if (!ok) {
+            qWarning() << "IDEParser: Invalid draw distance in OBJS line:" << parts[distanceIndex + i];
+            return false;
+        }
+        object.drawDistance = qMax(object.drawDistance, distance);
     }
     
     // Parse flags if present
-    if (parts.size() > 5) {
-        object.flags = parseFlags(parts[5]);
+    int flagsIndex = distanceIndex + object.meshCount;
+    if (parts.size() > flagsIndex) {
+        object.flags = parseFlags(parts[flagsIndex]);
     } else {
         object.flags = 0;
     }
@@ -12,22 +12,7 @@ public:
     static bool parse(QIODevice* device, QVector<IDEObject>& objects);
     static bool parseFromFile(const QString& filePath, QVector<IDEObject>& objects);
     
-private:
-    // IDE section types
-    enum IDESection {
-        OBJS,      // Static objects
-        TOBJ,      // Timed objects
-        WEAP,      // Weapons
-        HIER,      // Hierarchical objects
-        CARS,      // Vehicles
-        PEDS,      // Pedestrians
-        PATH,      // Path objects
-        TXDP,      // Texture dictionary parent
-        ANIM,      // Animated objects
-        UNKNOWN
-    };
-    
-    // Object flags
+    // Object flags (IDEObject::flags)
     enum ObjectFlags {
         DRAW_LAST = 0x01,
         ADDITIVE = 0x02,
@@ -51,6 +36,21 @@ private:
         UNKNOWN_FLAG = 0x80000
     };
     
+private:
+    // IDE section types
+    enum IDESection {
+        OBJS,      // Static objects
+        TOBJ,      // Timed objects
+        WEAP,      // Weapons
+        HIER,      // Hierarchical objects
+        CARS,      // Vehicles
+        PEDS,      // Pedestrians
+        PATH,      // Path objects
+        TXDP,      // Texture dictionary parent
+        ANIM,      // Animated objects
+        UNKNOWN
+    };
+    
     static IDESection parseSection(const QString& sectionName);
     static bool parseObjsSection(QTextStream& stream, QVector<IDEObject>& objects);
     static bool parseObjLine(const QString& line, IDEObject& object);
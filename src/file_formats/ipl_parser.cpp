@@ -7,6 +7,16 @@
 #include <QRegularExpression>
 
 bool IPLParser::parse(QIODevice* device, QVector<IPLInstance>& instances) {
+    QVector<IPLOcclusionZone> occluders;
+    return parse(device, instances, occluders);
+}
+
+bool IPLParser::parseFromFile(const QString& filePath, QVector<IPLInstance>& instances) {
+    QVector<IPLOcclusionZone> occluders;
+    return parseFromFile(filePath, instances, occluders);
+}
+
+bool IPLParser::parse(QIODevice* device, QVector<IPLInstance>& instances, QVector<IPLOcclusionZone>& occluders) {
     if (!device || !device->isOpen()) {
         qWarning() << "IPLParser: Invalid or closed device";
         return false;
@@ -19,28 +29,29 @@ bool IPLParser::parse(QIODevice* device, QVector<IPLInstance>& instances) {
         return parseBinaryFormat(stream, instances);
     } else {
         QTextStream stream(device);
-        return parseTextFormat(stream, instances);
+        return parseTextFormat(stream, instances, &occluders);
     }
 }
 
-bool IPLParser::parseFromFile(const QString& filePath, QVector<IPLInstance>& instances) {
+bool IPLParser::parseFromFile(const QString& filePath, QVector<IPLInstance>& instances, QVector<IPLOcclusionZone>& occluders) {
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly)) {
         qWarning() << "IPLParser: Failed to open file:" << filePath;
         return false;
     }
     
-    bool result = parse(&file, instances);
+    bool result = parse(&file, instances, occluders);
     file.close();
     
     if (result) {
-        qDebug() << "IPLParser: Successfully parsed" << filePath << "with" << instances.size() << "instances";
+        qDebug() << "IPLParser: Successfully parsed" << filePath << "with" << instances.size() << "instances and"
+                 << occluders.size() << "occlusion zones";
     }
     
     return result;
 }
 
-bool IPLParser::parseTextFormat(QTextStream& stream, QVector<IPLInstance>& instances) {
+bool IPLParser::parseTextFormat(QTextStream& stream, QVector<IPLInstance>& instances, QVector<IPLOcclusionZone>* occluders) {
     QString line;
     IPLSection currentSection = UNKNOWN;
     
@@ -108,6 +119,14 @@ bool IPLParser::parseTextFormat(QTextStream& stream, QVector<IPLInstance>& insta
                     }
                 }
                 break;
+            case OCCL:
+                if (occluders) {
+                    IPLOcclusionZone zone;
+                    if (parseOcclLine(line, zone)) {
+                        occluders->append(zone);
+                    }
+                }
+                break;
             default:
                 // Skip other sections for now
                 break;
@@ -256,10 +275,43 @@ bool IPLParser::parseInstLine(const QString& line, IPLInstance& instance) {
     
     instance.transform.rotation = QQuaternion(rotW, rotX, rotY, rotZ);
     
+    // LOD is an index into this file's INST list; -1 means none
     if (parts.size() > 10) {
-        instance.lod = parts[10].toUInt();
+        instance.lod = parts[10].toInt(&ok);
+        if (!ok) {
+            instance.lod = -1;
+        }
+    }
+    
+    return true;
+}
+
+bool IPLParser::parseOcclLine(const QString& line, IPLOcclusionZone& zone) {
+    QStringList parts = splitLine(line);
+    
+    // Vice City: MidX, MidY, BottomZ, WidthX, WidthY, Height, Rotation
+    // San Andreas: MidX, MidY, BottomZ, WidthX, WidthY, Height, RotX, RotY, RotZ, Flags
+    if (parts.size() < 7) {
+        qWarning() << "IPLParser: Invalid OCCL line format:" << line;
+        return false;
     }
     
+    float values[9] = {};
+    int valueCount = qMin(int(parts.size()), 9);
+    for (int i = 0; i < valueCount; ++i) {
+        bool ok;
+        values[i] = parts[i].toFloat(&ok);
+        if (!ok) {
+            qWarning() << "IPLParser: Invalid value in OCCL line:" << parts[i];
+            return false;
+        }
+    }
+    
+    zone.position = QVector3D(values[0], values[1], values[2]);
+    zone.size = QVector3D(values[3], values[4], values[5]);
+    zone.rotation = QVector3D(values[6], values[7], values[8]);
+    zone.flags = parts.size() > 9 ? parts[9].toUInt() : 0;
+    
     return true;
 }
 
@@ -12,6 +12,10 @@ public:
     static bool parse(QIODevice* device, QVector<IPLInstance>& instances);
     static bool parseFromFile(const QString& filePath, QVector<IPLInstance>& instances);
     
+    // Also collects the OCCL section (text IPLs only)
+    static bool parse(QIODevice* device, QVector<IPLInstance>& instances, QVector<IPLOcclusionZone>& occluders);
+    static bool parseFromFile(const QString& filePath, QVector<IPLInstance>& instances, QVector<IPLOcclusionZone>& occluders);
+    
 private:
     // IPL section types
     enum IPLSection {
@@ -31,13 +35,14 @@ private:
         UNKNOWN
     };
     
-    static bool parseTextFormat(QTextStream& stream, QVector<IPLInstance>& instances);
+    static bool parseTextFormat(QTextStream& stream, QVector<IPLInstance>& instances, QVector<IPLOcclusionZone>* occluders);
     static bool parseBinaryFormat(QDataStream& stream, QVector<IPLInstance>& instances);
     static bool isBinaryFormat(QIODevice* device);
     
     static IPLSection parseSection(const QString& sectionName);
     static bool parseInstSection(QTextStream& stream, QVector<IPLInstance>& instances);
     static bool parseInstLine(const QString& line, IPLInstance& instance);
+    static bool parseOcclLine(const QString& line, IPLOcclusionZone& zone);
     
     static void skipSection(QTextStream& stream);
     static QString readLine(QTextStream& stream);
@@ -54,7 +59,7 @@ private:
         float rotX, rotY, rotZ, rotW;
         uint32_t modelId;
         uint32_t interior;
-        uint32_t lod;
+        int32_t lod;
     };
 };
 
@@ -160,11 +160,11 @@ bool TXDParser::parseTextureNative(QDataStream& stream, const RWChunk& chunk, GT
     
     // Handle DXT compression
     if (compression == 1) { // DXT1
-        dataSize = qMax(1U, (width + 3) / 4) * qMax(1U, (height + 3) / 4) * 8;
+        dataSize = qMax(1U, (width + 3U) / 4U) * qMax(1U, (height + 3U) / 4U) * 8;
     } else if (compression == 3) { // DXT3
-        dataSize = qMax(1U, (width + 3) / 4) * qMax(1U, (height + 3) / 4) * 16;
+        dataSize = qMax(1U, (width + 3U) / 4U) * qMax(1U, (height + 3U) / 4U) * 16;
     } else if (compression == 5) { // DXT5
-        dataSize = qMax(1U, (width + 3) / 4) * qMax(1U, (height + 3) / 4) * 16;
+        dataSize = qMax(1U, (width + 3U) / 4U) * qMax(1U, (height + 3U) / 4U) * 16;
     }
     
     // Read texture data
@@ -0,0 +1,205 @@
+#include "layer_table.h"
+#include <algorithm>
+
+namespace {
+const QVector<EntityId> kNoEntities;
+
+int lowestBit(quint64 mask) {
+    int index = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++index;
+    }
+    return index;
+}
+}
+
+LayerId LayerTable::create(const QString& name) {
+    LayerId existing = find(name);
+    if (existing != NoLayer) {
+        return existing;
+    }
+    if (~m_usedMask == 0) {
+        return NoLayer;
+    }
+
+    LayerId layer = LayerId(lowestBit(~m_usedMask));
+    m_usedMask |= layerBit(layer);
+    m_names[layer] = name;
+    return layer;
+}
+
+void LayerTable::destroy(LayerId layer, LayerId fallback) {
+    if (!isValid(layer)) {
+        return;
+    }
+
+    QVector<EntityId>& members = m_members[layer];
+    if (isValid(fallback) && fallback != layer) {
+        // Append the whole member list to the fallback in one pass
+        QVector<EntityId>& target = m_members[fallback];
+        int base = target.size();
+        target.append(members);
+        for (int i = 0; i < members.size(); ++i) {
+            EntityId id = members[i];
+            m_entityLayers[id] = fallback;
+            m_entitySlots[id] = base + i;
+        }
+    } else {
+        for (EntityId id : members) {
+            m_entityLayers[id] = NoLayer;
+            m_entitySlots[id] = -1;
+        }
+    }
+
+    members.clear();
+    m_names[layer].clear();
+    m_usedMask &= ~layerBit(layer);
+    m_hiddenMask &= ~layerBit(layer);
+    m_lockedMask &= ~layerBit(layer);
+}
+
+LayerId LayerTable::find(const QString& name) const {
+    for (quint64 mask = m_usedMask; mask != 0; mask &= mask - 1) {
+        int layer = lowestBit(mask);
+        if (m_names[layer] == name) {
+            return LayerId(layer);
+        }
+    }
+    return NoLayer;
+}
+
+QString LayerTable::getName(LayerId layer) const {
+    return isValid(layer) ? m_names[layer] : QString();
+}
+
+QStringList LayerTable::getNames() const {
+    QStringList names;
+    for (quint64 mask = m_usedMask; mask != 0; mask &= mask - 1) {
+        names.append(m_names[lowestBit(mask)]);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+bool LayerTable::isValid(LayerId layer) const {
+    return (m_usedMask & layerBit(layer)) != 0;
+}
+
+void LayerTable::clear() {
+    for (int layer = 0; layer < MaxLayers; ++layer) {
+        m_names[layer].clear();
+        m_members[layer].clear();
+    }
+    m_usedMask = 0;
+    m_hiddenMask = 0;
+    m_lockedMask = 0;
+    m_entityLayers.clear();
+    m_entitySlots.clear();
+}
+
+void LayerTable::assign(EntityId id, LayerId layer) {
+    if (!isValid(layer)) {
+        unassign(id);
+        return;
+    }
+
+    ensureCapacity(id);
+    if (m_entityLayers[id] == layer) {
+        return;
+    }
+
+    removeMember(id);
+    m_entityLayers[id] = layer;
+    m_entitySlots[id] = m_members[layer].size();
+    m_members[layer].append(id);
+}
+
+void LayerTable::assign(const QVector<EntityId>& ids, LayerId layer) {
+    if (!isValid(layer)) {
+        for (EntityId id : ids) {
+            unassign(id);
+        }
+        return;
+    }
+
+    if (!ids.isEmpty()) {
+        ensureCapacity(*std::max_element(ids.begin(), ids.end()));
+    }
+
+    // Relabel and append in one pass; the layers that lost members are
+    // compacted afterwards, once each, instead of one swap-remove per id
+    QVector<EntityId>& target = m_members[layer];
+    quint64 touched = 0;
+    for (EntityId id : ids) {
+        LayerId old = m_entityLayers[id];
+        if (old == layer) {
+            continue;
+        }
+        touched |= layerBit(old);
+        m_entityLayers[id] = layer;
+        m_entitySlots[id] = target.size();
+        target.append(id);
+    }
+
+    for (; touched != 0; touched &= touched - 1) {
+        LayerId old = LayerId(lowestBit(touched));
+        QVector<EntityId>& members = m_members[old];
+        members.erase(std::remove_if(members.begin(), members.end(),
+            [this, old](EntityId id) { return m_entityLayers[id] != old; }), members.end());
+        for (int i = 0; i < members.size(); ++i) {
+            m_entitySlots[members[i]] = i;
+        }
+    }
+}
+
+void LayerTable::unassign(EntityId id) {
+    if (id < EntityId(m_entityLayers.size())) {
+        removeMember(id);
+        m_entityLayers[id] = NoLayer;
+        m_entitySlots[id] = -1;
+    }
+}
+
+LayerId LayerTable::getLayer(EntityId id) const {
+    return id < EntityId(m_entityLayers.size()) ? m_entityLayers[id] : NoLayer;
+}
+
+const QVector<EntityId>& LayerTable::getMembers(LayerId layer) const {
+    return isValid(layer) ? m_members[layer] : kNoEntities;
+}
+
+void LayerTable::setHidden(LayerId layer, bool hidden) {
+    if (isValid(layer)) {
+        m_hiddenMask = hidden ? (m_hiddenMask | layerBit(layer)) : (m_hiddenMask & ~layerBit(layer));
+    }
+}
+
+void LayerTable::setLocked(LayerId layer, bool locked) {
+    if (isValid(layer)) {
+        m_lockedMask = locked ? (m_lockedMask | layerBit(layer)) : (m_lockedMask & ~layerBit(layer));
+    }
+}
+
+void LayerTable::ensureCapacity(EntityId id) {
+    if (id >= EntityId(m_entityLayers.size())) {
+        int size = qMax(int(id) + 1, m_entityLayers.size() * 2);
+        m_entityLayers.resize(size, NoLayer);
+        m_entitySlots.resize(size, -1);
+    }
+}
+
+void LayerTable::removeMember(EntityId id) {
+    LayerId layer = m_entityLayers[id];
+    if (layer == NoLayer) {
+        return;
+    }
+
+    // Swap-remove, patching the slot of the entity that moves
+    QVector<EntityId>& members = m_members[layer];
+    int slot = m_entitySlots[id];
+    EntityId last = members.last();
+    members[slot] = last;
+    m_entitySlots[last] = slot;
+    members.removeLast();
+}
@@ -0,0 +1,68 @@
+#ifndef LAYER_TABLE_H
+#define LAYER_TABLE_H
+
+#include "types.h"
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+using LayerId = quint8;
+
+// Editor layers as small integer ids. Each entity's layer and its position
+// in that layer's member list are stored in dense arrays indexed by
+// EntityId, so moving an entity between layers is O(1). Visibility and
+// locking are kept as 64-bit masks over layer ids; hot paths fetch an
+// entity's layer bit and test it against a mask with a single AND.
+class LayerTable {
+public:
+    static constexpr int MaxLayers = 64;
+    static constexpr LayerId NoLayer = 0xFF;
+
+    // Layers. create() returns the existing id for a known name and NoLayer
+    // once MaxLayers is reached.
+    LayerId create(const QString& name);
+    void destroy(LayerId layer, LayerId fallback); // Members move to fallback
+    LayerId find(const QString& name) const;
+    QString getName(LayerId layer) const;
+    QStringList getNames() const; // Sorted
+    bool isValid(LayerId layer) const;
+    void clear();
+
+    // Membership
+    void assign(EntityId id, LayerId layer);
+    void assign(const QVector<EntityId>& ids, LayerId layer);
+    void unassign(EntityId id);
+    LayerId getLayer(EntityId id) const;
+    const QVector<EntityId>& getMembers(LayerId layer) const;
+
+    // Layer bit of an entity's layer; zero for entities without one, so
+    // they never match a mask
+    quint64 getLayerBit(EntityId id) const {
+        return id < EntityId(m_entityLayers.size()) ? layerBit(m_entityLayers[id]) : 0;
+    }
+    static quint64 layerBit(LayerId layer) {
+        return layer < MaxLayers ? quint64(1) << layer : 0;
+    }
+
+    // Visibility and locking
+    void setHidden(LayerId layer, bool hidden);
+    void setLocked(LayerId layer, bool locked);
+    quint64 getHiddenMask() const { return m_hiddenMask; }
+    quint64 getLockedMask() const { return m_lockedMask; }
+
+private:
+    void ensureCapacity(EntityId id);
+    void removeMember(EntityId id);
+
+    QString m_names[MaxLayers];
+    QVector<EntityId> m_members[MaxLayers];
+    quint64 m_usedMask = 0;
+    quint64 m_hiddenMask = 0;
+    quint64 m_lockedMask = 0;
+
+    // Indexed by EntityId
+    QVector<LayerId> m_entityLayers;
+    QVector<int> m_entitySlots;
+};
+
+#endif // LAYER_TABLE_H
@@ -0,0 +1,116 @@
+#include "lod_table.h"
+#include <limits>
+
+namespace {
+const QVector<EntityId> kNoEntities;
+const float kUnlimited = std::numeric_limits<float>::infinity();
+}
+
+void LodTable::set(EntityId id, float drawDistance, EntityId lodParent) {
+    ensureCapacity(qMax(id, lodParent));
+    if (lodParent == id) {
+        lodParent = 0;
+    }
+
+    float oldDistance = m_drawDistances[id];
+    m_drawDistances[id] = qMax(0.0f, drawDistance);
+    if (m_lodParents[id] != lodParent) {
+        detach(id);
+        m_lodParents[id] = lodParent;
+        if (lodParent) {
+            m_children[lodParent].append(id);
+            refreshSwitchDistance(lodParent);
+        }
+    } else if (lodParent && oldDistance != m_drawDistances[id]) {
+        refreshSwitchDistance(lodParent);
+    }
+}
+
+void LodTable::remove(EntityId id) {
+    if (id < EntityId(m_drawDistances.size())) {
+        detach(id);
+        m_lodParents[id] = 0;
+        m_drawDistances[id] = 0.0f;
+    }
+}
+
+void LodTable::clear() {
+    m_drawDistances.clear();
+    m_lodParents.clear();
+    m_switchDistances.clear();
+    m_children.clear();
+}
+
+float LodTable::getDrawDistance(EntityId id) const {
+    return id < EntityId(m_drawDistances.size()) ? m_drawDistances[id] : 0.0f;
+}
+
+EntityId LodTable::getLodParent(EntityId id) const {
+    return id < EntityId(m_lodParents.size()) ? m_lodParents[id] : 0;
+}
+
+float LodTable::getSwitchDistance(EntityId id) const {
+    return id < EntityId(m_switchDistances.size()) ? m_switchDistances[id] : 0.0f;
+}
+
+bool LodTable::isLodParent(EntityId id) const {
+    return getSwitchDistance(id) > 0.0f;
+}
+
+const QVector<EntityId>& LodTable::getChildren(EntityId id) const {
+    auto it = m_children.constFind(id);
+    return it != m_children.constEnd() ? it.value() : kNoEntities;
+}
+
+bool LodTable::isDrawnAt(EntityId id, float distance, float multiplier) const {
+    if (id >= EntityId(m_drawDistances.size())) {
+        return true;
+    }
+
+    float drawDistance = m_drawDistances[id];
+    if (drawDistance > 0.0f && distance > drawDistance * multiplier) {
+        return false;
+    }
+    float switchDistance = m_switchDistances[id];
+    return !(switchDistance > 0.0f && distance <= switchDistance * multiplier);
+}
+
+void LodTable::ensureCapacity(EntityId id) {
+    if (id >= EntityId(m_drawDistances.size())) {
+        int size = qMax(int(id) + 1, m_drawDistances.size() * 2);
+        m_drawDistances.resize(size, 0.0f);
+        m_lodParents.resize(size, 0);
+        m_switchDistances.resize(size, 0.0f);
+    }
+}
+
+void LodTable::detach(EntityId id) {
+    EntityId parent = m_lodParents[id];
+    if (!parent) {
+        return;
+    }
+
+    auto it = m_children.find(parent);
+    if (it != m_children.end()) {
+        it.value().removeOne(id);
+        if (it.value().isEmpty()) {
+            m_children.erase(it);
+        }
+    }
+    refreshSwitchDistance(parent);
+}
+
+void LodTable::refreshSwitchDistance(EntityId parent) {
+    // The parent takes over once any child is out of its own range, so the
+    // nearest child draw distance decides; a child without one is always
+    // drawn and never hands over
+    const QVector<EntityId>& children = getChildren(parent);
+    float switchDistance = children.isEmpty() ? 0.0f : kUnlimited;
+    for (EntityId child : children) {
+        float distance = m_drawDistances[child];
+        if (distance > 0.0f) {
+            switchDistance = qMin(switchDistance, distance);
+        }
+    }
+    m_switchDistances[parent] = switchDistance;
+}
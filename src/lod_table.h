@@ -0,0 +1,45 @@
+#ifndef LOD_TABLE_H
+#define LOD_TABLE_H
+
+#include "types.h"
+#include <QHash>
+#include <QVector>
+
+// Draw distances and LOD links of renderable entities, in dense arrays
+// indexed by EntityId. An entity is drawn out to its own draw distance. A
+// LOD parent stays hidden while all its children are in range, that is
+// within its switch distance (the nearest child draw distance), and is
+// drawn from there out to its own draw distance. GTA links are 1:1; with
+// several children the parent may overlap nearer ones still drawn, but
+// never leaves a hole where a child has dropped out.
+class LodTable {
+public:
+    // A draw distance of 0 means unlimited; lodParent 0 means none
+    void set(EntityId id, float drawDistance, EntityId lodParent);
+    void remove(EntityId id);
+    void clear();
+
+    float getDrawDistance(EntityId id) const;
+    EntityId getLodParent(EntityId id) const;
+    float getSwitchDistance(EntityId id) const; // 0 if it has no children
+    bool isLodParent(EntityId id) const;
+    const QVector<EntityId>& getChildren(EntityId id) const;
+
+    // Range test with LOD handover; stored distances are scaled by multiplier
+    bool isDrawnAt(EntityId id, float distance, float multiplier) const;
+
+private:
+    void ensureCapacity(EntityId id);
+    void detach(EntityId id);
+    void refreshSwitchDistance(EntityId parent);
+
+    // Indexed by EntityId
+    QVector<float> m_drawDistances;
+    QVector<EntityId> m_lodParents;
+    QVector<float> m_switchDistances;
+
+    // Children per LOD parent; parents are few compared to HD instances
+    QHash<EntityId, QVector<EntityId>> m_children;
+};
+
+#endif // LOD_TABLE_H
@@ -0,0 +1,42 @@
+#include "model_library.h"
+
+void ModelLibrary::add(const QString& name, const GTAModel& model) {
+    Entry& entry = m_models[name];
+    entry.model = model;
+    entry.triangles.reset();
+}
+
+void ModelLibrary::remove(const QString& name) {
+    m_models.remove(name);
+}
+
+void ModelLibrary::clear() {
+    m_models.clear();
+}
+
+bool ModelLibrary::contains(const QString& name) const {
+    return m_models.contains(name);
+}
+
+int ModelLibrary::size() const {
+    return m_models.size();
+}
+
+const GTAModel* ModelLibrary::find(const QString& name) const {
+    auto it = m_models.constFind(name);
+    return it != m_models.constEnd() ? &it.value().model : nullptr;
+}
+
+const TriangleBVH* ModelLibrary::getTriangleBVH(const QString& name) const {
+    auto it = m_models.constFind(name);
+    if (it == m_models.constEnd()) {
+        return nullptr;
+    }
+
+    const Entry& entry = it.value();
+    if (!entry.triangles) {
+        entry.triangles = CreateRef<TriangleBVH>();
+        entry.triangles->build(entry.model);
+    }
+    return entry.triangles->isEmpty() ? nullptr : entry.triangles.get();
+}
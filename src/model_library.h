@@ -0,0 +1,34 @@
+#ifndef MODEL_LIBRARY_H
+#define MODEL_LIBRARY_H
+
+#include "types.h"
+#include "triangle_bvh.h"
+#include <QHash>
+#include <QString>
+
+// Parsed models by name, the same name MeshComponent::meshPath refers to.
+// Each model's triangle BVH is built the first time it is asked for and
+// kept until the model is replaced or removed.
+class ModelLibrary {
+public:
+    void add(const QString& name, const GTAModel& model);
+    void remove(const QString& name);
+    void clear();
+
+    bool contains(const QString& name) const;
+    int size() const;
+    const GTAModel* find(const QString& name) const;
+
+    // nullptr if the model is unknown or has no triangles
+    const TriangleBVH* getTriangleBVH(const QString& name) const;
+
+private:
+    struct Entry {
+        GTAModel model;
+        mutable Ref<TriangleBVH> triangles;
+    };
+
+    QHash<QString, Entry> m_models;
+};
+
+#endif // MODEL_LIBRARY_H
@@ -0,0 +1,328 @@
+#include "debug_draw.h"
+#include <QDebug>
+#include <QtMath>
+#include <cstring>
+
+namespace {
+const GLsizei kStride = sizeof(DebugDrawList::Vertex);
+
+// Two directions perpendicular to the normal and to each other
+void basis(const QVector3D& normal, QVector3D& u, QVector3D& v) {
+    const QVector3D axis = qAbs(normal.x()) < 0.9f ? QVector3D(1, 0, 0) : QVector3D(0, 1, 0);
+    u = QVector3D::crossProduct(normal, axis).normalized();
+    v = QVector3D::crossProduct(normal, u);
+}
+}
+
+void DebugDrawList::clear() {
+    m_vertices.resize(0);
+}
+
+void DebugDrawList::reserve(int vertices) {
+    m_vertices.reserve(vertices);
+}
+
+void DebugDrawList::line(const QVector3D& a, const QVector3D& b, const QColor& color) {
+    const quint32 packed = packColor(color);
+    push(a, packed);
+    push(b, packed);
+}
+
+void DebugDrawList::box(const BoundingBox& box, const QColor& color) {
+    QMatrix4x4 transform;
+    transform.translate(box.center());
+    transform.scale(box.size() * 0.5f);
+    this->box(transform, color);
+}
+
+void DebugDrawList::box(const QMatrix4x4& transform, const QColor& color) {
+    // Corner i has bit 0 set for +x, bit 1 for +y, bit 2 for +z; the edges
+    // join corners one bit apart
+    QVector3D corners[8];
+    for (int i = 0; i < 8; ++i) {
+        corners[i] = transform.map(QVector3D(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f));
+    }
+    const quint32 packed = packColor(color);
+    m_vertices.reserve(m_vertices.size() + 24);
+    for (int i = 0; i < 8; ++i) {
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if (!(i & bit)) {
+                push(corners[i], packed);
+                push(corners[i | bit], packed);
+            }
+        }
+    }
+}
+
+void DebugDrawList::circle(const QVector3D& center, const QVector3D& normal, float radius,
+                           const QColor& color, int segments) {
+    QVector3D u, v;
+    basis(normal.normalized(), u, v);
+    const quint32 packed = packColor(color);
+    const float step = 2.0f * float(M_PI) / segments;
+    m_vertices.reserve(m_vertices.size() + segments * 2);
+    QVector3D previous = center + u * radius;
+    for (int i = 1; i <= segments; ++i) {
+        const float angle = i * step;
+        const QVector3D point = center + (u * qCos(angle) + v * qSin(angle)) * radius;
+        push(previous, packed);
+        push(point, packed);
+        previous = point;
+    }
+}
+
+void DebugDrawList::sphere(const QVector3D& center, float radius, const QColor& color, int segments) {
+    circle(center, QVector3D(1, 0, 0), radius, color, segments);
+    circle(center, QVector3D(0, 1, 0), radius, color, segments);
+    circle(center, QVector3D(0, 0, 1), radius, color, segments);
+}
+
+void DebugDrawList::cylinder(const QMatrix4x4& transform, float radius, float height,
+                             const QColor& color, int segments) {
+    const quint32 packed = packColor(color);
+    const float step = 2.0f * float(M_PI) / segments;
+    m_vertices.reserve(m_vertices.size() + segments * 4 + 8);
+    QVector3D previousBottom = transform.map(QVector3D(radius, 0.0f, 0.0f));
+    QVector3D previousTop = transform.map(QVector3D(radius, 0.0f, height));
+    for (int i = 1; i <= segments; ++i) {
+        const float angle = i * step;
+        const float x = radius * qCos(angle);
+        const float y = radius * qSin(angle);
+        const QVector3D bottom = transform.map(QVector3D(x, y, 0.0f));
+        const QVector3D top = transform.map(QVector3D(x, y, height));
+        push(previousBottom, packed);
+        push(bottom, packed);
+        push(previousTop, packed);
+        push(top, packed);
+        previousBottom = bottom;
+        previousTop = top;
+    }
+
+    // Four sides joining the caps
+    for (int i = 0; i < 4; ++i) {
+        const float angle = i * float(M_PI) * 0.5f;
+        const float x = radius * qCos(angle);
+        const float y = radius * qSin(angle);
+        push(transform.map(QVector3D(x, y, 0.0f)), packed);
+        push(transform.map(QVector3D(x, y, height)), packed);
+    }
+}
+
+void DebugDrawList::arrow(const QVector3D& from, const QVector3D& to, const QColor& color, float headSize) {
+    const quint32 packed = packColor(color);
+    push(from, packed);
+    push(to, packed);
+
+    const QVector3D direction = (to - from).normalized();
+    if (direction.isNull()) {
+        return;
+    }
+    QVector3D u, v;
+    basis(direction, u, v);
+    const QVector3D base = to - direction * headSize;
+    const float spread = headSize * 0.4f;
+    const QVector3D offsets[4] = {u * spread, -u * spread, v * spread, -v * spread};
+    for (const QVector3D& offset : offsets) {
+        push(to, packed);
+        push(base + offset, packed);
+    }
+}
+
+void DebugDrawList::cross(const QVector3D& center, float size, const QColor& color) {
+    const quint32 packed = packColor(color);
+    const float half = size * 0.5f;
+    push(center - QVector3D(half, 0, 0), packed);
+    push(center + QVector3D(half, 0, 0), packed);
+    push(center - QVector3D(0, half, 0), packed);
+    push(center + QVector3D(0, half, 0), packed);
+    push(center - QVector3D(0, 0, half), packed);
+    push(center + QVector3D(0, 0, half), packed);
+}
+
+void DebugDrawList::append(const DebugDrawList& other) {
+    m_vertices.append(other.m_vertices);
+}
+
+quint32 DebugDrawList::packColor(const QColor& color) {
+    const uchar bytes[4] = {uchar(color.red()), uchar(color.green()), uchar(color.blue()), uchar(color.alpha())};
+    quint32 packed;
+    std::memcpy(&packed, bytes, sizeof(packed));
+    return packed;
+}
+
+DebugDraw::DebugDraw() = default;
+
+void DebugDraw::initialize() {
+    initializeOpenGLFunctions();
+
+    const char* vertexShader = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        layout (location = 1) in vec4 aColor;
+
+        uniform mat4 viewProjection;
+
+        out vec4 color;
+
+        void main() {
+            color = aColor;
+            gl_Position = viewProjection * vec4(aPos, 1.0);
+        }
+    )";
+
+    const char* fragmentShader = R"(
+        #version 330 core
+        in vec4 color;
+        out vec4 FragColor;
+
+        void main() {
+            FragColor = color;
+        }
+    )";
+
+    m_shader = new QOpenGLShaderProgram();
+    m_shader->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader);
+    m_shader->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader);
+    if (!m_shader->link()) {
+        qWarning() << "DebugDraw: Failed to link shader:" << m_shader->log();
+    }
+
+    glGenVertexArrays(1, &m_frameVAO);
+    glGenBuffers(1, &m_frameVBO);
+    glBindVertexArray(m_frameVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_frameVBO);
+    setupAttributes();
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_initialized = true;
+}
+
+void DebugDraw::destroy() {
+    if (!m_initialized) {
+        return;
+    }
+    for (Retained& retained : m_retained) {
+        release(retained);
+    }
+    m_retained.clear();
+    glDeleteVertexArrays(1, &m_frameVAO);
+    glDeleteBuffers(1, &m_frameVBO);
+    m_frameVAO = 0;
+    m_frameVBO = 0;
+    m_frameCapacity = 0;
+    delete m_shader;
+    m_shader = nullptr;
+    m_initialized = false;
+}
+
+void DebugDraw::setRetained(const QString& name, const DebugDrawList& list, Depth depth) {
+    if (!m_initialized) {
+        return;
+    }
+
+    Retained& retained = m_retained[name];
+    if (retained.vao == 0) {
+        glGenVertexArrays(1, &retained.vao);
+        glGenBuffers(1, &retained.vbo);
+        glBindVertexArray(retained.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, retained.vbo);
+        setupAttributes();
+        glBindVertexArray(0);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, retained.vbo);
+    }
+    glBufferData(GL_ARRAY_BUFFER, qint64(list.getVertexCount()) * kStride, list.getVertices(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    retained.vertexCount = list.getVertexCount();
+    retained.depth = depth;
+    m_stats.uploadedBytes += qint64(list.getVertexCount()) * kStride;
+}
+
+void DebugDraw::removeRetained(const QString& name) {
+    auto it = m_retained.find(name);
+    if (it != m_retained.end()) {
+        release(it.value());
+        m_retained.erase(it);
+    }
+}
+
+void DebugDraw::flush(const QMatrix4x4& viewProjection) {
+    // Retained uploads since the last flush count towards this frame
+    const qint64 retainedUploads = m_stats.uploadedBytes;
+    m_stats = Stats();
+    m_stats.uploadedBytes = retainedUploads;
+
+    DebugDrawList& tested = m_frameLists[DepthTested];
+    DebugDrawList& overlay = m_frameLists[Overlay];
+    if (!m_initialized || (m_retained.isEmpty() && tested.isEmpty() && overlay.isEmpty())) {
+        tested.clear();
+        overlay.clear();
+        return;
+    }
+
+    // Both lists go into one freshly orphaned store, so the driver never
+    // waits on the previous frame's draws from the same buffer
+    const qint64 testedBytes = qint64(tested.getVertexCount()) * kStride;
+    const qint64 overlayBytes = qint64(overlay.getVertexCount()) * kStride;
+    if (testedBytes + overlayBytes > 0) {
+        m_frameCapacity = qMax(m_frameCapacity, testedBytes + overlayBytes);
+        glBindBuffer(GL_ARRAY_BUFFER, m_frameVBO);
+        glBufferData(GL_ARRAY_BUFFER, m_frameCapacity, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, testedBytes, tested.getVertices());
+        glBufferSubData(GL_ARRAY_BUFFER, testedBytes, overlayBytes, overlay.getVertices());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        m_stats.uploadedBytes += testedBytes + overlayBytes;
+    }
+
+    m_shader->bind();
+    m_shader->setUniformValue("viewProjection", viewProjection);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+
+    int first = 0;
+    for (int depth = DepthTested; depth <= Overlay; ++depth) {
+        if (depth == Overlay) {
+            glDisable(GL_DEPTH_TEST);
+        }
+        for (const Retained& retained : m_retained) {
+            if (retained.depth == depth && retained.vertexCount > 0) {
+                glBindVertexArray(retained.vao);
+                glDrawArrays(GL_LINES, 0, retained.vertexCount);
+                ++m_stats.drawCalls;
+                m_stats.vertices += retained.vertexCount;
+            }
+        }
+
+        const int count = m_frameLists[depth].getVertexCount();
+        if (count > 0) {
+            glBindVertexArray(m_frameVAO);
+            glDrawArrays(GL_LINES, first, count);
+            ++m_stats.drawCalls;
+            m_stats.vertices += count;
+        }
+        first += count;
+    }
+
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    m_shader->release();
+
+    tested.clear();
+    overlay.clear();
+}
+
+void DebugDraw::setupAttributes() {
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, kStride, nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, kStride, reinterpret_cast<void*>(3 * sizeof(float)));
+}
+
+void DebugDraw::release(Retained& retained) {
+    glDeleteVertexArrays(1, &retained.vao);
+    glDeleteBuffers(1, &retained.vbo);
+    retained.vao = 0;
+    retained.vbo = 0;
+}
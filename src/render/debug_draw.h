@@ -0,0 +1,123 @@
+#ifndef DEBUG_DRAW_H
+#define DEBUG_DRAW_H
+
+#include "types.h"
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QColor>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Coloured line segments for editor overlays, built on the CPU. Shapes are
+// expanded into GL_LINES vertex pairs as they are added; nothing touches GL,
+// so lists can be filled from anywhere and handed to DebugDraw.
+class DebugDrawList {
+public:
+    struct Vertex {
+        float x, y, z;
+        quint32 color; // RGBA bytes in memory order
+    };
+
+    // Keeps the allocation, so a list refilled every frame stops allocating
+    void clear();
+    void reserve(int vertices);
+    bool isEmpty() const { return m_vertices.isEmpty(); }
+    int getVertexCount() const { return m_vertices.size(); }
+    const Vertex* getVertices() const { return m_vertices.constData(); }
+
+    void line(const QVector3D& a, const QVector3D& b, const QColor& color);
+    void box(const BoundingBox& box, const QColor& color);
+
+    // Oriented box: the unit cube [-1, 1] under the transform
+    void box(const QMatrix4x4& transform, const QColor& color);
+
+    // Circle in the plane through center with the given normal
+    void circle(const QVector3D& center, const QVector3D& normal, float radius,
+                const QColor& color, int segments = 32);
+
+    // Three great circles, one per axis
+    void sphere(const QVector3D& center, float radius, const QColor& color, int segments = 32);
+
+    // Along the transform's local Z, base circle at its origin
+    void cylinder(const QMatrix4x4& transform, float radius, float height,
+                  const QColor& color, int segments = 24);
+
+    // Shaft plus a four-line head headSize long
+    void arrow(const QVector3D& from, const QVector3D& to, const QColor& color, float headSize);
+
+    // Three axis-aligned lines through a point; the cheapest marker
+    void cross(const QVector3D& center, float size, const QColor& color);
+
+    void append(const DebugDrawList& other);
+
+    static quint32 packColor(const QColor& color);
+
+private:
+    void push(const QVector3D& position, quint32 color) {
+        m_vertices.append(Vertex{position.x(), position.y(), position.z(), color});
+    }
+
+    QVector<Vertex> m_vertices;
+};
+
+// Draws DebugDrawLists with one shader and no per-shape state. Per-frame
+// lists share one streamed buffer and are drawn with one draw call each
+// (depth-tested, then on top); retained lists are uploaded once and drawn
+// every frame until replaced, for large static sets such as path networks.
+class DebugDraw : protected QOpenGLExtraFunctions {
+public:
+    enum Depth {
+        DepthTested,
+        Overlay // Drawn over everything, for gizmos and selection
+    };
+
+    struct Stats {
+        int drawCalls = 0;
+        int vertices = 0;
+        qint64 uploadedBytes = 0; // This frame
+    };
+
+    DebugDraw();
+
+    // Needs the viewport's GL context to be current
+    void initialize();
+    void destroy();
+
+    // This frame's lists, emptied by flush()
+    DebugDrawList& get(Depth depth) { return m_frameLists[depth]; }
+
+    void setRetained(const QString& name, const DebugDrawList& list, Depth depth = DepthTested);
+    void removeRetained(const QString& name);
+    bool hasRetained(const QString& name) const { return m_retained.contains(name); }
+
+    // Draws the retained lists and this frame's lists, then empties the
+    // latter. Leaves depth testing enabled and depth writes on.
+    void flush(const QMatrix4x4& viewProjection);
+
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    struct Retained {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        int vertexCount = 0;
+        Depth depth = DepthTested;
+    };
+
+    void setupAttributes();
+    void release(Retained& retained);
+
+    bool m_initialized = false;
+    QOpenGLShaderProgram* m_shader = nullptr;
+
+    DebugDrawList m_frameLists[2];
+    GLuint m_frameVAO = 0;
+    GLuint m_frameVBO = 0;
+    qint64 m_frameCapacity = 0; // Bytes
+
+    QHash<QString, Retained> m_retained;
+    Stats m_stats;
+};
+
+#endif // DEBUG_DRAW_H
@@ -0,0 +1,194 @@
+#include "frame_preparer.h"
+#include "frustum.h"
+#include <algorithm>
+
+namespace {
+const int kChunkSize = 2048;
+}
+
+FramePreparer::FramePreparer(JobSystem& jobs)
+    : m_jobs(jobs) {
+}
+
+FramePreparer::~FramePreparer() {
+    cancel();
+}
+
+void FramePreparer::submit(const Input& input) {
+    cancel();
+    m_input = input;
+    m_pending = true;
+    m_jobs.run([this]() {
+        run(m_input, m_next);
+
+        // Dropping the snapshot lets the scene write its tables without
+        // detaching, even before the frame is taken
+        m_input = Input();
+    }, m_counter);
+}
+
+bool FramePreparer::take(Frame& out) {
+    if (!m_pending) {
+        return false;
+    }
+    m_jobs.wait(m_counter);
+    m_pending = false;
+    std::swap(out, m_next);
+    return true;
+}
+
+void FramePreparer::cancel() {
+    if (m_pending) {
+        m_jobs.wait(m_counter);
+        m_pending = false;
+    }
+}
+
+void FramePreparer::wait() {
+    if (m_pending) {
+        m_jobs.wait(m_counter);
+    }
+}
+
+void FramePreparer::prepare(const Input& input, Frame& out) {
+    cancel();
+    run(input, out);
+}
+
+const OcclusionCuller& FramePreparer::getOcclusionCuller() const {
+    if (m_pending) {
+        m_jobs.wait(m_counter);
+    }
+    return m_occlusionCuller;
+}
+
+void FramePreparer::run(const Input& input, Frame& out) {
+    const SceneManager::ViewSnapshot& scene = input.scene;
+    out.commands.clear();
+    out.sceneFrame = scene.frame;
+    out.structureVersion = input.structureVersion;
+    out.viewProjection = input.viewProjection;
+    out.hiddenLayers = scene.layers.getHiddenMask();
+    out.drawDistanceMultiplier = scene.drawDistanceMultiplier;
+    out.occlusionCulling = input.occlusionCulling;
+    out.totalObjects = input.drawInfo.size();
+    out.lodObjects = 0;
+
+    // Frustum and draw distance walk over the BVH, with HD instances
+    // swapped for their LODs at range; the cost follows what is on screen,
+    // not the size of the map
+    m_candidates.clear();
+    out.nodesVisited = scene.getEntitiesInView(Frustum(input.viewProjection), input.eye, m_candidates);
+
+    // Drawable and on a visible layer; hash lookups, so split over workers.
+    // Each chunk writes only its own range, through pointers taken up
+    // front so no worker goes through a detach check.
+    const quint64 hiddenLayers = scene.layers.getHiddenMask();
+    m_candidateDraws.resize(m_candidates.size());
+    const EntityId* candidates = m_candidates.constData();
+    int* candidateDraws = m_candidateDraws.data();
+    m_jobs.parallelFor(m_candidates.size(), kChunkSize, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            EntityId id = candidates[i];
+            int draw = input.drawIndex.value(id, -1);
+            candidateDraws[i] = draw >= 0 && !(scene.layers.getLayerBit(id) & hiddenLayers) ? draw : -1;
+        }
+    });
+
+    // Rasterise the OCCL boxes into the CPU depth buffer, then test the
+    // survivors in order
+    bool occlusion = input.occlusionCulling && !scene.occluders.isEmpty();
+    if (occlusion) {
+        m_occlusionCuller.beginFrame(input.viewProjection);
+        for (const IPLOcclusionZone& zone : scene.occluders) {
+            m_occlusionCuller.addOccluderZone(zone);
+        }
+    }
+
+    m_visibleIds.clear();
+    m_visibleDraws.clear();
+    out.inFrustum = 0;
+    for (int i = 0; i < m_candidates.size(); ++i) {
+        if (m_candidateDraws[i] < 0) {
+            continue;
+        }
+        EntityId id = m_candidates[i];
+        ++out.inFrustum;
+        if (occlusion) {
+            const BoundingBox* worldBounds = scene.bounds.find(id);
+            if (worldBounds && !m_occlusionCuller.isVisible(*worldBounds)) {
+                continue;
+            }
+        }
+        if (scene.lods.isLodParent(id)) {
+            ++out.lodObjects;
+        }
+        m_visibleIds.append(id);
+        m_visibleDraws.append(m_candidateDraws[i]);
+    }
+    out.visibleObjects = m_visibleIds.size();
+
+    // One queue item per visible entity, keyed by pass, state and view
+    // distance. Sorting brings instances of a mesh together (and orders
+    // transparent draws back to front), so each run of equal state keys
+    // becomes one instanced draw.
+    const int visible = m_visibleIds.size();
+    const float depthScale = 1.0f / input.farPlane;
+    m_visibleMatrices.resize(visible);
+    m_visibleKeys.resize(visible);
+    const EntityId* visibleIds = m_visibleIds.constData();
+    const int* visibleDraws = m_visibleDraws.constData();
+    QMatrix4x4* matrices = m_visibleMatrices.data();
+    quint64* keys = m_visibleKeys.data();
+    m_jobs.parallelFor(visible, kChunkSize, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            matrices[i] = scene.transforms.getWorldMatrix(visibleIds[i]);
+            float depth = (matrices[i].column(3).toVector3D() - input.eye).length() * depthScale;
+            const DrawInfo& info = input.drawInfo[visibleDraws[i]];
+            keys[i] = RenderQueue::makeKey(info.pass, 0, info.texture, info.model, depth);
+        }
+    });
+
+    m_renderQueue.clear();
+    m_renderQueue.reserve(visible);
+    for (int i = 0; i < visible; ++i) {
+        m_renderQueue.add(m_visibleKeys[i], i);
+    }
+    m_renderQueue.sort();
+
+    // Instance matrices in queue order, and where each entity landed so
+    // the GL thread can patch entities that move before the replay
+    const QVector<RenderQueue::Item>& items = m_renderQueue.getItems();
+    out.instanceData.resize(visible * 16);
+    EntityId maxId = 0;
+    for (EntityId id : m_visibleIds) {
+        maxId = qMax(maxId, id);
+    }
+    out.instanceOf.fill(-1, visible > 0 ? int(maxId) + 1 : 0);
+    out.instanceIds.resize(visible);
+    float* instanceData = out.instanceData.data();
+    int* instanceOf = out.instanceOf.data();
+    EntityId* instanceIds = out.instanceIds.data();
+    m_jobs.parallelFor(visible, kChunkSize, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            int payload = items[i].payload;
+            const float* world = matrices[payload].constData();
+            std::copy(world, world + 16, instanceData + i * 16);
+            instanceOf[visibleIds[payload]] = i;
+            instanceIds[i] = visibleIds[payload];
+        }
+    });
+
+    // Slots past their key field width alias, so a run also ends where the
+    // model or TXD changes; aliased slots then sort badly but draw right
+    for (int i = 0; i < visible; ++i) {
+        quint64 stateKey = RenderQueue::getStateKey(items[i].key);
+        const DrawInfo& info = input.drawInfo[m_visibleDraws[items[i].payload]];
+        if (out.commands.isEmpty() || out.commands.last().stateKey != stateKey
+            || out.commands.last().info.model != info.model
+            || out.commands.last().info.texture != info.texture) {
+            out.commands.append(Frame::Command{stateKey, info, i, 0});
+        }
+        ++out.commands.last().instanceCount;
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef FRAME_PREPARER_H
+#define FRAME_PREPARER_H
+
+#include "scene_manager.h"
+#include "render_queue.h"
+#include "occlusion_culler.h"
+#include "system_scheduler.h"
+#include <QHash>
+#include <QMatrix4x4>
+#include <QVector>
+
+// The CPU half of a frame, off the GL thread. The GUI thread extracts an
+// Input (a scene view snapshot plus the renderer's draw list, both
+// implicitly shared copies); prepare() culls it, sorts the survivors
+// through a RenderQueue and lays out their instance matrices, producing a
+// Frame: a flat list of instanced draws the GL thread replays without
+// touching the scene. submit() runs the preparation as a job, so the next
+// frame is prepared while the current one is on screen; the job releases
+// its Input as soon as it is done, so the snapshot does not outlive it.
+class FramePreparer {
+public:
+    // What a draw-list entry needs for its sort key: model and texture
+    // dictionary (names interned to small slots by the renderer) and the
+    // pass its IDE flags put it in
+    struct DrawInfo {
+        int model;
+        int texture;
+        RenderQueue::Pass pass;
+    };
+
+    struct Input {
+        SceneManager::ViewSnapshot scene;
+        QHash<EntityId, int> drawIndex; // Drawable entities, into drawInfo
+        QVector<DrawInfo> drawInfo;
+        QMatrix4x4 viewProjection;      // Culled against, occluders rasterised with
+        QVector3D eye;
+        float farPlane = 1000.0f;
+        bool occlusionCulling = true;
+        quint64 structureVersion = 0;   // Caller's stamp, copied to the frame
+    };
+
+    struct Frame {
+        // One instanced draw: a run of queue items with the same state key
+        struct Command {
+            quint64 stateKey;
+            DrawInfo info;
+            int firstInstance;
+            int instanceCount;
+        };
+
+        QVector<Command> commands;
+        QVector<float> instanceData;   // One world matrix per instance, in command order
+        QVector<int> instanceOf;       // Instance by EntityId; -1 if not drawn
+        QVector<EntityId> instanceIds; // EntityId by instance, for the id pass
+        quint64 sceneFrame = 0;
+        quint64 structureVersion = 0;
+        QMatrix4x4 viewProjection;
+        quint64 hiddenLayers = 0;
+        float drawDistanceMultiplier = 1.0f;
+        bool occlusionCulling = true;
+
+        // Culling results
+        int totalObjects = 0;
+        int inFrustum = 0;
+        int visibleObjects = 0;
+        int lodObjects = 0;
+        int nodesVisited = 0;
+    };
+
+    explicit FramePreparer(JobSystem& jobs = JobSystem::instance());
+    ~FramePreparer();
+
+    // Starts preparing a frame on a worker; a frame still pending is
+    // finished first and dropped
+    void submit(const Input& input);
+    bool isPending() const { return m_pending; }
+
+    // Waits for the submitted frame and swaps it into out (whose buffers
+    // are reused for the next one). False if nothing was submitted.
+    bool take(Frame& out);
+    void cancel();
+
+    // Waits for the submitted frame without taking it; its Input has been
+    // released by then. The scene's snapshot fence.
+    void wait();
+
+    // Prepares on the calling thread, cancelling anything pending
+    void prepare(const Input& input, Frame& out);
+
+    // The culler of the most recently prepared frame; waits for one that
+    // is still being prepared
+    const OcclusionCuller& getOcclusionCuller() const;
+
+private:
+    void run(const Input& input, Frame& out);
+
+    JobSystem& m_jobs;
+    mutable JobSystem::Counter m_counter;
+    bool m_pending = false;
+    Input m_input;
+    Frame m_next;
+
+    // Working buffers, reused between frames
+    OcclusionCuller m_occlusionCuller;
+    RenderQueue m_renderQueue;
+    QVector<EntityId> m_candidates;
+    QVector<int> m_candidateDraws; // Draw-list index per candidate; -1 if not drawn
+    QVector<EntityId> m_visibleIds;
+    QVector<int> m_visibleDraws;
+    QVector<QMatrix4x4> m_visibleMatrices;
+    QVector<quint64> m_visibleKeys;
+};
+
+#endif // FRAME_PREPARER_H
@@ -0,0 +1,282 @@
+#include "gpu_mesh_cache.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const int kFloatsPerVertex = 8; // Position, normal, texcoord
+const qint64 kVertexStride = kFloatsPerVertex * sizeof(float);
+}
+
+GpuMeshCache::GpuMeshCache() = default;
+
+void GpuMeshCache::initialize() {
+    initializeOpenGLFunctions();
+    m_initialized = true;
+}
+
+void GpuMeshCache::destroy() {
+    if (m_initialized) {
+        clear();
+    }
+    m_initialized = false;
+}
+
+void GpuMeshCache::setBudget(qint64 bytes) {
+    m_budget = qMax<qint64>(0, bytes);
+}
+
+void GpuMeshCache::setUploadBytesPerFrame(qint64 bytes) {
+    // At least one vertex per frame, so uploads always make progress
+    m_uploadBytesPerFrame = qMax(kVertexStride, bytes);
+}
+
+void GpuMeshCache::beginFrame() {
+    ++m_frame;
+    m_stats.uploadedBytes = 0;
+    m_stats.evictions = 0;
+    m_uploadBytesLeft = m_uploadBytesPerFrame;
+    if (m_initialized) {
+        pumpUploads();
+    }
+}
+
+void GpuMeshCache::endFrame() {
+    if (m_initialized) {
+        evict();
+    }
+    m_stats.residentMeshes = m_entries.size();
+    m_stats.pendingMeshes = m_pending.size();
+    m_stats.residentBytes = m_residentBytes;
+}
+
+const GpuMesh* GpuMeshCache::request(const QString& assetId, const GTAModel& model) {
+    if (!m_initialized) {
+        return nullptr;
+    }
+
+    auto it = m_entries.find(assetId);
+    if (it == m_entries.end()) {
+        bool hasTriangles = false;
+        for (const GTAMesh& mesh : model.meshes) {
+            hasTriangles = hasTriangles || mesh.indices.size() >= 3 || mesh.vertices.size() >= 3;
+        }
+        if (!hasTriangles) {
+            return nullptr;
+        }
+
+        it = m_entries.insert(assetId, Entry());
+        stage(it.value(), model);
+        m_pending.enqueue(assetId);
+
+        // Small meshes fit in what is left of this frame's budget
+        pumpUploads();
+    }
+
+    Entry& entry = it.value();
+    entry.lastUsedFrame = m_frame;
+    return entry.ready ? &entry.mesh : nullptr;
+}
+
+bool GpuMeshCache::contains(const QString& assetId) const {
+    return m_entries.contains(assetId);
+}
+
+const GpuMesh* GpuMeshCache::find(const QString& assetId) const {
+    auto it = m_entries.constFind(assetId);
+    return it != m_entries.constEnd() && it->ready ? &it->mesh : nullptr;
+}
+
+void GpuMeshCache::remove(const QString& assetId) {
+    auto it = m_entries.find(assetId);
+    if (it != m_entries.end()) {
+        release(it.value());
+        m_entries.erase(it);
+    }
+}
+
+void GpuMeshCache::clear() {
+    for (Entry& entry : m_entries) {
+        release(entry);
+    }
+    m_entries.clear();
+    m_pending.clear();
+    m_residentBytes = 0;
+}
+
+void GpuMeshCache::stage(Entry& entry, const GTAModel& model) {
+    int vertexCount = 0;
+    int indexCount = 0;
+    for (const GTAMesh& mesh : model.meshes) {
+        vertexCount += mesh.vertices.size();
+        indexCount += mesh.indices.isEmpty() ? mesh.vertices.size() / 3 * 3 : mesh.indices.size();
+    }
+
+    // Interleave on the CPU once; indices are rebased so every part draws
+    // from the shared vertex buffer without a base vertex
+    entry.vertexBytes = vertexCount * kVertexStride;
+    const qint64 indexBytes = indexCount * qint64(sizeof(uint32_t));
+    entry.staging = QByteArray(entry.vertexBytes + indexBytes, Qt::Uninitialized);
+
+    float* vertexOut = reinterpret_cast<float*>(entry.staging.data());
+    uint32_t* indexOut = reinterpret_cast<uint32_t*>(entry.staging.data() + entry.vertexBytes);
+    uint32_t baseVertex = 0;
+    int firstIndex = 0;
+    for (const GTAMesh& mesh : model.meshes) {
+        for (const GTAVertex& vertex : mesh.vertices) {
+            *vertexOut++ = vertex.position.x();
+            *vertexOut++ = vertex.position.y();
+            *vertexOut++ = vertex.position.z();
+            *vertexOut++ = vertex.normal.x();
+            *vertexOut++ = vertex.normal.y();
+            *vertexOut++ = vertex.normal.z();
+            *vertexOut++ = vertex.texCoord.x();
+            *vertexOut++ = vertex.texCoord.y();
+        }
+
+        int partCount = 0;
+        if (mesh.indices.isEmpty()) {
+            partCount = mesh.vertices.size() / 3 * 3;
+            for (int i = 0; i < partCount; ++i) {
+                *indexOut++ = baseVertex + i;
+            }
+        } else {
+            partCount = mesh.indices.size();
+            for (uint32_t index : mesh.indices) {
+                *indexOut++ = baseVertex + index;
+            }
+        }
+        if (partCount > 0) {
+            entry.mesh.parts.append(GpuMesh::Part{firstIndex, partCount, mesh.material.diffuse,
+                                                   mesh.material.textureName.toLower()});
+        }
+        baseVertex += mesh.vertices.size();
+        firstIndex += partCount;
+    }
+
+    // Size both buffers now; the data follows in chunks
+    glGenVertexArrays(1, &entry.mesh.vao);
+    glGenBuffers(1, &entry.mesh.vbo);
+    glGenBuffers(1, &entry.mesh.ebo);
+
+    glBindVertexArray(entry.mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, entry.mesh.vbo);
+    glBufferData(GL_ARRAY_BUFFER, entry.vertexBytes, nullptr, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, kVertexStride, nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, kVertexStride, reinterpret_cast<void*>(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, kVertexStride, reinterpret_cast<void*>(6 * sizeof(float)));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, entry.mesh.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    entry.mesh.bytes = entry.staging.size();
+    m_residentBytes += entry.mesh.bytes;
+}
+
+void GpuMeshCache::pumpUploads() {
+    while (m_uploadBytesLeft > 0 && !m_pending.isEmpty()) {
+        auto it = m_entries.find(m_pending.head());
+        if (it == m_entries.end() || it.value().ready) {
+            // Evicted or removed before it finished
+            m_pending.dequeue();
+            continue;
+        }
+
+        Entry& entry = it.value();
+        qint64 before = entry.uploadedBytes;
+        bool done = uploadChunk(entry, m_uploadBytesLeft);
+        m_uploadBytesLeft -= entry.uploadedBytes - before;
+        m_stats.uploadedBytes += entry.uploadedBytes - before;
+        if (!done) {
+            break;
+        }
+        m_pending.dequeue();
+    }
+}
+
+bool GpuMeshCache::uploadChunk(Entry& entry, qint64 maxBytes) {
+    const qint64 total = entry.staging.size();
+    qint64 begin = entry.uploadedBytes;
+    qint64 end = qMin(total, begin + maxBytes);
+
+    // The element buffer binding belongs to the VAO
+    glBindVertexArray(entry.mesh.vao);
+    if (begin < entry.vertexBytes) {
+        qint64 vertexEnd = qMin(end, entry.vertexBytes);
+        glBindBuffer(GL_ARRAY_BUFFER, entry.mesh.vbo);
+        writeBuffer(GL_ARRAY_BUFFER, begin, entry.staging.constData() + begin, vertexEnd - begin);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    if (end > entry.vertexBytes) {
+        qint64 indexBegin = qMax(begin, entry.vertexBytes);
+        writeBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBegin - entry.vertexBytes,
+                    entry.staging.constData() + indexBegin, end - indexBegin);
+    }
+    glBindVertexArray(0);
+
+    entry.uploadedBytes = end;
+    if (end == total) {
+        entry.ready = true;
+        entry.staging = QByteArray();
+    }
+    return entry.ready;
+}
+
+void GpuMeshCache::writeBuffer(GLenum target, qint64 offset, const char* data, qint64 size) {
+    if (size <= 0) {
+        return;
+    }
+
+    // Nothing draws from this range yet, so the map needs no synchronisation
+    void* mapped = glMapBufferRange(target, offset, size,
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (mapped) {
+        std::memcpy(mapped, data, size);
+        if (glUnmapBuffer(target)) {
+            return;
+        }
+    }
+    glBufferSubData(target, offset, size, data);
+}
+
+void GpuMeshCache::release(Entry& entry) {
+    if (entry.mesh.vao) {
+        glDeleteVertexArrays(1, &entry.mesh.vao);
+    }
+    if (entry.mesh.vbo) {
+        glDeleteBuffers(1, &entry.mesh.vbo);
+    }
+    if (entry.mesh.ebo) {
+        glDeleteBuffers(1, &entry.mesh.ebo);
+    }
+    m_residentBytes -= entry.mesh.bytes;
+    entry.mesh = GpuMesh();
+}
+
+void GpuMeshCache::evict() {
+    if (m_residentBytes <= m_budget) {
+        return;
+    }
+
+    // Oldest first; meshes drawn this frame are never evicted, so a view
+    // that needs more than the budget overshoots instead of thrashing
+    QVector<QPair<quint64, QString>> candidates;
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        if (it.value().lastUsedFrame < m_frame) {
+            candidates.append(qMakePair(it.value().lastUsedFrame, it.key()));
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const QPair<quint64, QString>& a, const QPair<quint64, QString>& b) { return a.first < b.first; });
+
+    for (const auto& candidate : candidates) {
+        if (m_residentBytes <= m_budget) {
+            break;
+        }
+        remove(candidate.second);
+        ++m_stats.evictions;
+    }
+}
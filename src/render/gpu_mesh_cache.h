@@ -0,0 +1,108 @@
+#ifndef GPU_MESH_CACHE_H
+#define GPU_MESH_CACHE_H
+
+#include "types.h"
+#include <QOpenGLExtraFunctions>
+#include <QByteArray>
+#include <QHash>
+#include <QQueue>
+#include <QString>
+#include <QVector>
+
+// Model geometry resident on the GPU: one interleaved vertex buffer
+// (position, normal, texcoord; 32 bytes per vertex) and one index buffer
+// per model, with the model's meshes as index ranges into it.
+struct GpuMesh {
+    struct Part {
+        int firstIndex = 0;
+        int indexCount = 0;
+        QVector3D color;
+        QString textureName; // Lower-case, as TXD lookups expect
+    };
+
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    QVector<Part> parts;
+    qint64 bytes = 0;
+};
+
+// GPU meshes keyed by asset id (the model name), uploaded once and kept
+// under a VRAM budget with least-recently-used eviction.
+//
+// Uploads never block a frame. A requested mesh gets its buffers sized
+// up front, then its data is streamed in over as many frames as the
+// per-frame upload budget needs, written through unsynchronised
+// invalidating maps (the buffers are not drawn from until complete, so the
+// driver need not wait). Until then request() returns nullptr and the
+// caller draws a stand-in. Plain GL 3.3, so it also runs on llvmpipe.
+class GpuMeshCache : protected QOpenGLExtraFunctions {
+public:
+    struct Stats {
+        int residentMeshes = 0;
+        int pendingMeshes = 0;
+        qint64 residentBytes = 0;
+        qint64 uploadedBytes = 0; // This frame
+        int evictions = 0;        // This frame
+    };
+
+    GpuMeshCache();
+
+    // Needs the viewport's GL context to be current
+    void initialize();
+    void destroy();
+
+    void setBudget(qint64 bytes);
+    qint64 getBudget() const { return m_budget; }
+    void setUploadBytesPerFrame(qint64 bytes);
+    qint64 getUploadBytesPerFrame() const { return m_uploadBytesPerFrame; }
+
+    // Frame bracket: beginFrame() continues pending uploads within the
+    // frame's upload budget; endFrame() evicts meshes not used this frame
+    // until the cache is back under budget
+    void beginFrame();
+    void endFrame();
+
+    // The mesh for drawing, or nullptr while it is still uploading. The
+    // first request for an id stages the model and starts its upload.
+    const GpuMesh* request(const QString& assetId, const GTAModel& model);
+
+    bool contains(const QString& assetId) const;
+
+    // A mesh that is ready, without staging or touching its LRU stamp
+    const GpuMesh* find(const QString& assetId) const;
+    void remove(const QString& assetId);
+    void clear();
+
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    struct Entry {
+        GpuMesh mesh;
+        QByteArray staging;       // Vertex bytes followed by index bytes; freed once uploaded
+        qint64 vertexBytes = 0;
+        qint64 uploadedBytes = 0;
+        quint64 lastUsedFrame = 0;
+        bool ready = false;
+    };
+
+    void stage(Entry& entry, const GTAModel& model);
+    void pumpUploads();
+    bool uploadChunk(Entry& entry, qint64 maxBytes);
+    void writeBuffer(GLenum target, qint64 offset, const char* data, qint64 size);
+    void release(Entry& entry);
+    void evict();
+
+    bool m_initialized = false;
+    qint64 m_budget = 512ll * 1024 * 1024;
+    qint64 m_uploadBytesPerFrame = 8ll * 1024 * 1024;
+    qint64 m_uploadBytesLeft = 0;
+    quint64 m_frame = 0;
+
+    QHash<QString, Entry> m_entries;
+    QQueue<QString> m_pending; // Upload order
+    qint64 m_residentBytes = 0;
+    Stats m_stats;
+};
+
+#endif // GPU_MESH_CACHE_H
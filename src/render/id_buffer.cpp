@@ -0,0 +1,279 @@
+#include "id_buffer.h"
+#include <QDebug>
+
+IdBuffer::IdBuffer() = default;
+
+bool IdBuffer::initialize() {
+    initializeOpenGLFunctions();
+
+    const char* vertexShader = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        layout (location = 3) in mat4 aModel; // Per instance, as in the mesh shader
+
+        uniform mat4 viewProjection;
+        uniform usamplerBuffer instanceIds;
+        uniform int firstInstance;
+
+        flat out uint entityId;
+
+        void main() {
+            entityId = texelFetch(instanceIds, firstInstance + gl_InstanceID).r;
+            gl_Position = viewProjection * aModel * vec4(aPos, 1.0);
+        }
+    )";
+
+    const char* fragmentShader = R"(
+        #version 330 core
+        flat in uint entityId;
+        layout (location = 0) out uint FragId;
+
+        void main() {
+            FragId = entityId;
+        }
+    )";
+
+    m_shader = new QOpenGLShaderProgram();
+    m_shader->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader);
+    m_shader->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader);
+    if (!m_shader->link()) {
+        qWarning() << "IdBuffer: Failed to link shader; picking falls back to raycasts:" << m_shader->log();
+        delete m_shader;
+        m_shader = nullptr;
+        return false;
+    }
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glGenRenderbuffers(1, &m_colorBuffer);
+    glGenRenderbuffers(1, &m_depthBuffer);
+
+    glGenBuffers(1, &m_idVBO);
+    glGenTextures(1, &m_idTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, m_idVBO);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(quint32), nullptr, GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, m_idTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_idVBO);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    for (Readback& readback : m_readbacks) {
+        glGenBuffers(1, &readback.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(quint32), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // Completeness can only be checked with storage attached
+    resize(1, 1);
+    const GLuint previous = getBinding(GL_DRAW_FRAMEBUFFER_BINDING);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+    m_available = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous);
+    if (!m_available) {
+        qWarning() << "IdBuffer: Integer framebuffer incomplete; picking falls back to raycasts";
+    }
+    return m_available;
+}
+
+void IdBuffer::destroy() {
+    if (!m_shader) {
+        return;
+    }
+    for (Readback& readback : m_readbacks) {
+        if (readback.fence) {
+            glDeleteSync(readback.fence);
+        }
+        glDeleteBuffers(1, &readback.pbo);
+        readback = Readback();
+    }
+    glDeleteTextures(1, &m_idTexture);
+    glDeleteBuffers(1, &m_idVBO);
+    glDeleteRenderbuffers(1, &m_colorBuffer);
+    glDeleteRenderbuffers(1, &m_depthBuffer);
+    glDeleteFramebuffers(1, &m_framebuffer);
+    m_idTexture = m_idVBO = m_colorBuffer = m_depthBuffer = m_framebuffer = 0;
+    m_width = m_height = 0;
+    m_latest = -1;
+    m_nextSlot = 0;
+    m_drawn = false;
+    delete m_shader;
+    m_shader = nullptr;
+    m_available = false;
+}
+
+bool IdBuffer::isCurrent(quint64 frame, const QMatrix4x4& viewProjection, int width, int height) const {
+    return m_drawn && m_frame == frame && m_viewProjection == viewProjection
+        && m_width == width && m_height == height;
+}
+
+void IdBuffer::begin(quint64 frame, const QMatrix4x4& viewProjection, int width, int height,
+                     const QVector<EntityId>& instanceIds) {
+    resize(width, height);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, m_idVBO);
+    glBufferData(GL_TEXTURE_BUFFER, qMax<qint64>(1, instanceIds.size()) * sizeof(quint32),
+                 instanceIds.constData(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+    glViewport(0, 0, width, height);
+    const GLuint noEntity[4] = {0, 0, 0, 0};
+    const GLfloat farDepth = 1.0f;
+    glDepthMask(GL_TRUE);
+    glClearBufferuiv(GL_COLOR, 0, noEntity);
+    glClearBufferfv(GL_DEPTH, 0, &farDepth);
+
+    // Every surface is opaque here; blending does not apply to integer
+    // targets anyway
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    m_shader->bind();
+    m_shader->setUniformValue("viewProjection", viewProjection);
+    m_shader->setUniformValue("instanceIds", 0);
+    m_shader->setUniformValue("firstInstance", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, m_idTexture);
+
+    m_drawn = true;
+    m_frame = frame;
+    m_viewProjection = viewProjection;
+}
+
+void IdBuffer::setFirstInstance(int firstInstance) {
+    m_shader->setUniformValue("firstInstance", firstInstance);
+}
+
+void IdBuffer::end(GLuint framebuffer, int viewportWidth, int viewportHeight) {
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    m_shader->release();
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, viewportWidth, viewportHeight);
+    glEnable(GL_BLEND);
+}
+
+EntityId IdBuffer::readId(int x, int y) {
+    if (!contains(x, y)) {
+        return 0;
+    }
+    quint32 id = 0;
+    const GLuint previous = bindForReading();
+    glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, &id);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+    return id;
+}
+
+void IdBuffer::readIds(const QRect& region, QSet<EntityId>& out) {
+    const QRect clipped = region.intersected(QRect(0, 0, m_width, m_height));
+    if (clipped.isEmpty()) {
+        return;
+    }
+    m_readScratch.resize(clipped.width() * clipped.height());
+    const GLuint previous = bindForReading();
+    glReadPixels(clipped.x(), clipped.y(), clipped.width(), clipped.height(),
+                 GL_RED_INTEGER, GL_UNSIGNED_INT, m_readScratch.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+
+    // Runs of one id are the common case; skip the set for repeats
+    quint32 last = 0;
+    for (quint32 id : m_readScratch) {
+        if (id != last) {
+            if (id != 0) {
+                out.insert(id);
+            }
+            last = id;
+        }
+    }
+}
+
+void IdBuffer::requestId(int x, int y) {
+    if (!contains(x, y)) {
+        return;
+    }
+    const int slot = m_nextSlot;
+    m_nextSlot = (m_nextSlot + 1) % ReadbackCount;
+    Readback& readback = m_readbacks[slot];
+    if (readback.fence) {
+        glDeleteSync(readback.fence);
+    }
+
+    // Into the pixel buffer, so the call returns without waiting for the
+    // pass to finish; the fence says when the value has landed
+    const GLuint previous = bindForReading();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    m_latest = slot;
+}
+
+bool IdBuffer::pollId(EntityId& id) {
+    if (m_latest < 0) {
+        return false;
+    }
+    Readback& readback = m_readbacks[m_latest];
+    GLenum status = glClientWaitSync(readback.fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+    m_latest = -1;
+    if (status == GL_WAIT_FAILED) {
+        return false;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(quint32), GL_MAP_READ_BIT);
+    id = data ? *static_cast<const quint32*>(data) : 0;
+    if (data) {
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return data != nullptr;
+}
+
+void IdBuffer::resize(int width, int height) {
+    width = qMax(1, width);
+    height = qMax(1, height);
+    if (width == m_width && height == m_height) {
+        return;
+    }
+    m_width = width;
+    m_height = height;
+    m_drawn = false;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    const GLuint previous = getBinding(GL_DRAW_FRAMEBUFFER_BINDING);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous);
+}
+
+GLuint IdBuffer::getBinding(GLenum binding) {
+    GLint framebuffer = 0;
+    glGetIntegerv(binding, &framebuffer);
+    return GLuint(framebuffer);
+}
+
+GLuint IdBuffer::bindForReading() {
+    // The widget renders into its own framebuffer, not 0, so whatever was
+    // bound is put back afterwards
+    const GLuint previous = getBinding(GL_READ_FRAMEBUFFER_BINDING);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    return previous;
+}
+
+bool IdBuffer::contains(int x, int y) const {
+    return m_available && m_drawn && x >= 0 && y >= 0 && x < m_width && y < m_height;
+}
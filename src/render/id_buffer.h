@@ -0,0 +1,90 @@
+#ifndef ID_BUFFER_H
+#define ID_BUFFER_H
+
+#include "types.h"
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QRect>
+#include <QSet>
+#include <QVector>
+
+// Entity ids rendered into an integer framebuffer, for exact per-pixel
+// picking. The pass reuses the frame's instanced draws: the caller binds
+// each mesh with its instance matrices as usual and calls
+// setFirstInstance(), and the shader looks the entity up in a buffer
+// texture of ids in instance order. 0 means no entity.
+//
+// The buffer is only drawn when something asks for an id and the last
+// pass is out of date. Reads are either synchronous (clicks, marquee) or
+// queued through pixel buffer objects with a fence (hover), so a cursor
+// moving over the view never waits for the GPU.
+class IdBuffer : protected QOpenGLExtraFunctions {
+public:
+    IdBuffer();
+
+    // Needs the viewport's GL context to be current. False if the integer
+    // framebuffer is unsupported; picking then has to go through the CPU.
+    bool initialize();
+    void destroy();
+    bool isAvailable() const { return m_available; }
+
+    // Whether the last pass was drawn for this frame stamp, view and size
+    bool isCurrent(quint64 frame, const QMatrix4x4& viewProjection, int width, int height) const;
+
+    // Pass bracket. begin() sizes and clears the target, binds the id
+    // shader and uploads the instance ids; end() restores the given
+    // framebuffer and viewport. Depth testing is left enabled.
+    void begin(quint64 frame, const QMatrix4x4& viewProjection, int width, int height,
+               const QVector<EntityId>& instanceIds);
+    void setFirstInstance(int firstInstance);
+    void end(GLuint framebuffer, int viewportWidth, int viewportHeight);
+
+    // Synchronous reads in device pixels, rows bottom-up
+    EntityId readId(int x, int y);
+    void readIds(const QRect& region, QSet<EntityId>& out);
+
+    // Asynchronous single-pixel read. A new request supersedes any still in
+    // flight; pollId() gives the latest result once the GPU has written it.
+    void requestId(int x, int y);
+    bool pollId(EntityId& id);
+    bool isReadPending() const { return m_latest >= 0; }
+
+private:
+    struct Readback {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+    };
+    static const int ReadbackCount = 2;
+
+    void resize(int width, int height);
+    GLuint getBinding(GLenum binding);
+    GLuint bindForReading(); // Returns the read framebuffer it replaced
+    bool contains(int x, int y) const;
+
+    bool m_available = false;
+    QOpenGLShaderProgram* m_shader = nullptr;
+
+    GLuint m_framebuffer = 0;
+    GLuint m_colorBuffer = 0;
+    GLuint m_depthBuffer = 0;
+    int m_width = 0;
+    int m_height = 0;
+
+    // Entity id per instance, read by the shader through a buffer texture
+    GLuint m_idVBO = 0;
+    GLuint m_idTexture = 0;
+
+    Readback m_readbacks[ReadbackCount];
+    int m_latest = -1; // Slot of the request pollId() waits on; -1 if none
+    int m_nextSlot = 0;
+
+    // What the last pass was drawn for
+    bool m_drawn = false;
+    quint64 m_frame = 0;
+    QMatrix4x4 m_viewProjection;
+
+    QVector<quint32> m_readScratch;
+};
+
+#endif // ID_BUFFER_H
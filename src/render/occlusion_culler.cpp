@@ -0,0 +1,294 @@
+#include "occlusion_culler.h"
+#include <QtMath>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_CULLER_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Corner indices of a box face quad; bit 0 selects max X, bit 1 max Y,
+// bit 2 max Z
+const int kBoxFaces[6][4] = {
+    {0, 2, 6, 4}, {1, 5, 7, 3},
+    {0, 4, 5, 1}, {2, 3, 7, 6},
+    {0, 1, 3, 2}, {4, 6, 7, 5}
+};
+
+// Distance of a clip-space point in front of the near plane (z = -w)
+inline float nearDistance(const QVector4D& v) {
+    return v.z() + v.w();
+}
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height) {
+    setResolution(width, height);
+}
+
+void OcclusionCuller::setResolution(int width, int height) {
+    m_width = (qMax(width, 4) + 3) & ~3;
+    m_height = qMax(height, 1);
+    m_depth.fill(1.0f, m_width * m_height);
+}
+
+void OcclusionCuller::beginFrame(const QMatrix4x4& viewProjection) {
+    m_viewProjection = viewProjection;
+    m_depth.fill(1.0f, m_width * m_height);
+    m_triangleCount = 0;
+    m_testedCount = 0;
+    m_culledCount = 0;
+}
+
+void OcclusionCuller::addOccluderBox(const QMatrix4x4& model, const BoundingBox& localBox) {
+    QMatrix4x4 toClip = m_viewProjection * model;
+    QVector4D corners[8];
+    for (int i = 0; i < 8; ++i) {
+        QVector4D corner(i & 1 ? localBox.max.x() : localBox.min.x(),
+                         i & 2 ? localBox.max.y() : localBox.min.y(),
+                         i & 4 ? localBox.max.z() : localBox.min.z(), 1.0f);
+        corners[i] = toClip * corner;
+    }
+
+    for (const auto& face : kBoxFaces) {
+        rasterizeTriangle(corners[face[0]], corners[face[1]], corners[face[2]]);
+        rasterizeTriangle(corners[face[0]], corners[face[2]], corners[face[3]]);
+    }
+}
+
+void OcclusionCuller::addOccluderZone(const IPLOcclusionZone& zone) {
+    QMatrix4x4 model;
+    model.translate(zone.center());
+    model.rotate(zone.rotation.x(), 0.0f, 0.0f, 1.0f);
+    model.rotate(zone.rotation.y(), 1.0f, 0.0f, 0.0f);
+    model.rotate(zone.rotation.z(), 0.0f, 1.0f, 0.0f);
+
+    QVector3D half = zone.size * 0.5f;
+    addOccluderBox(model, BoundingBox(-half, half));
+}
+
+void OcclusionCuller::addOccluderMesh(const GTAMesh& mesh, const QMatrix4x4& model) {
+    QMatrix4x4 toClip = m_viewProjection * model;
+    QVector<QVector4D> clip;
+    clip.reserve(mesh.vertices.size());
+    for (const GTAVertex& vertex : mesh.vertices) {
+        clip.append(toClip * QVector4D(vertex.position, 1.0f));
+    }
+
+    for (int i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        uint32_t a = mesh.indices[i];
+        uint32_t b = mesh.indices[i + 1];
+        uint32_t c = mesh.indices[i + 2];
+        if (a < uint32_t(clip.size()) && b < uint32_t(clip.size()) && c < uint32_t(clip.size())) {
+            rasterizeTriangle(clip[a], clip[b], clip[c]);
+        }
+    }
+}
+
+bool OcclusionCuller::isVisible(const BoundingBox& worldBox) const {
+    ++m_testedCount;
+
+    float minX = m_width;
+    float minY = m_height;
+    float maxX = 0.0f;
+    float maxY = 0.0f;
+    float minZ = 1.0f;
+    for (int i = 0; i < 8; ++i) {
+        QVector4D corner(i & 1 ? worldBox.max.x() : worldBox.min.x(),
+                         i & 2 ? worldBox.max.y() : worldBox.min.y(),
+                         i & 4 ? worldBox.max.z() : worldBox.min.z(), 1.0f);
+        QVector4D clip = m_viewProjection * corner;
+        if (nearDistance(clip) <= 0.0f) {
+            return true; // Crosses the near plane; too close to decide
+        }
+
+        float invW = 1.0f / clip.w();
+        float x = (clip.x() * invW * 0.5f + 0.5f) * m_width;
+        float y = (clip.y() * invW * 0.5f + 0.5f) * m_height;
+        minX = qMin(minX, x);
+        maxX = qMax(maxX, x);
+        minY = qMin(minY, y);
+        maxY = qMax(maxY, y);
+        minZ = qMin(minZ, clip.z() * invW);
+    }
+
+    // Frustum culling is not this class's job; off-screen boxes pass
+    if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height) {
+        return true;
+    }
+
+    int x0 = qMax(0, int(std::floor(minX)));
+    int x1 = qMin(m_width - 1, int(std::floor(maxX)));
+    int y0 = qMax(0, int(std::floor(minY)));
+    int y1 = qMin(m_height - 1, int(std::floor(maxY)));
+
+    // Visible as soon as one pixel's occluder is not in front of the box
+    for (int y = y0; y <= y1; ++y) {
+        const float* row = m_depth.constData() + y * m_width;
+#ifdef OCCLUSION_CULLER_USE_SSE
+        const __m128 nearest = _mm_set1_ps(minZ);
+        const __m128i first = _mm_set1_epi32(x0);
+        const __m128i last = _mm_set1_epi32(x1);
+        for (int x = x0 & ~3; x <= x1; x += 4) {
+            __m128i lanes = _mm_add_epi32(_mm_set1_epi32(x), _mm_set_epi32(3, 2, 1, 0));
+            __m128i inRange = _mm_andnot_si128(
+                _mm_or_si128(_mm_cmplt_epi32(lanes, first), _mm_cmpgt_epi32(lanes, last)),
+                _mm_set1_epi32(-1));
+            __m128 notHidden = _mm_cmpge_ps(_mm_loadu_ps(row + x), nearest);
+            if (_mm_movemask_ps(_mm_and_ps(notHidden, _mm_castsi128_ps(inRange)))) {
+                return true;
+            }
+        }
+#else
+        for (int x = x0; x <= x1; ++x) {
+            if (row[x] >= minZ) {
+                return true;
+            }
+        }
+#endif
+    }
+
+    ++m_culledCount;
+    return false;
+}
+
+void OcclusionCuller::rasterizeTriangle(const QVector4D& a, const QVector4D& b, const QVector4D& c) {
+    ++m_triangleCount;
+
+    const QVector4D input[3] = {a, b, c};
+    if (nearDistance(a) >= 0.0f && nearDistance(b) >= 0.0f && nearDistance(c) >= 0.0f) {
+        rasterizeClipped(input, 3);
+        return;
+    }
+
+    // Clip against the near plane; a triangle becomes at most a quad
+    QVector4D clipped[4];
+    int count = 0;
+    for (int i = 0; i < 3; ++i) {
+        const QVector4D& current = input[i];
+        const QVector4D& next = input[(i + 1) % 3];
+        float dCurrent = nearDistance(current);
+        float dNext = nearDistance(next);
+        if (dCurrent >= 0.0f) {
+            clipped[count++] = current;
+        }
+        if ((dCurrent >= 0.0f) != (dNext >= 0.0f)) {
+            float t = dCurrent / (dCurrent - dNext);
+            clipped[count++] = current + (next - current) * t;
+        }
+    }
+    rasterizeClipped(clipped, count);
+}
+
+void OcclusionCuller::rasterizeClipped(const QVector4D* clip, int count) {
+    if (count < 3) {
+        return;
+    }
+
+    float xs[4];
+    float ys[4];
+    float zs[4];
+    for (int i = 0; i < count; ++i) {
+        float invW = 1.0f / qMax(clip[i].w(), 1.0e-6f);
+        xs[i] = (clip[i].x() * invW * 0.5f + 0.5f) * m_width;
+        ys[i] = (clip[i].y() * invW * 0.5f + 0.5f) * m_height;
+        zs[i] = clip[i].z() * invW;
+    }
+
+    // Fan out the clipped polygon
+    for (int i = 1; i + 1 < count; ++i) {
+        const float fanX[3] = {xs[0], xs[i], xs[i + 1]};
+        const float fanY[3] = {ys[0], ys[i], ys[i + 1]};
+        const float fanZ[3] = {zs[0], zs[i], zs[i + 1]};
+        fillTriangle(fanX, fanY, fanZ);
+    }
+}
+
+void OcclusionCuller::fillTriangle(const float* xs, const float* ys, const float* zs) {
+    float x0 = xs[0], y0 = ys[0], z0 = zs[0];
+    float x1 = xs[1], y1 = ys[1], z1 = zs[1];
+    float x2 = xs[2], y2 = ys[2], z2 = zs[2];
+
+    float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+    if (std::fabs(area) < 1.0e-6f) {
+        return;
+    }
+    if (area < 0.0f) {
+        std::swap(x1, x2);
+        std::swap(y1, y2);
+        std::swap(z1, z2);
+        area = -area;
+    }
+
+    int minX = qMax(0, int(std::floor(qMin(x0, qMin(x1, x2)))));
+    int maxX = qMin(m_width - 1, int(std::ceil(qMax(x0, qMax(x1, x2)))));
+    int minY = qMax(0, int(std::floor(qMin(y0, qMin(y1, y2)))));
+    int maxY = qMin(m_height - 1, int(std::ceil(qMax(y0, qMax(y1, y2)))));
+    if (minX > maxX || minY > maxY) {
+        return;
+    }
+
+    // Edge functions E = A * x + B * y + C, positive inside. A pixel is
+    // fully covered when E at its center exceeds half the edge's change
+    // across the pixel.
+    const float edgeA[3] = {y0 - y1, y1 - y2, y2 - y0};
+    const float edgeB[3] = {x1 - x0, x2 - x1, x0 - x2};
+    const float edgeC[3] = {
+        -(edgeA[0] * x0 + edgeB[0] * y0),
+        -(edgeA[1] * x1 + edgeB[1] * y1),
+        -(edgeA[2] * x2 + edgeB[2] * y2)
+    };
+    float threshold[3];
+    for (int i = 0; i < 3; ++i) {
+        threshold[i] = 0.5f * (std::fabs(edgeA[i]) + std::fabs(edgeB[i]));
+    }
+
+    // Depth plane, biased to the farthest value within a pixel
+    float dzdx = ((z1 - z0) * (y2 - y0) - (z2 - z0) * (y1 - y0)) / area;
+    float dzdy = ((z2 - z0) * (x1 - x0) - (z1 - z0) * (x2 - x0)) / area;
+    float zBias = 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+    float zC = z0 - dzdx * x0 - dzdy * y0 + zBias;
+
+    for (int y = minY; y <= maxY; ++y) {
+        float centerY = y + 0.5f;
+        float* row = m_depth.data() + y * m_width;
+#ifdef OCCLUSION_CULLER_USE_SSE
+        const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        __m128 rowE[3];
+        __m128 stepE[3];
+        for (int i = 0; i < 3; ++i) {
+            rowE[i] = _mm_set1_ps(edgeB[i] * centerY + edgeC[i] - threshold[i]);
+            stepE[i] = _mm_set1_ps(edgeA[i]);
+        }
+        const __m128 rowZ = _mm_set1_ps(dzdy * centerY + zC);
+        const __m128 stepZ = _mm_set1_ps(dzdx);
+        const __m128 zero = _mm_setzero_ps();
+
+        for (int x = minX & ~3; x <= maxX; x += 4) {
+            __m128 centerX = _mm_add_ps(_mm_set1_ps(float(x)), laneOffsets);
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(rowE[0], _mm_mul_ps(stepE[0], centerX)), zero);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(rowE[1], _mm_mul_ps(stepE[1], centerX)), zero));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(rowE[2], _mm_mul_ps(stepE[2], centerX)), zero));
+            if (!_mm_movemask_ps(inside)) {
+                continue;
+            }
+
+            __m128 depth = _mm_add_ps(rowZ, _mm_mul_ps(stepZ, centerX));
+            __m128 current = _mm_loadu_ps(row + x);
+            __m128 nearer = _mm_min_ps(current, depth);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+        }
+#else
+        for (int x = minX; x <= maxX; ++x) {
+            float centerX = x + 0.5f;
+            bool inside = true;
+            for (int i = 0; i < 3 && inside; ++i) {
+                inside = edgeA[i] * centerX + edgeB[i] * centerY + edgeC[i] >= threshold[i];
+            }
+            if (inside) {
+                row[x] = qMin(row[x], dzdx * centerX + dzdy * centerY + zC);
+            }
+        }
+#endif
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include "types.h"
+#include <QMatrix4x4>
+#include <QVector>
+#include <QVector4D>
+
+// Software occlusion culling on the CPU. Occluders (IPL OCCL boxes and
+// large meshes) are rasterised into a small depth buffer each frame, then
+// entity bounds are tested against it before anything is submitted to the
+// GPU. Rasterisation is conservative: a pixel only takes an occluder's
+// depth if the triangle covers it completely, using the triangle's
+// farthest depth within the pixel, so nothing visible is ever rejected.
+// Rows are processed four pixels at a time with SSE where available.
+// There is no GL dependency, so it runs headless.
+class OcclusionCuller {
+public:
+    explicit OcclusionCuller(int width = 256, int height = 128);
+
+    // Width is rounded up to a multiple of four
+    void setResolution(int width, int height);
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+
+    // Clears the depth buffer for a new view
+    void beginFrame(const QMatrix4x4& viewProjection);
+
+    // Occluders, in the frame's world space
+    void addOccluderBox(const QMatrix4x4& model, const BoundingBox& localBox);
+    void addOccluderZone(const IPLOcclusionZone& zone);
+    void addOccluderMesh(const GTAMesh& mesh, const QMatrix4x4& model);
+
+    // False only if the box is certainly hidden behind occluders
+    bool isVisible(const BoundingBox& worldBox) const;
+
+    // Per-frame statistics
+    int getOccluderTriangleCount() const { return m_triangleCount; }
+    int getTestedCount() const { return m_testedCount; }
+    int getCulledCount() const { return m_culledCount; }
+
+    // NDC depth per pixel, row-major from the bottom row; cleared to +1
+    const QVector<float>& getDepthBuffer() const { return m_depth; }
+
+private:
+    void rasterizeTriangle(const QVector4D& a, const QVector4D& b, const QVector4D& c);
+    void rasterizeClipped(const QVector4D* clip, int count);
+    void fillTriangle(const float* xs, const float* ys, const float* zs);
+
+    int m_width = 0;
+    int m_height = 0;
+    QVector<float> m_depth;
+    QMatrix4x4 m_viewProjection;
+
+    int m_triangleCount = 0;
+    mutable int m_testedCount = 0;
+    mutable int m_culledCount = 0;
+};
+
+#endif // OCCLUSION_CULLER_H
@@ -0,0 +1,90 @@
+#include "render_queue.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const int kDepthBits = 22;
+const int kMeshBits = 20;
+const int kTextureBits = 14;
+const int kShaderBits = 6;
+const int kStateBits = kShaderBits + kTextureBits + kMeshBits;
+
+const quint64 kDepthMask = (quint64(1) << kDepthBits) - 1;
+const quint64 kStateMask = (quint64(1) << kStateBits) - 1;
+
+quint64 quantizeDepth(float depth) {
+    float clamped = qBound(0.0f, depth, 1.0f);
+    return static_cast<quint64>(clamped * kDepthMask);
+}
+}
+
+quint64 RenderQueue::makeKey(Pass pass, quint32 shader, quint32 texture, quint32 mesh, float depth) {
+    quint64 state = (quint64(shader & ((1u << kShaderBits) - 1)) << (kTextureBits + kMeshBits))
+                  | (quint64(texture & ((1u << kTextureBits) - 1)) << kMeshBits)
+                  | quint64(mesh & ((1u << kMeshBits) - 1));
+    quint64 key = quint64(pass) << 62;
+    if (pass >= Transparent) {
+        // Farthest first
+        key |= (kDepthMask - quantizeDepth(depth)) << kStateBits;
+        key |= state;
+    } else {
+        key |= state << kDepthBits;
+        key |= quantizeDepth(depth);
+    }
+    return key;
+}
+
+bool RenderQueue::fitsKey(quint32 shader, quint32 texture, quint32 mesh) {
+    return (shader >> kShaderBits) == 0 && (texture >> kTextureBits) == 0 && (mesh >> kMeshBits) == 0;
+}
+
+quint64 RenderQueue::getStateKey(quint64 key) {
+    if (getPass(key) >= Transparent) {
+        return key & ~(kDepthMask << kStateBits);
+    }
+    return key & ~kDepthMask;
+}
+
+void RenderQueue::sort() {
+    const int count = m_items.size();
+    if (count < 2) {
+        return;
+    }
+
+    // Bytes where every key agrees cannot change the order
+    quint64 allAnd = ~quint64(0);
+    quint64 allOr = 0;
+    for (const Item& item : m_items) {
+        allAnd &= item.key;
+        allOr |= item.key;
+    }
+    quint64 varying = allAnd ^ allOr;
+
+    m_scratch.resize(count);
+    Item* source = m_items.data();
+    Item* target = m_scratch.data();
+    for (int shift = 0; shift < 64; shift += 8) {
+        if (((varying >> shift) & 0xFF) == 0) {
+            continue;
+        }
+
+        int offsets[256] = {};
+        for (int i = 0; i < count; ++i) {
+            ++offsets[(source[i].key >> shift) & 0xFF];
+        }
+        int total = 0;
+        for (int& offset : offsets) {
+            int bucket = offset;
+            offset = total;
+            total += bucket;
+        }
+        for (int i = 0; i < count; ++i) {
+            target[offsets[(source[i].key >> shift) & 0xFF]++] = source[i];
+        }
+        std::swap(source, target);
+    }
+
+    if (source != m_items.data()) {
+        std::memcpy(m_items.data(), source, count * sizeof(Item));
+    }
+}
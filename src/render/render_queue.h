@@ -0,0 +1,57 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "types.h"
+#include <QVector>
+
+// Per-frame list of draws ordered by 64-bit sort keys. The pass sits in
+// the top bits, so passes draw in enum order. Opaque and alpha-test keys
+// continue with shader, texture and mesh, then depth front to back, which
+// groups instances of a mesh and minimises state changes. Transparent keys
+// put depth (back to front) right after the pass, so blending is correct,
+// and state only groups among draws at the same depth.
+//
+//   opaque:      pass:2 | shader:6 | texture:14 | mesh:20 | depth:22
+//   transparent: pass:2 | depth:22 | shader:6   | texture:14 | mesh:20
+class RenderQueue {
+public:
+    enum Pass : quint8 {
+        Opaque,
+        AlphaTest,
+        Transparent, // IDE DRAW_LAST
+        Additive,    // IDE DRAW_LAST with ADDITIVE
+        PassCount
+    };
+
+    struct Item {
+        quint64 key;
+        int payload; // Caller's index, e.g. into the visible list
+    };
+
+    // depth is the view distance scaled to [0, 1]; ids beyond their field
+    // width are truncated, so two such ids can share a state key. Callers
+    // must then tell draws apart by the ids themselves; see fitsKey().
+    static quint64 makeKey(Pass pass, quint32 shader, quint32 texture, quint32 mesh, float depth);
+    static bool fitsKey(quint32 shader, quint32 texture, quint32 mesh);
+    static Pass getPass(quint64 key) { return static_cast<Pass>(key >> 62); }
+
+    // Key with the depth field cleared; equal values share all draw state
+    static quint64 getStateKey(quint64 key);
+
+    void clear() { m_items.clear(); }
+    void reserve(int count) { m_items.reserve(count); }
+    void add(quint64 key, int payload) { m_items.append(Item{key, payload}); }
+
+    // LSD radix sort, one byte per pass; bytes equal across all keys are
+    // skipped, which is most of them in a typical frame
+    void sort();
+
+    const QVector<Item>& getItems() const { return m_items; }
+    int size() const { return m_items.size(); }
+
+private:
+    QVector<Item> m_items;
+    QVector<Item> m_scratch;
+};
+
+#endif // RENDER_QUEUE_H
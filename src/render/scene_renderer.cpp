@@ -0,0 +1,965 @@
+#include "scene_renderer.h"
+#include "scene_manager.h"
+#include "entity_system.h"
+#include "camera_controller.h"
+#include "ide_parser.h"
+#include "math_utils.h"
+#include <QDebug>
+#include <QOpenGLShader>
+
+namespace {
+// Small stable index for a name, for packing into sort keys
+int internName(const QString& name, QHash<QString, int>& indices, QVector<QString>& names) {
+    auto it = indices.constFind(name);
+    if (it != indices.constEnd()) {
+        return it.value();
+    }
+    int slot = names.size();
+    indices.insert(name, slot);
+    names.append(name);
+    return slot;
+}
+
+RenderQueue::Pass passForFlags(uint32_t flags) {
+    if (flags & IDEParser::ADDITIVE) {
+        return RenderQueue::Additive;
+    }
+    if (flags & IDEParser::DRAW_LAST) {
+        return RenderQueue::Transparent;
+    }
+    // Foliage uses cut-out textures
+    if (flags & (IDEParser::IS_TREE | IDEParser::IS_PALM)) {
+        return RenderQueue::AlphaTest;
+    }
+    return RenderQueue::Opaque;
+}
+}
+
+SceneRenderer::View SceneRenderer::View::fromCamera(const CameraController& camera) {
+    View view;
+    view.view = camera.getViewMatrix();
+    view.projection = camera.getProjectionMatrix();
+    view.eye = camera.getPosition();
+    view.fieldOfView = camera.getFieldOfView();
+    view.aspectRatio = camera.getAspectRatio();
+    view.nearPlane = camera.getNearPlane();
+    view.farPlane = camera.getFarPlane();
+    return view;
+}
+
+SceneRenderer::SceneRenderer(SceneManager& scene)
+    : m_scene(scene)
+    , m_targetFramebuffer(0)
+    , m_targetWidth(1)
+    , m_targetHeight(1)
+    , m_wireframe(false)
+    , m_showGrid(true)
+    , m_gridSize(1.0f)
+    , m_showBoundingBoxes(false)
+    , m_showTriggerZones(true)
+    , m_showPaths(true)
+    , m_occlusionCulling(true)
+    , m_needsAnotherFrame(false)
+    , m_basicShader(nullptr)
+    , m_gridShader(nullptr)
+    , m_drawnPathRevision(0)
+    , m_cubeEBO(QOpenGLBuffer::IndexBuffer)
+    , m_drawListFrame(0)
+    , m_warnedSlotOverflow(false)
+    , m_hasPreparedFrame(false)
+{
+    // Edits between paints wait for the worker preparing the next frame
+    // rather than detach the tables its snapshot shares
+    m_scene.setSnapshotFence([this]() { m_framePreparer.wait(); });
+}
+
+SceneRenderer::~SceneRenderer() {
+    // GL objects need the context; the owner calls destroy() while it is
+    // current. Only the worker preparing the next frame is waited for here.
+    m_scene.setSnapshotFence(nullptr);
+    m_framePreparer.cancel();
+}
+
+void SceneRenderer::initialize() {
+    initializeOpenGLFunctions();
+
+    glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+
+    // Blending for transparency
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    initializeShaders();
+    initializeBuffers();
+}
+
+void SceneRenderer::destroy() {
+    if (!m_basicShader) {
+        return;
+    }
+    m_framePreparer.cancel();
+    m_hasPreparedFrame = false;
+    m_meshCache.destroy();
+    m_texturePool.destroy();
+    m_debugDraw.destroy();
+    m_idBuffer.destroy();
+    m_gridVAO.destroy();
+    m_cubeVAO.destroy();
+    m_cubeVBO.destroy();
+    m_cubeEBO.destroy();
+    m_instanceVBO.destroy();
+
+    delete m_basicShader;
+    delete m_gridShader;
+    m_basicShader = nullptr;
+    m_gridShader = nullptr;
+    m_textureCheckedRevision.clear();
+    m_drawnPathRevision = 0;
+}
+
+void SceneRenderer::setTarget(GLuint framebuffer, int width, int height) {
+    m_targetFramebuffer = framebuffer;
+    m_targetWidth = qMax(1, width);
+    m_targetHeight = qMax(1, height);
+}
+
+void SceneRenderer::render(const View& view) {
+    m_needsAnotherFrame = false;
+    if (!m_basicShader) {
+        return;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_targetFramebuffer);
+    glViewport(0, 0, m_targetWidth, m_targetHeight);
+    glDepthMask(GL_TRUE);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glPolygonMode(GL_FRONT_AND_BACK, m_wireframe ? GL_LINE : GL_FILL);
+
+    renderScene(view);
+
+    if (m_showGrid) {
+        renderGrid(view);
+    }
+
+    // Line overlays accumulate into the debug draw lists, after whatever
+    // the owner added (gizmos, selection), and go out in one flush
+    if (m_showBoundingBoxes) {
+        renderBoundingBoxes();
+    }
+
+    if (m_showTriggerZones) {
+        renderTriggerZones();
+    }
+
+    renderPaths();
+
+    m_debugDraw.flush(view.getViewProjection());
+    m_frameStats.debugLines = m_debugDraw.getStats().vertices / 2;
+    m_frameStats.debugDrawCalls = m_debugDraw.getStats().drawCalls;
+}
+
+const OcclusionCuller& SceneRenderer::getOcclusionCuller() const {
+    return m_framePreparer.getOcclusionCuller();
+}
+
+void SceneRenderer::initializeShaders() {
+    // Basic shader for rendering meshes
+    m_basicShader = new QOpenGLShaderProgram();
+
+    // Vertex shader
+    const char* vertexShaderSource = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        layout (location = 1) in vec3 aNormal;
+        layout (location = 2) in vec2 aTexCoord;
+        layout (location = 3) in mat4 aModel; // Per instance, locations 3-6
+
+        uniform mat4 view;
+        uniform mat4 projection;
+
+        out vec3 FragPos;
+        out vec3 Normal;
+        out vec2 TexCoord;
+
+        void main() {
+            FragPos = vec3(aModel * vec4(aPos, 1.0));
+            // Exact for rotation and uniform scale, which is all map
+            // placements carry; the fragment shader renormalises
+            Normal = mat3(aModel) * aNormal;
+            TexCoord = aTexCoord;
+
+            gl_Position = projection * view * vec4(FragPos, 1.0);
+        }
+    )";
+
+    // Fragment shader
+    const char* fragmentShaderSource = R"(
+        #version 330 core
+        out vec4 FragColor;
+
+        in vec3 FragPos;
+        in vec3 Normal;
+        in vec2 TexCoord;
+
+        uniform vec3 lightPos;
+        uniform vec3 lightColor;
+        uniform vec3 viewPos;
+        uniform vec3 objectColor;
+        uniform bool useTexture;
+        uniform sampler2DArray textureArray; // TXD textures, one per layer
+        uniform float textureLayer;
+        uniform float alphaCutoff; // Alpha-test pass only; 0 elsewhere
+
+        void main() {
+            vec4 color = vec4(objectColor, 1.0);
+            if (useTexture) {
+                color = texture(textureArray, vec3(TexCoord, textureLayer));
+            }
+            if (color.a < alphaCutoff) {
+                discard;
+            }
+
+            // Ambient
+            float ambientStrength = 0.3;
+            vec3 ambient = ambientStrength * lightColor;
+
+            // Diffuse
+            vec3 norm = normalize(Normal);
+            vec3 lightDir = normalize(lightPos - FragPos);
+            float diff = max(dot(norm, lightDir), 0.0);
+            vec3 diffuse = diff * lightColor;
+
+            // Specular
+            float specularStrength = 0.5;
+            vec3 viewDir = normalize(viewPos - FragPos);
+            vec3 reflectDir = reflect(-lightDir, norm);
+            float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+            vec3 specular = specularStrength * spec * lightColor;
+
+            vec3 result = (ambient + diffuse + specular) * color.rgb;
+            FragColor = vec4(result, color.a);
+        }
+    )";
+
+    m_basicShader->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShaderSource);
+    m_basicShader->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShaderSource);
+    m_basicShader->link();
+
+    // Grid shader: one screen-covering triangle whose fragments are cast
+    // onto the ground plane, so the grid is infinite and costs one draw
+    // with no geometry to rebuild when the grid size changes
+    m_gridShader = new QOpenGLShaderProgram();
+
+    const char* gridVertexShader = R"(
+        #version 330 core
+
+        uniform mat4 inverseViewProjection;
+
+        out vec3 nearPoint;
+        out vec3 farPoint;
+
+        const vec2 corners[3] = vec2[](vec2(-1.0, -1.0), vec2(3.0, -1.0), vec2(-1.0, 3.0));
+
+        vec3 unproject(vec2 xy, float z) {
+            vec4 point = inverseViewProjection * vec4(xy, z, 1.0);
+            return point.xyz / point.w;
+        }
+
+        void main() {
+            vec2 xy = corners[gl_VertexID];
+            nearPoint = unproject(xy, -1.0);
+            farPoint = unproject(xy, 1.0);
+            gl_Position = vec4(xy, 0.0, 1.0);
+        }
+    )";
+
+    const char* gridFragmentShader = R"(
+        #version 330 core
+        in vec3 nearPoint;
+        in vec3 farPoint;
+
+        out vec4 FragColor;
+
+        uniform mat4 viewProjection;
+        uniform vec3 eye;
+        uniform vec3 color;
+        uniform float gridSize;
+        uniform float fadeDistance;
+
+        // Coverage of the lines every spacing units, a pixel wide whatever
+        // the distance; fades out once cells shrink to a few pixels
+        float gridLines(vec2 coord, float spacing) {
+            vec2 scaled = coord / spacing;
+            vec2 derivative = fwidth(scaled);
+            vec2 lines = abs(fract(scaled - 0.5) - 0.5) / derivative;
+            float coverage = 1.0 - min(min(lines.x, lines.y), 1.0);
+            return coverage * (1.0 - smoothstep(0.15, 0.5, max(derivative.x, derivative.y)));
+        }
+
+        void main() {
+            // Where the view ray through this pixel meets the ground, z = 0
+            float t = -nearPoint.z / (farPoint.z - nearPoint.z);
+            if (!(t > 0.0 && t <= 1.0)) {
+                discard;
+            }
+            vec3 point = nearPoint + t * (farPoint - nearPoint);
+
+            // Depth of the plane point, so the scene hides the grid
+            vec4 clip = viewProjection * vec4(point, 1.0);
+            gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+            float minor = gridLines(point.xy, gridSize);
+            float major = gridLines(point.xy, gridSize * 10.0);
+            float fade = 1.0 - smoothstep(fadeDistance * 0.25, fadeDistance, length(point - eye));
+            float alpha = max(minor * 0.5, major) * fade;
+            if (alpha <= 0.0) {
+                discard;
+            }
+            FragColor = vec4(color, alpha);
+        }
+    )";
+
+    m_gridShader->addShaderFromSourceCode(QOpenGLShader::Vertex, gridVertexShader);
+    m_gridShader->addShaderFromSourceCode(QOpenGLShader::Fragment, gridFragmentShader);
+    m_gridShader->link();
+}
+
+void SceneRenderer::initializeBuffers() {
+    // The grid has no vertex data, but core profile draws need a VAO
+    m_gridVAO.create();
+
+    initializePlaceholderCube();
+    m_meshCache.initialize();
+    m_texturePool.initialize();
+    m_debugDraw.initialize();
+    m_idBuffer.initialize();
+
+    m_instanceVBO.create();
+    m_instanceVBO.setUsagePattern(QOpenGLBuffer::StreamDraw);
+}
+
+void SceneRenderer::renderScene(const View& view) {
+    m_basicShader->bind();
+
+    // Set matrices
+    m_basicShader->setUniformValue("view", view.view);
+    m_basicShader->setUniformValue("projection", view.projection);
+
+    // Set lighting
+    m_basicShader->setUniformValue("lightPos", QVector3D(10.0f, 10.0f, 10.0f));
+    m_basicShader->setUniformValue("lightColor", QVector3D(1.0f, 1.0f, 1.0f));
+    m_basicShader->setUniformValue("viewPos", view.eye);
+
+    // Render entities
+    renderEntities(view);
+
+    m_basicShader->release();
+}
+
+void SceneRenderer::renderEntities(const View& view) {
+    // Take the frame a worker prepared while the last one was on screen
+    // first, so its scene snapshot is gone before the systems write
+    m_framePreparer.take(m_preparedFrame);
+
+    // Run per-frame systems; this refreshes world matrices and bounds of
+    // anything that moved since last frame
+    m_scene.runSystems();
+    syncDrawList();
+
+    m_frameStats = FrameStats();
+    m_frameStats.shaderBinds = 1; // renderScene() binds the one mesh shader
+
+    // Normally that frame (or the last one drawn, when it was prepared here
+    // and nothing was submitted), with entities that moved since patched in
+    // place. Changes that alter what is drawn or how (entities created or
+    // deleted, mesh edits, visibility settings, large moves) are prepared
+    // again here instead.
+    bool preparedHere = !m_hasPreparedFrame || !isPreparedFrameCurrent() || !patchMovedInstances();
+    if (preparedHere) {
+        m_framePreparer.prepare(extractFrame(view), m_preparedFrame);
+        m_hasPreparedFrame = true;
+    }
+
+    m_frameStats.totalObjects = m_preparedFrame.totalObjects;
+    m_frameStats.nodesVisited = m_preparedFrame.nodesVisited;
+    m_frameStats.frustumCulled = m_preparedFrame.totalObjects - m_preparedFrame.inFrustum;
+    m_frameStats.occlusionCulled = m_preparedFrame.inFrustum - m_preparedFrame.visibleObjects;
+    m_frameStats.visibleObjects = m_preparedFrame.visibleObjects;
+    m_frameStats.lodObjects = m_preparedFrame.lodObjects;
+
+    // Pending mesh uploads continue within this frame's upload budget;
+    // meshes not drawn this frame become eviction candidates afterwards
+    m_meshCache.beginFrame();
+    renderDrawGroups();
+    m_meshCache.endFrame();
+
+    const GpuMeshCache::Stats& meshStats = m_meshCache.getStats();
+    m_frameStats.residentMeshes = meshStats.residentMeshes;
+    m_frameStats.meshBytes = meshStats.residentBytes;
+    m_frameStats.uploadedBytes = meshStats.uploadedBytes;
+    if (meshStats.pendingMeshes > 0) {
+        // Keep drawing until streamed meshes have replaced their cubes
+        m_needsAnotherFrame = true;
+    }
+
+    const TextureArrayPool::Stats& textureStats = m_texturePool.getStats();
+    m_frameStats.textureArrays = textureStats.arrays;
+    m_frameStats.textureBytes = textureStats.bytes;
+
+    // Prepare the next frame while this one is on screen. A frame prepared
+    // here already matches this view and scene, and the worker would only
+    // repeat it; the next paint starts from it instead. If the camera
+    // moved since this frame's visibility was decided, draw once more so
+    // it catches up.
+    if (!preparedHere) {
+        FramePreparer::Input next = extractFrame(view);
+        bool cameraMoved = next.viewProjection != m_preparedFrame.viewProjection;
+        m_framePreparer.submit(next);
+        if (cameraMoved) {
+            m_needsAnotherFrame = true;
+        }
+    }
+}
+
+FramePreparer::Input SceneRenderer::extractFrame(const View& view) const {
+    FramePreparer::Input input;
+    input.scene = m_scene.snapshotView();
+    input.drawIndex = m_drawListIndex;
+    input.drawInfo = m_drawListInfo;
+    input.viewProjection = getCullingViewProjection(view);
+    input.eye = view.eye;
+    input.farPlane = view.farPlane;
+    input.occlusionCulling = m_occlusionCulling;
+    input.structureVersion = getStructureVersion();
+    return input;
+}
+
+QMatrix4x4 SceneRenderer::getCullingViewProjection(const View& view) const {
+    // Wider than the camera, so a frame prepared ahead misses little at the
+    // edges while the camera turns
+    float fieldOfView = qMin(view.fieldOfView * 1.15f, 170.0f);
+    return MathUtils::perspective(fieldOfView, view.aspectRatio, view.nearPlane, view.farPlane) * view.view;
+}
+
+quint64 SceneRenderer::getStructureVersion() const {
+    // Bumped by anything that changes which entities are drawn, or with what
+    const ChangeTracker& tracker = m_scene.getChangeTracker();
+    return tracker.getVersion(ChangeTracker::Structural::Created)
+        + tracker.getVersion(ChangeTracker::Structural::Destroyed)
+        + tracker.getVersion(ChangeTracker::Structural::ComponentsChanged)
+        + tracker.getVersion(ComponentType::Mesh);
+}
+
+bool SceneRenderer::isPreparedFrameCurrent() const {
+    const FramePreparer::Frame& frame = m_preparedFrame;
+    return frame.structureVersion == getStructureVersion()
+        && frame.hiddenLayers == m_scene.getLayerTable().getHiddenMask()
+        && frame.drawDistanceMultiplier == m_scene.getDrawDistanceMultiplier()
+        && frame.occlusionCulling == m_occlusionCulling;
+}
+
+bool SceneRenderer::patchMovedInstances() {
+    QVector<EntityId> moved;
+    if (!m_scene.getChangeTracker().getChangedSince(ChangeTracker::Structural::Moved,
+                                                            m_preparedFrame.sceneFrame, moved)) {
+        return false;
+    }
+
+    // Past a point culling and sort order would be too stale to keep
+    if (moved.size() > qMax(256, m_preparedFrame.visibleObjects / 4)) {
+        return false;
+    }
+
+    float* instanceData = m_preparedFrame.instanceData.data();
+    for (EntityId id : moved) {
+        int instance = m_preparedFrame.instanceOf.value(int(id), -1);
+        if (instance >= 0) {
+            QMatrix4x4 world = m_scene.getWorldMatrix(id);
+            std::copy(world.constData(), world.constData() + 16, instanceData + instance * 16);
+        } else if (m_drawListIndex.contains(id)) {
+            // Culled when the frame was prepared; it may have moved into view
+            return false;
+        }
+    }
+    return true;
+}
+
+void SceneRenderer::syncDrawList() {
+    const ChangeTracker& tracker = m_scene.getChangeTracker();
+
+    // Only entities whose mesh or component set changed need re-checking
+    QVector<EntityId> changed;
+    bool complete = tracker.getChangedSince(ChangeTracker::Structural::Created, m_drawListFrame, changed)
+        && tracker.getChangedSince(ChangeTracker::Structural::Destroyed, m_drawListFrame, changed)
+        && tracker.getChangedSince(ChangeTracker::Structural::ComponentsChanged, m_drawListFrame, changed)
+        && tracker.getChangedSince(ComponentType::Mesh, m_drawListFrame, changed);
+
+    if (complete) {
+        for (EntityId id : changed) {
+            refreshDrawListEntry(id);
+        }
+    } else {
+        rebuildDrawList();
+    }
+
+    m_drawListFrame = tracker.getCurrentFrame();
+}
+
+void SceneRenderer::rebuildDrawList() {
+    m_drawList.clear();
+    m_drawListInfo.clear();
+    m_drawListIndex.clear();
+    for (Entity* entity : m_scene.getAllEntities()) {
+        if (entity) {
+            refreshDrawListEntry(entity->getId());
+        }
+    }
+}
+
+void SceneRenderer::refreshDrawListEntry(EntityId id) {
+    Entity* entity = m_scene.getEntity(id);
+    MeshComponent* meshComp = entity ? entity->getComponent<MeshComponent>() : nullptr;
+    bool drawable = meshComp && meshComp->isVisible;
+
+    int index = m_drawListIndex.value(id, -1);
+    if (drawable) {
+        // The mesh path, TXD or flags may be what changed
+        DrawInfo info{internName(meshComp->meshPath, m_modelSlots, m_modelNames),
+                      internName(meshComp->materialPath, m_textureSlots, m_textureNames),
+                      passForFlags(meshComp->objectFlags)};
+        if (!RenderQueue::fitsKey(0, info.texture, info.model) && !m_warnedSlotOverflow) {
+            // Still drawn correctly, just no longer batched by sort order
+            qWarning() << "SceneRenderer: Model or TXD slots exceed the sort key fields; batching degrades";
+            m_warnedSlotOverflow = true;
+        }
+        if (index < 0) {
+            m_drawListIndex.insert(id, m_drawList.size());
+            m_drawList.append(id);
+            m_drawListInfo.append(info);
+        } else {
+            m_drawListInfo[index] = info;
+        }
+    } else if (index >= 0) {
+        // Swap-remove to keep the list dense
+        EntityId last = m_drawList.last();
+        m_drawList[index] = last;
+        m_drawListInfo[index] = m_drawListInfo.last();
+        m_drawListIndex[last] = index;
+        m_drawList.removeLast();
+        m_drawListInfo.removeLast();
+        m_drawListIndex.remove(id);
+    }
+}
+
+void SceneRenderer::renderDrawGroups() {
+    const FramePreparer::Frame& frame = m_preparedFrame;
+    if (frame.commands.isEmpty()) {
+        return;
+    }
+
+    // Reallocating orphans last frame's storage, so the driver never waits
+    // on draws still reading it
+    m_instanceVBO.bind();
+    m_instanceVBO.allocate(frame.instanceData.constData(), frame.instanceData.size() * sizeof(float));
+    m_instanceVBO.release();
+
+    m_basicShader->setUniformValue("useTexture", false);
+    m_basicShader->setUniformValue("textureArray", 0);
+    glActiveTexture(GL_TEXTURE0);
+    m_drawState = DrawState();
+
+    // Models without geometry in the library, or still uploading, draw as
+    // the placeholder cube
+    const ModelLibrary& models = m_scene.getModelLibrary();
+    for (const FramePreparer::Frame::Command& group : frame.commands) {
+        applyPassState(group.info.pass);
+
+        const QString& name = m_modelNames[group.info.model];
+        const GpuMesh* mesh = nullptr;
+        if (const GTAModel* model = models.find(name)) {
+            if (!m_meshCache.contains(name)) {
+                // Staging a new mesh leaves vertex array 0 bound
+                m_drawState.vao = 0;
+            }
+            mesh = m_meshCache.request(name, *model);
+        }
+        if (mesh) {
+            renderMesh(*mesh, getTextureDictionary(group.info.texture), group.firstInstance, group.instanceCount);
+        } else {
+            setTextureLayer(TextureArrayPool::Location());
+            setObjectColor(QVector3D(0.8f, 0.8f, 0.8f));
+            renderPlaceholderCube(group.firstInstance, group.instanceCount);
+        }
+    }
+
+    // Back to the defaults the grid and overlays draw with
+    bindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    m_basicShader->setUniformValue("useTexture", false);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_TRUE);
+    m_basicShader->setUniformValue("alphaCutoff", 0.0f);
+}
+
+void SceneRenderer::applyPassState(RenderQueue::Pass pass) {
+    if (m_drawState.pass == pass) {
+        return;
+    }
+    m_drawState.pass = pass;
+    ++m_frameStats.passChanges;
+
+    switch (pass) {
+        case RenderQueue::Opaque:
+        case RenderQueue::AlphaTest:
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+            break;
+        case RenderQueue::Transparent:
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+            break;
+        case RenderQueue::Additive:
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+            glDepthMask(GL_FALSE);
+            break;
+        default:
+            break;
+    }
+    m_basicShader->setUniformValue("alphaCutoff", pass == RenderQueue::AlphaTest ? 0.5f : 0.0f);
+}
+
+void SceneRenderer::bindVertexArray(GLuint vao) {
+    if (m_drawState.vao == vao) {
+        ++m_frameStats.redundantSkipped;
+        return;
+    }
+    m_drawState.vao = vao;
+    glBindVertexArray(vao);
+    if (vao) {
+        ++m_frameStats.meshBinds;
+    }
+}
+
+void SceneRenderer::setObjectColor(const QVector3D& color) {
+    if (m_drawState.objectColor == color) {
+        ++m_frameStats.redundantSkipped;
+        return;
+    }
+    m_drawState.objectColor = color;
+    m_basicShader->setUniformValue("objectColor", color);
+    ++m_frameStats.uniformUpdates;
+}
+
+void SceneRenderer::bindTextureArray(int array) {
+    if (m_drawState.textureArray == array) {
+        ++m_frameStats.redundantSkipped;
+        return;
+    }
+    m_drawState.textureArray = array;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_texturePool.getTexture(array));
+    ++m_frameStats.textureBinds;
+}
+
+void SceneRenderer::setTextureLayer(const TextureArrayPool::Location& location) {
+    int layer = location.isValid() ? location.layer : -1;
+    if (m_drawState.textureLayer == layer) {
+        ++m_frameStats.redundantSkipped;
+        return;
+    }
+    if ((m_drawState.textureLayer < 0) != (layer < 0)) {
+        m_basicShader->setUniformValue("useTexture", layer >= 0);
+        ++m_frameStats.uniformUpdates;
+    }
+    if (layer >= 0) {
+        m_basicShader->setUniformValue("textureLayer", float(layer));
+        ++m_frameStats.uniformUpdates;
+    }
+    m_drawState.textureLayer = layer;
+}
+
+const TextureArrayPool::Dictionary* SceneRenderer::getTextureDictionary(int slot) {
+    const QString& name = m_textureNames[slot];
+    if (const TextureArrayPool::Dictionary* dictionary = m_texturePool.findDictionary(name)) {
+        return dictionary;
+    }
+
+    // Not resident: upload it if the library has it, and otherwise do not
+    // look again until the library changes
+    const TextureLibrary& library = m_scene.getTextureLibrary();
+    if (m_textureCheckedRevision.size() <= slot) {
+        m_textureCheckedRevision.resize(m_textureNames.size());
+    }
+    if (name.isEmpty() || m_textureCheckedRevision[slot] == library.getRevision() + 1) {
+        return nullptr;
+    }
+    m_textureCheckedRevision[slot] = library.getRevision() + 1;
+
+    const QVector<TXDParser::GTATexture>* textures = library.find(name);
+    if (!textures) {
+        return nullptr;
+    }
+    m_texturePool.addDictionary(name, *textures);
+
+    // Uploading left its own array bound
+    m_drawState.textureArray = -1;
+    return m_texturePool.findDictionary(name);
+}
+
+void SceneRenderer::bindInstanceAttributes(int firstInstance) {
+    // A mat4 attribute takes four locations, one column each; the bound VAO
+    // records the pointers, so they are reset per group
+    m_instanceVBO.bind();
+    for (int column = 0; column < 4; ++column) {
+        GLuint location = 3 + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float),
+                              reinterpret_cast<void*>((firstInstance * 16 + column * 4) * sizeof(float)));
+        glVertexAttribDivisor(location, 1);
+    }
+    m_instanceVBO.release();
+}
+
+void SceneRenderer::renderGrid(const View& view) {
+    const QMatrix4x4 viewProjection = view.getViewProjection();
+    const QVector3D eye = view.eye;
+
+    // Far enough to show a useful number of cells, further the higher the
+    // camera is above the plane
+    const float fadeDistance = qMin(view.farPlane,
+                                    m_gridSize * 100.0f + qAbs(eye.z()) * 10.0f);
+
+    m_gridShader->bind();
+    m_gridShader->setUniformValue("viewProjection", viewProjection);
+    m_gridShader->setUniformValue("inverseViewProjection", viewProjection.inverted());
+    m_gridShader->setUniformValue("eye", eye);
+    m_gridShader->setUniformValue("color", QVector3D(0.5f, 0.5f, 0.5f));
+    m_gridShader->setUniformValue("gridSize", m_gridSize);
+    m_gridShader->setUniformValue("fadeDistance", fadeDistance);
+
+    // Blended over the scene without writing depth, and filled even in
+    // wireframe mode since the triangle only carries the fragments
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    m_gridVAO.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    m_gridVAO.release();
+
+    glDepthMask(GL_TRUE);
+    if (m_wireframe) {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    }
+    m_gridShader->release();
+}
+
+void SceneRenderer::renderBoundingBoxes() {
+    // World boxes of what the last prepared frame drew
+    const BoundsCache& bounds = m_scene.getBoundsCache();
+    DebugDrawList& lines = m_debugDraw.get(DebugDraw::DepthTested);
+    const QColor color(90, 200, 120);
+    const QVector<int>& instanceOf = m_preparedFrame.instanceOf;
+    for (int id = 0; id < instanceOf.size(); ++id) {
+        if (instanceOf[id] < 0) {
+            continue;
+        }
+        if (const BoundingBox* box = bounds.find(EntityId(id))) {
+            lines.box(*box, color);
+        }
+    }
+}
+
+void SceneRenderer::renderTriggerZones() {
+    DebugDrawList& lines = m_debugDraw.get(DebugDraw::DepthTested);
+    const QColor activeColor(240, 80, 220);
+    const QColor inactiveColor(150, 110, 150);
+    for (const TriggerZone& zone : m_scene.getTriggerZones()) {
+        const QColor& color = zone.isActive ? activeColor : inactiveColor;
+        QMatrix4x4 transform = zone.transform.getMatrix();
+        switch (zone.type) {
+        case TriggerZone::Box:
+            transform.scale(zone.size * 0.5f);
+            lines.box(transform, color);
+            break;
+        case TriggerZone::Sphere:
+            lines.sphere(zone.transform.position, zone.size.x() * zone.transform.scale.x(), color);
+            break;
+        case TriggerZone::Cylinder:
+            // Radius in x, height in z, standing on the zone's origin
+            lines.cylinder(transform, zone.size.x(), zone.size.z(), color);
+            break;
+        }
+    }
+}
+
+void SceneRenderer::renderPaths() {
+    const quint64 revision = m_scene.getPathRevision();
+    if (!m_showPaths || m_scene.getPathNodes().isEmpty()) {
+        m_debugDraw.removeRetained("paths");
+        m_drawnPathRevision = 0;
+        return;
+    }
+
+    // Path files are static once loaded, so the network is expanded once
+    // into a retained list and costs a single draw per frame after that
+    if (m_drawnPathRevision == revision + 1) {
+        return;
+    }
+
+    const QVector<DATParser::PathNode>& nodes = m_scene.getPathNodes();
+    QHash<uint32_t, int> nodeIndex;
+    nodeIndex.reserve(nodes.size());
+    for (int i = 0; i < nodes.size(); ++i) {
+        nodeIndex.insert(nodes[i].id, i);
+    }
+
+    DebugDrawList lines;
+    lines.reserve(nodes.size() * 10);
+    const QColor nodeColor(255, 210, 60);
+    const QColor linkColor(255, 140, 30);
+    const QColor crossRoadColor(80, 200, 255);
+    for (int i = 0; i < nodes.size(); ++i) {
+        const DATParser::PathNode& node = nodes[i];
+        lines.cross(node.position, 1.0f, nodeColor);
+        int next = nodeIndex.value(node.nextNode, -1);
+        if (next >= 0 && next != i) {
+            lines.line(node.position, nodes[next].position, linkColor);
+        }
+        int crossRoad = nodeIndex.value(node.crossRoad, -1);
+        if (crossRoad >= 0 && crossRoad != i) {
+            lines.line(node.position, nodes[crossRoad].position, crossRoadColor);
+        }
+    }
+    m_debugDraw.setRetained("paths", lines);
+    m_drawnPathRevision = revision + 1;
+    qDebug() << "SceneRenderer: Built path overlay with" << nodes.size() << "nodes," << lines.getVertexCount() / 2 << "lines";
+}
+
+void SceneRenderer::renderMesh(const GpuMesh& mesh, const TextureArrayPool::Dictionary* textures,
+                                int firstInstance, int instanceCount) {
+    bindVertexArray(mesh.vao);
+    bindInstanceAttributes(firstInstance);
+    for (const GpuMesh::Part& part : mesh.parts) {
+        // Parts whose texture is missing fall back to the material colour
+        TextureArrayPool::Location location;
+        if (textures && !part.textureName.isEmpty()) {
+            location = textures->value(part.textureName);
+        }
+        if (location.isValid()) {
+            bindTextureArray(location.array);
+        }
+        setTextureLayer(location);
+        setObjectColor(part.color);
+        glDrawElementsInstanced(GL_TRIANGLES, part.indexCount, GL_UNSIGNED_INT,
+                                reinterpret_cast<void*>(part.firstIndex * sizeof(uint32_t)), instanceCount);
+        ++m_frameStats.drawCalls;
+    }
+}
+
+bool SceneRenderer::renderIdBuffer(const View& view) {
+    if (!m_idBuffer.isAvailable()) {
+        return false;
+    }
+
+    const int w = m_targetWidth;
+    const int h = m_targetHeight;
+    const QMatrix4x4 viewProjection = view.getViewProjection();
+    const quint64 frame = m_scene.getCurrentFrame();
+    if (m_idBuffer.isCurrent(frame, viewProjection, w, h)) {
+        return true;
+    }
+
+    // The last painted frame's draws again, without textures or state
+    // sorting; its instance matrices are still in m_instanceVBO
+    const FramePreparer::Frame& prepared = m_preparedFrame;
+    m_idBuffer.begin(frame, viewProjection, w, h, prepared.instanceIds);
+    for (const FramePreparer::Frame::Command& group : prepared.commands) {
+        m_idBuffer.setFirstInstance(group.firstInstance);
+        if (const GpuMesh* mesh = m_meshCache.find(m_modelNames[group.info.model])) {
+            bindVertexArray(mesh->vao);
+            bindInstanceAttributes(group.firstInstance);
+            for (const GpuMesh::Part& part : mesh->parts) {
+                glDrawElementsInstanced(GL_TRIANGLES, part.indexCount, GL_UNSIGNED_INT,
+                                        reinterpret_cast<void*>(part.firstIndex * sizeof(uint32_t)),
+                                        group.instanceCount);
+            }
+        } else {
+            bindVertexArray(m_cubeVAO.objectId());
+            bindInstanceAttributes(group.firstInstance);
+            glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr, group.instanceCount);
+        }
+    }
+    bindVertexArray(0);
+    m_idBuffer.end(m_targetFramebuffer, w, h);
+    if (m_wireframe) {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    }
+    return true;
+}
+
+void SceneRenderer::initializePlaceholderCube() {
+    // Unit cube: position, normal, texcoord, as in the mesh cache's layout
+    static const float vertices[] = {
+        // Front face
+        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+         0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+        -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+
+        // Back face
+        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+         0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+        -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+    };
+
+    static const unsigned int indices[] = {
+        0, 1, 2, 2, 3, 0,   // Front
+        4, 5, 6, 6, 7, 4,   // Back
+        7, 6, 2, 2, 3, 7,   // Top
+        4, 5, 1, 1, 0, 4,   // Bottom
+        4, 0, 3, 3, 7, 4,   // Left
+        1, 5, 6, 6, 2, 1    // Right
+    };
+
+    m_cubeVAO.create();
+    m_cubeVBO.create();
+    m_cubeEBO.create();
+
+    m_cubeVAO.bind();
+
+    m_cubeVBO.bind();
+    m_cubeVBO.allocate(vertices, sizeof(vertices));
+
+    m_cubeEBO.bind();
+    m_cubeEBO.allocate(indices, sizeof(indices));
+
+    // Position attribute
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), nullptr);
+
+    // Normal attribute
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), reinterpret_cast<void*>(3 * sizeof(float)));
+
+    // Texture coordinate attribute
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), reinterpret_cast<void*>(6 * sizeof(float)));
+
+    m_cubeVAO.release();
+}
+
+void SceneRenderer::renderPlaceholderCube(int firstInstance, int instanceCount) {
+    bindVertexArray(m_cubeVAO.objectId());
+    bindInstanceAttributes(firstInstance);
+    glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr, instanceCount);
+    ++m_frameStats.drawCalls;
+}
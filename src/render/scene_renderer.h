@@ -0,0 +1,244 @@
+#ifndef SCENE_RENDERER_H
+#define SCENE_RENDERER_H
+
+#include "types.h"
+#include "gpu_mesh_cache.h"
+#include "texture_array_pool.h"
+#include "render_queue.h"
+#include "frame_preparer.h"
+#include "debug_draw.h"
+#include "id_buffer.h"
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QMatrix4x4>
+#include <QHash>
+
+class SceneManager;
+class CameraController;
+
+// Draws the scene into whatever framebuffer it is given: the viewport
+// widget's, or an offscreen one for headless capture. Owns every GL
+// resource of the scene pass (shaders, mesh cache, texture arrays, the
+// instance stream, debug lines, the id buffer) and the draw list kept in
+// sync with the scene; windowing, input and the frame clock are left to
+// the caller.
+class SceneRenderer : protected QOpenGLExtraFunctions {
+public:
+    // Camera state for one frame
+    struct View {
+        QMatrix4x4 view;
+        QMatrix4x4 projection;
+        QVector3D eye;
+        float fieldOfView = 45.0f;
+        float aspectRatio = 1.0f;
+        float nearPlane = 0.1f;
+        float farPlane = 1000.0f;
+
+        QMatrix4x4 getViewProjection() const { return projection * view; }
+        static View fromCamera(const CameraController& camera);
+    };
+
+    // Per-frame culling and submission counts
+    struct FrameStats {
+        int totalObjects = 0;     // Drawable entities in the scene
+        int frustumCulled = 0;    // Off screen, out of range or swapped for a LOD
+        int occlusionCulled = 0;
+        int visibleObjects = 0;
+        int lodObjects = 0;       // Visible entities that are LOD parents
+        int drawCalls = 0;
+        int nodesVisited = 0;     // BVH nodes touched by the frustum walk
+        int residentMeshes = 0;   // Models in the GPU mesh cache
+        qint64 meshBytes = 0;
+        qint64 uploadedBytes = 0; // Mesh data streamed this frame
+        int textureArrays = 0;    // Array textures holding TXD layers
+        qint64 textureBytes = 0;
+        int debugLines = 0;       // Overlay segments: bounds, gizmos, zones, paths
+        int debugDrawCalls = 0;
+
+        // State changes that reached GL; redundant ones are filtered out
+        int shaderBinds = 0;
+        int textureBinds = 0;     // Array texture binds
+        int meshBinds = 0;        // Vertex array binds
+        int passChanges = 0;      // Blend and depth-write switches
+        int uniformUpdates = 0;   // Per-draw uniform writes
+        int redundantSkipped = 0;
+
+        // Filled in by the owner, which keeps the clock: CPU time of the
+        // last completed frame, and from its first request to its swap
+        double frameTimeMs = 0.0;
+        double inputLatencyMs = 0.0;
+    };
+
+    explicit SceneRenderer(SceneManager& scene);
+    ~SceneRenderer();
+
+    // Needs a 3.3 core context to be current; destroy() before it goes
+    void initialize();
+    void destroy();
+    bool isInitialized() const { return m_basicShader != nullptr; }
+
+    // Framebuffer render() draws into and the id pass returns to, in
+    // device pixels. 0 is the surface's default framebuffer; a
+    // QOpenGLWidget's and a QOpenGLFramebufferObject's have other names.
+    void setTarget(GLuint framebuffer, int width, int height);
+    GLuint getTargetFramebuffer() const { return m_targetFramebuffer; }
+    int getTargetWidth() const { return m_targetWidth; }
+    int getTargetHeight() const { return m_targetHeight; }
+
+    // Clears the target and draws the scene, the grid and the enabled
+    // overlays, then flushes the debug lines, including any the caller
+    // added to getDebugDraw() beforehand. Runs the scene's per-frame
+    // systems; advancing the scene frame is left to the caller.
+    void render(const View& view);
+
+    // Whether the frame just drawn is incomplete: meshes still streaming,
+    // or visibility decided for a camera that has since moved
+    bool needsAnotherFrame() const { return m_needsAnotherFrame; }
+
+    // Settings
+    void setWireframe(bool wireframe) { m_wireframe = wireframe; }
+    bool isWireframe() const { return m_wireframe; }
+    void setShowGrid(bool show) { m_showGrid = show; }
+    bool isShowGrid() const { return m_showGrid; }
+    void setGridSize(float size) { m_gridSize = size; }
+    float getGridSize() const { return m_gridSize; }
+    void setShowBoundingBoxes(bool show) { m_showBoundingBoxes = show; }
+    bool isShowBoundingBoxes() const { return m_showBoundingBoxes; }
+    void setShowTriggerZones(bool show) { m_showTriggerZones = show; }
+    bool isShowTriggerZones() const { return m_showTriggerZones; }
+    void setShowPaths(bool show) { m_showPaths = show; }
+    bool isShowPaths() const { return m_showPaths; }
+    void setOcclusionCullingEnabled(bool enabled) { m_occlusionCulling = enabled; }
+    bool isOcclusionCullingEnabled() const { return m_occlusionCulling; }
+
+    const FrameStats& getFrameStats() const { return m_frameStats; }
+    const OcclusionCuller& getOcclusionCuller() const;
+    GpuMeshCache& getMeshCache() { return m_meshCache; }
+    DebugDraw& getDebugDraw() { return m_debugDraw; }
+
+    // The frame last drawn, and whether an entity is in the draw list
+    const FramePreparer::Frame& getPreparedFrame() const { return m_preparedFrame; }
+    bool isDrawable(EntityId id) const { return m_drawListIndex.contains(id); }
+
+    // Draws the last frame's instances into the id buffer unless it is
+    // already current for this view and target. False if the context has
+    // no integer framebuffers.
+    bool renderIdBuffer(const View& view);
+    IdBuffer& getIdBuffer() { return m_idBuffer; }
+
+private:
+    using DrawInfo = FramePreparer::DrawInfo;
+
+    void initializeShaders();
+    void initializeBuffers();
+
+    // Scene pass
+    void renderScene(const View& view);
+    void renderEntities(const View& view);
+    FramePreparer::Input extractFrame(const View& view) const;
+    QMatrix4x4 getCullingViewProjection(const View& view) const;
+    quint64 getStructureVersion() const;
+    bool isPreparedFrameCurrent() const;
+    bool patchMovedInstances();
+    void renderDrawGroups();
+    void applyPassState(RenderQueue::Pass pass);
+    void bindVertexArray(GLuint vao);
+    void setObjectColor(const QVector3D& color);
+    void bindTextureArray(int array);
+    void setTextureLayer(const TextureArrayPool::Location& location);
+    const TextureArrayPool::Dictionary* getTextureDictionary(int slot);
+    void bindInstanceAttributes(int firstInstance);
+    void syncDrawList();
+    void rebuildDrawList();
+    void refreshDrawListEntry(EntityId id);
+    void renderMesh(const GpuMesh& mesh, const TextureArrayPool::Dictionary* textures,
+                    int firstInstance, int instanceCount);
+    void initializePlaceholderCube();
+    void renderPlaceholderCube(int firstInstance, int instanceCount);
+
+    // Grid and line overlays
+    void renderGrid(const View& view);
+    void renderBoundingBoxes();
+    void renderTriggerZones();
+    void renderPaths();
+
+    SceneManager& m_scene;
+
+    // Target
+    GLuint m_targetFramebuffer;
+    int m_targetWidth;
+    int m_targetHeight;
+
+    // Settings
+    bool m_wireframe;
+    bool m_showGrid;
+    float m_gridSize;
+    bool m_showBoundingBoxes;
+    bool m_showTriggerZones;
+    bool m_showPaths;
+    bool m_occlusionCulling; // Redone for each prepared frame
+
+    bool m_needsAnotherFrame;
+
+    // OpenGL resources
+    QOpenGLShaderProgram* m_basicShader;
+    QOpenGLShaderProgram* m_gridShader;
+    QOpenGLVertexArrayObject m_gridVAO; // Empty; the grid triangle comes from gl_VertexID
+
+    // Lines for bounds, gizmos, trigger zones and paths, flushed once per
+    // frame. The path network is a retained list, rebuilt when its
+    // revision changes.
+    DebugDraw m_debugDraw;
+    quint64 m_drawnPathRevision;
+
+    // Entity ids per pixel, drawn from the last frame when a pick needs it
+    IdBuffer m_idBuffer;
+
+    // Model meshes by name, and the cube drawn for models not (yet) on the GPU
+    GpuMeshCache m_meshCache;
+    QOpenGLBuffer m_cubeVBO;
+    QOpenGLBuffer m_cubeEBO;
+    QOpenGLVertexArrayObject m_cubeVAO;
+
+    // TXD textures as array layers, uploaded a dictionary at a time the
+    // first frame one is drawn. The library revision each texture slot was
+    // last looked up at (plus one; 0 is never) avoids searching again for
+    // a dictionary that is not loaded until the library changes.
+    TextureArrayPool m_texturePool;
+    QVector<quint64> m_textureCheckedRevision;
+
+    // Entities with a visible mesh, kept in sync from scene change deltas
+    QVector<EntityId> m_drawList;
+    QVector<DrawInfo> m_drawListInfo;
+    QHash<EntityId, int> m_drawListIndex;
+    quint64 m_drawListFrame;
+    QHash<QString, int> m_modelSlots;
+    QVector<QString> m_modelNames;
+    QHash<QString, int> m_textureSlots;
+    QVector<QString> m_textureNames;
+    bool m_warnedSlotOverflow; // Slots are never recycled, so long sessions can pass the key widths
+
+    FrameStats m_frameStats;
+
+    // Culling and sorting run on workers one frame ahead; the frame being
+    // drawn is a flat list of instanced draws whose world matrices are
+    // streamed in order into m_instanceVBO
+    FramePreparer m_framePreparer;
+    FramePreparer::Frame m_preparedFrame;
+    bool m_hasPreparedFrame; // Cleared by destroy()
+    QOpenGLBuffer m_instanceVBO;
+
+    // GL state last set while submitting draw groups
+    struct DrawState {
+        int pass = -1;
+        GLuint vao = 0;
+        QVector3D objectColor{-1.0f, -1.0f, -1.0f};
+        int textureArray = -1;
+        int textureLayer = -1; // -1 for untextured
+    };
+    DrawState m_drawState;
+};
+
+#endif // SCENE_RENDERER_H
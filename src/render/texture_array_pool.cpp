@@ -0,0 +1,138 @@
+#include "texture_array_pool.h"
+#include <QDebug>
+#include <QSet>
+
+namespace {
+const int kMinSize = 4;
+const int kMaxSize = 1024;
+const qint64 kArrayBytes = 16ll * 1024 * 1024; // Base level; the mips add a third
+}
+
+TextureArrayPool::TextureArrayPool() = default;
+
+void TextureArrayPool::initialize() {
+    initializeOpenGLFunctions();
+    GLint maxLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    m_maxLayers = qMax(1, maxLayers);
+    m_initialized = true;
+}
+
+void TextureArrayPool::destroy() {
+    if (m_initialized) {
+        clear();
+    }
+    m_initialized = false;
+}
+
+void TextureArrayPool::addDictionary(const QString& name, const QVector<TXDParser::GTATexture>& textures) {
+    const QString key = name.toLower();
+    if (!m_initialized || m_dictionaries.contains(key)) {
+        return;
+    }
+
+    Dictionary& dictionary = m_dictionaries[key];
+    QSet<int> touched;
+    for (const TXDParser::GTATexture& texture : textures) {
+        const QString textureName = texture.name.toLower();
+        if (texture.image.isNull() || dictionary.contains(textureName)) {
+            continue;
+        }
+
+        const int width = sizeClass(texture.image.width());
+        const int height = sizeClass(texture.image.height());
+        QImage image = texture.image.convertToFormat(QImage::Format_RGBA8888);
+        if (image.width() != width || image.height() != height) {
+            image = image.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+
+        // Rows go up in QImage order; GTA texcoords put v = 0 at the top,
+        // which is where that leaves it
+        Location location = allocateLayer(width, height);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrays[location.array].texture);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, location.layer, width, height, 1,
+                        GL_RGBA, GL_UNSIGNED_BYTE, image.constBits());
+        dictionary.insert(textureName, location);
+        touched.insert(location.array);
+    }
+
+    // Mips once per array rather than once per layer
+    for (int array : touched) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrays[array].texture);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+bool TextureArrayPool::containsDictionary(const QString& name) const {
+    return m_dictionaries.contains(name.toLower());
+}
+
+const TextureArrayPool::Dictionary* TextureArrayPool::findDictionary(const QString& name) const {
+    auto it = m_dictionaries.constFind(name.toLower());
+    return it != m_dictionaries.constEnd() ? &it.value() : nullptr;
+}
+
+void TextureArrayPool::clear() {
+    for (TextureArray& array : m_arrays) {
+        glDeleteTextures(1, &array.texture);
+    }
+    m_arrays.clear();
+    m_dictionaries.clear();
+    m_stats = Stats();
+}
+
+TextureArrayPool::Location TextureArrayPool::allocateLayer(int width, int height) {
+    // Only the newest array of a size class can have free layers
+    for (int i = m_arrays.size() - 1; i >= 0; --i) {
+        TextureArray& array = m_arrays[i];
+        if (array.width == width && array.height == height) {
+            if (array.used < array.capacity) {
+                ++m_stats.layers;
+                return Location{i, array.used++};
+            }
+            break;
+        }
+    }
+
+    TextureArray array;
+    array.width = width;
+    array.height = height;
+    array.capacity = static_cast<int>(qBound<qint64>(1, kArrayBytes / (qint64(width) * height * 4), m_maxLayers));
+    glGenTextures(1, &array.texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+
+    // Storage for the whole mip chain up front; GL 3.3 has no immutable
+    // storage, so each level is specified on its own
+    int levelWidth = width;
+    int levelHeight = height;
+    for (int level = 0; ; ++level) {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, levelWidth, levelHeight, array.capacity, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        m_stats.bytes += qint64(levelWidth) * levelHeight * 4 * array.capacity;
+        if (levelWidth == 1 && levelHeight == 1) {
+            break;
+        }
+        levelWidth = qMax(1, levelWidth / 2);
+        levelHeight = qMax(1, levelHeight / 2);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    array.used = 1;
+    m_arrays.append(array);
+    ++m_stats.arrays;
+    ++m_stats.layers;
+    qDebug() << "TextureArrayPool: New" << width << "x" << height << "array with" << array.capacity << "layers";
+    return Location{m_arrays.size() - 1, 0};
+}
+
+int TextureArrayPool::sizeClass(int size) {
+    int rounded = kMinSize;
+    while (rounded < size && rounded < kMaxSize) {
+        rounded *= 2;
+    }
+    return rounded;
+}
@@ -0,0 +1,75 @@
+#ifndef TEXTURE_ARRAY_POOL_H
+#define TEXTURE_ARRAY_POOL_H
+
+#include "txd_parser.h"
+#include <QOpenGLExtraFunctions>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// TXD textures packed as layers of shared 2D array textures, so a frame
+// binds one texture object per size class instead of one per material.
+//
+// Textures are bucketed by their size rounded up to a power of two (other
+// sizes are resampled to fit); each bucket fills arrays of a fixed layer
+// capacity, opening another when one is full. Layers keep their own
+// wrapping and mip chain, so the tiling UVs GTA models rely on work
+// unchanged, which an atlas could not offer without rewriting the meshes.
+// A material is drawn by binding its array and passing its layer.
+class TextureArrayPool : protected QOpenGLExtraFunctions {
+public:
+    struct Location {
+        int array = -1; // Index into the pool's arrays; -1 if not resident
+        int layer = 0;
+
+        bool isValid() const { return array >= 0; }
+    };
+
+    // A dictionary's textures by lower-case texture name
+    using Dictionary = QHash<QString, Location>;
+
+    struct Stats {
+        int arrays = 0;
+        int layers = 0;
+        qint64 bytes = 0; // Allocated, including unused layers and mips
+    };
+
+    TextureArrayPool();
+
+    // Needs the viewport's GL context to be current
+    void initialize();
+    void destroy();
+
+    // Uploads every texture of a dictionary and regenerates the mips of the
+    // arrays it touched. A dictionary that is already resident is skipped.
+    void addDictionary(const QString& name, const QVector<TXDParser::GTATexture>& textures);
+    bool containsDictionary(const QString& name) const;
+    const Dictionary* findDictionary(const QString& name) const;
+    void clear();
+
+    int getArrayCount() const { return m_arrays.size(); }
+    GLuint getTexture(int array) const { return m_arrays[array].texture; }
+
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    struct TextureArray {
+        GLuint texture = 0;
+        int width = 0;
+        int height = 0;
+        int capacity = 0;
+        int used = 0;
+    };
+
+    Location allocateLayer(int width, int height);
+    static int sizeClass(int size);
+
+    bool m_initialized = false;
+    int m_maxLayers = 256;
+
+    QVector<TextureArray> m_arrays;
+    QHash<QString, Dictionary> m_dictionaries;
+    Stats m_stats;
+};
+
+#endif // TEXTURE_ARRAY_POOL_H
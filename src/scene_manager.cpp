@@ -1,16 +1,109 @@
 #include "scene_manager.h"
-#include "gta_loader.h"
 #include "math_utils.h"
+#include "ide_parser.h"
+#include "ipl_parser.h"
+#include "dff_parser.h"
 #include <QDebug>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+
+namespace {
+// Refreshes cached world matrices, one hierarchy level at a time in parallel.
+// The moves are recorded in finish(), on the GUI thread, since the change
+// journal and spatial dirty set are shared scene state no mask covers.
+class TransformSystem : public System {
+public:
+    TransformSystem(std::function<int(JobSystem&)> update, std::function<void()> record)
+        : m_update(std::move(update)), m_record(std::move(record)) {}
+    
+    QString getName() const override { return "Transforms"; }
+    ComponentMask getReadMask() const override { return componentBit(ComponentType::Transform); }
+    ComponentMask getWriteMask() const override { return componentBit(ComponentType::Transform); }
+    
+    void execute(JobSystem& jobs) override {
+        m_updated = m_update(jobs);
+    }
+    
+    void finish() override {
+        if (m_updated > 0) {
+            m_record();
+        }
+        m_updated = 0;
+    }
+    
+private:
+    std::function<int(JobSystem&)> m_update;
+    std::function<void()> m_record;
+    int m_updated = 0;
+};
+
+// Brings world bounds, the BVH, the LOD table and the streaming grid up to
+// date for culling. Changes are gathered and local bounds synced in
+// prepare(), world boxes recomputed in execute(), and the BVH and grid
+// updated in finish(). Reads what Transforms writes, so it runs a stage
+// after it.
+class BoundsSystem : public System {
+public:
+    BoundsSystem(std::function<bool(QVector<EntityId>&)> collect,
+                 std::function<void(const QVector<EntityId>&)> refresh,
+                 std::function<void(const QVector<EntityId>&)> apply)
+        : m_collect(std::move(collect)), m_refresh(std::move(refresh)), m_apply(std::move(apply)) {}
+    
+    QString getName() const override { return "Bounds"; }
+    ComponentMask getReadMask() const override {
+        return componentBit(ComponentType::Transform) | componentBit(ComponentType::Mesh);
+    }
+    ComponentMask getWriteMask() const override {
+        return resourceBit(SceneResource::Bounds) | resourceBit(SceneResource::SpatialIndex);
+    }
+    
+    void prepare() override {
+        m_dirty.clear();
+        m_pending = m_collect(m_dirty);
+    }
+    
+    void execute(JobSystem&) override {
+        if (m_pending) {
+            m_refresh(m_dirty);
+        }
+    }
+    
+    void finish() override {
+        if (m_pending) {
+            m_apply(m_dirty);
+        }
+        m_pending = false;
+    }
+    
+private:
+    std::function<bool(QVector<EntityId>&)> m_collect;
+    std::function<void(const QVector<EntityId>&)> m_refresh;
+    std::function<void(const QVector<EntityId>&)> m_apply;
+    QVector<EntityId> m_dirty;
+    bool m_pending = false;
+};
+}
 
 SceneManager& SceneManager::instance() {
     static SceneManager instance;
     return instance;
 }
 
+SceneManager::SceneManager()
+    : m_entityIndex(m_changeTracker)
+{
+    m_systemScheduler.addSystem(CreateRef<TransformSystem>(
+        [this](JobSystem& jobs) { return m_transformHierarchy.update(&jobs); },
+        [this]() { recordMovedTransforms(); }));
+    m_systemScheduler.addSystem(CreateRef<BoundsSystem>(
+        [this](QVector<EntityId>& dirty) { return collectSpatialChanges(dirty); },
+        [this](const QVector<EntityId>& dirty) { m_boundsCache.refresh(dirty, m_transformHierarchy); },
+        [this](const QVector<EntityId>& dirty) { applySpatialChanges(dirty); }));
+}
+
 void SceneManager::newScene() {
     clearScene();
     m_sceneName = "Untitled Scene";
@@ -64,17 +157,28 @@ bool SceneManager::saveScene(const QString& filePath) {
 }
 
 void SceneManager::clearScene() {
+    releaseSnapshots();
     clearSelection();
     EntityManager::instance().clear();
-    m_layers.clear();
-    m_entityLayers.clear();
+    m_transformHierarchy.clear();
+    m_changeTracker.clear();
+    m_spatialIndex.clear();
+    m_spatialDirty.clear();
+    m_spatialSyncedFrame = 0;
+    m_worldGrid.clear();
+    m_boundsCache.clear();
+    m_lodTable.clear();
+    m_layerTable.clear();
     m_triggerZones.clear();
+    m_occlusionZones.clear();
+    m_pathNodes.clear();
+    ++m_pathRevision;
     m_missionObjectives.clear();
     
     // Reset camera
-    m_cameraPosition = QVector3D(0, 0, 10);
+    m_cameraPosition = QVector3D(0, -10, 0);
     m_cameraTarget = QVector3D(0, 0, 0);
-    m_cameraUp = QVector3D(0, 1, 0);
+    m_cameraUp = WorldUp;
     
     qDebug() << "SceneManager: Cleared scene";
     emit sceneChanged();
@@ -83,11 +187,15 @@ void SceneManager::clearScene() {
 Entity* SceneManager::createEntity(const QString& name) {
     Entity* entity = EntityManager::instance().createEntity(name);
     if (entity) {
+        releaseSnapshots();
         connectEntitySignals(entity);
+        m_transformHierarchy.addNode(entity->getId(), *entity->getTransform());
+        m_changeTracker.recordChange(entity->getId(), ChangeTracker::Structural::Created);
         
         // Add to default layer
-        if (m_layers.contains("Default")) {
-            setEntityLayer(entity->getId(), "Default");
+        LayerId defaultLayer = m_layerTable.find("Default");
+        if (defaultLayer != LayerTable::NoLayer) {
+            m_layerTable.assign(entity->getId(), defaultLayer);
         }
         
         emit entityCreated(entity);
@@ -98,18 +206,22 @@ Entity* SceneManager::createEntity(const QString& name) {
 void SceneManager::destroyEntity(EntityId id) {
     Entity* entity = EntityManager::instance().getEntity(id);
     if (entity) {
+        releaseSnapshots();
         disconnectEntitySignals(entity);
         
         // Remove from selection
         deselectEntity(id);
         
-        // Remove from layer
-        QString layer = getEntityLayer(id);
-        if (!layer.isEmpty() && m_layers.contains(layer)) {
-            m_layers[layer].entities.removeAll(id);
+        // Hand children over to this entity's parent
+        EntityId parentId = getEntityParent(id);
+        for (EntityId childId : getEntityChildren(id)) {
+            setEntityParent(childId, parentId);
         }
-        m_entityLayers.remove(id);
+        m_transformHierarchy.removeNode(id);
+        
+        m_layerTable.unassign(id);
         
+        m_changeTracker.recordChange(id, ChangeTracker::Structural::Destroyed);
         EntityManager::instance().destroyEntity(id);
         emit entityDestroyed(id);
     }
@@ -123,52 +235,237 @@ QVector<Entity*> SceneManager::getAllEntities() const {
     return EntityManager::instance().getAllEntities();
 }
 
+QVector<EntityId> SceneManager::findEntities(const EntityQuery& query) const {
+    m_entityIndex.sync();
+    
+    // Start from the smallest indexed candidate list
+    const QVector<EntityId>* candidates = nullptr;
+    auto consider = [&candidates](const QVector<EntityId>& list) {
+        if (!candidates || list.size() < candidates->size()) {
+            candidates = &list;
+        }
+    };
+    
+    if (query.hasModel()) {
+        consider(m_entityIndex.getByModel(query.getModel()));
+    }
+    for (int type = 0; type < 32; ++type) {
+        if (query.getComponentMask() & (ComponentMask(1) << type)) {
+            consider(m_entityIndex.getWithComponent(static_cast<ComponentType>(type)));
+        }
+    }
+    LayerId queryLayer = query.hasLayer() ? m_layerTable.find(query.getLayer()) : LayerTable::NoLayer;
+    if (query.hasLayer()) {
+        consider(m_layerTable.getMembers(queryLayer));
+    }
+    
+    QVector<EntityId> nameMatches;
+    if (query.hasNamePrefix()
+        && (!candidates || m_entityIndex.estimateByNamePrefix(query.getNamePrefix()) < candidates->size())) {
+        nameMatches = m_entityIndex.getByNamePrefix(query.getNamePrefix());
+        candidates = &nameMatches;
+    }
+    
+    QVector<EntityId> allIds;
+    if (!candidates) {
+        for (Entity* entity : getAllEntities()) {
+            allIds.append(entity->getId());
+        }
+        candidates = &allIds;
+    }
+    
+    // Check the remaining predicates on the candidates only
+    QVector<EntityId> result;
+    for (EntityId id : *candidates) {
+        if (query.getLimit() >= 0 && result.size() >= query.getLimit()) {
+            break;
+        }
+        if (query.hasModel() && !m_entityIndex.usesModelKey(id, query.getModel())) {
+            continue;
+        }
+        if (query.hasLayer() && (queryLayer == LayerTable::NoLayer || m_layerTable.getLayer(id) != queryLayer)) {
+            continue;
+        }
+        if (query.hasNamePrefix() && !m_entityIndex.matchesNamePrefix(id, query.getNamePrefix())) {
+            continue;
+        }
+        bool hasComponents = true;
+        for (int type = 0; type < 32 && hasComponents; ++type) {
+            if (query.getComponentMask() & (ComponentMask(1) << type)) {
+                hasComponents = m_entityIndex.hasComponent(id, static_cast<ComponentType>(type));
+            }
+        }
+        if (hasComponents) {
+            result.append(id);
+        }
+    }
+    return result;
+}
+
+bool SceneManager::setEntityParent(EntityId id, EntityId parentId) {
+    Entity* entity = getEntity(id);
+    auto* transform = entity ? entity->getComponent<TransformComponent>() : nullptr;
+    if (!transform) {
+        return false;
+    }
+    
+    releaseSnapshots();
+    if (!m_transformHierarchy.setParent(id, parentId)) {
+        qWarning() << "SceneManager: Cannot parent entity" << id << "to" << parentId;
+        return false;
+    }
+    
+    if (transform->parentId != parentId) {
+        transform->parentId = parentId;
+        m_changeTracker.recordChange(id, ComponentType::Transform);
+        emit entityParentChanged(id, parentId);
+        emit sceneChanged();
+    }
+    return true;
+}
+
+EntityId SceneManager::getEntityParent(EntityId id) const {
+    return m_transformHierarchy.getParent(id);
+}
+
+QVector<EntityId> SceneManager::getEntityChildren(EntityId id) const {
+    return m_transformHierarchy.getChildren(id);
+}
+
+QMatrix4x4 SceneManager::getWorldMatrix(EntityId id) const {
+    if (m_transformHierarchy.contains(id)) {
+        refreshTransforms(nullptr);
+        return m_transformHierarchy.getWorldMatrix(id);
+    }
+    
+    // Entities created outside the scene manager have no cached node
+    Entity* entity = getEntity(id);
+    Transform* transform = entity ? entity->getTransform() : nullptr;
+    return transform ? transform->getMatrix() : QMatrix4x4();
+}
+
+void SceneManager::updateTransforms() {
+    refreshTransforms(&JobSystem::instance());
+}
+
+SystemScheduler& SceneManager::getSystemScheduler() {
+    return m_systemScheduler;
+}
+
+void SceneManager::runSystems() {
+    releaseSnapshots();
+    m_systemScheduler.run();
+}
+
+const ChangeTracker& SceneManager::getChangeTracker() const {
+    return m_changeTracker;
+}
+
+quint64 SceneManager::getCurrentFrame() const {
+    return m_changeTracker.getCurrentFrame();
+}
+
+void SceneManager::advanceFrame() {
+    quint64 frame = m_changeTracker.advanceFrame();
+    if (frame > static_cast<quint64>(ChangeHistoryFrames)) {
+        m_changeTracker.discardBefore(frame - ChangeHistoryFrames);
+    }
+}
+
 void SceneManager::selectEntity(EntityId id) {
-    if (!m_selectedEntities.contains(id)) {
-        m_selectedEntities.append(id);
-        emit selectionChanged(m_selectedEntities);
+    if (m_selection.insert(id)) {
+        emit selectionChanged(QVector<EntityId>{id}, QVector<EntityId>());
     }
 }
 
 void SceneManager::deselectEntity(EntityId id) {
-    if (m_selectedEntities.removeAll(id) > 0) {
-        emit selectionChanged(m_selectedEntities);
+    if (m_selection.remove(id)) {
+        emit selectionChanged(QVector<EntityId>(), QVector<EntityId>{id});
     }
 }
 
 void SceneManager::clearSelection() {
-    if (!m_selectedEntities.isEmpty()) {
-        m_selectedEntities.clear();
-        emit selectionChanged(m_selectedEntities);
+    if (!m_selection.isEmpty()) {
+        QVector<EntityId> removed = m_selection.getIds();
+        m_selection.clear();
+        emit selectionChanged(QVector<EntityId>(), removed);
     }
 }
 
 void SceneManager::selectMultiple(const QVector<EntityId>& ids) {
-    m_selectedEntities = ids;
-    emit selectionChanged(m_selectedEntities);
+    SelectionSet next;
+    QVector<EntityId> added;
+    for (EntityId id : ids) {
+        if (next.insert(id) && !m_selection.contains(id)) {
+            added.append(id);
+        }
+    }
+    
+    QVector<EntityId> removed;
+    for (EntityId id : m_selection.getIds()) {
+        if (!next.contains(id)) {
+            removed.append(id);
+        }
+    }
+    
+    m_selection = std::move(next);
+    if (!added.isEmpty() || !removed.isEmpty()) {
+        emit selectionChanged(added, removed);
+    }
+}
+
+void SceneManager::addToSelection(const QVector<EntityId>& ids) {
+    QVector<EntityId> added;
+    for (EntityId id : ids) {
+        if (m_selection.insert(id)) {
+            added.append(id);
+        }
+    }
+    if (!added.isEmpty()) {
+        emit selectionChanged(added, QVector<EntityId>());
+    }
+}
+
+void SceneManager::removeFromSelection(const QVector<EntityId>& ids) {
+    QVector<EntityId> removed;
+    for (EntityId id : ids) {
+        if (m_selection.remove(id)) {
+            removed.append(id);
+        }
+    }
+    if (!removed.isEmpty()) {
+        emit selectionChanged(QVector<EntityId>(), removed);
+    }
+}
+
+bool SceneManager::isSelected(EntityId id) const {
+    return m_selection.contains(id);
 }
 
-QVector<EntityId> SceneManager::getSelectedEntities() const {
-    return m_selectedEntities;
+int SceneManager::getSelectionCount() const {
+    return m_selection.size();
+}
+
+const QVector<EntityId>& SceneManager::getSelectedEntities() const {
+    return m_selection.getIds();
 }
 
 Entity* SceneManager::getPrimarySelection() const {
-    if (m_selectedEntities.isEmpty()) {
-        return nullptr;
-    }
-    return getEntity(m_selectedEntities.first());
+    return m_selection.isEmpty() ? nullptr : getEntity(m_selection.getFirst());
 }
 
 QVector<Entity*> SceneManager::getEntitiesInRadius(const QVector3D& center, float radius) const {
+    syncSpatialIndex();
+    
+    QVector<EntityId> candidates;
+    m_spatialIndex.querySphere(center, radius, candidates);
+    std::sort(candidates.begin(), candidates.end());
+    
     QVector<Entity*> result;
     float radiusSquared = radius * radius;
-    
-    for (Entity* entity : getAllEntities()) {
-        if (entity) {
-            float distanceSquared = MathUtils::distanceSquared(center, entity->getPosition());
-            if (distanceSquared <= radiusSquared) {
-                result.append(entity);
-            }
+    for (EntityId id : candidates) {
+        if (MathUtils::distanceSquared(center, getWorldPosition(id)) <= radiusSquared) {
+            result.append(getEntity(id));
         }
     }
     
@@ -176,60 +473,283 @@ QVector<Entity*> SceneManager::getEntitiesInRadius(const QVector3D& center, floa
 }
 
 QVector<Entity*> SceneManager::getEntitiesInBox(const BoundingBox& box) const {
-    QVector<Entity*> result;
+    syncSpatialIndex();
     
-    for (Entity* entity : getAllEntities()) {
-        if (entity && box.contains(entity->getPosition())) {
-            result.append(entity);
+    QVector<EntityId> candidates;
+    m_spatialIndex.queryBox(box, candidates);
+    std::sort(candidates.begin(), candidates.end());
+    
+    QVector<Entity*> result;
+    for (EntityId id : candidates) {
+        if (box.contains(getWorldPosition(id))) {
+            result.append(getEntity(id));
         }
     }
     
     return result;
 }
 
+int SceneManager::getEntitiesInFrustum(const Frustum& frustum, QVector<EntityId>& out) const {
+    syncSpatialIndex();
+    return m_spatialIndex.queryFrustum(frustum, out);
+}
+
+QVector<EntityId> SceneManager::pickEntitiesInFrustum(const Frustum& frustum, bool fullyInside) const {
+    QVector<EntityId> candidates;
+    getEntitiesInFrustum(frustum, candidates);
+    
+    // The BVH works on fattened boxes; refine against the exact bounds
+    quint64 excludedLayers = m_layerTable.getHiddenMask() | m_layerTable.getLockedMask();
+    int kept = 0;
+    for (EntityId id : candidates) {
+        if (m_layerTable.getLayerBit(id) & excludedLayers) {
+            continue;
+        }
+        bool inside;
+        if (const BoundingBox* bounds = m_boundsCache.find(id)) {
+            inside = fullyInside ? frustum.contains(*bounds) : frustum.intersects(*bounds);
+        } else {
+            inside = frustum.contains(getWorldPosition(id));
+        }
+        if (inside) {
+            candidates[kept++] = id;
+        }
+    }
+    candidates.resize(kept);
+    return candidates;
+}
+
+int SceneManager::getEntitiesInView(const Frustum& frustum, const QVector3D& eye, QVector<EntityId>& out) const {
+    syncSpatialIndex();
+    return queryView(m_spatialIndex, m_transformHierarchy, m_lodTable, m_drawDistanceMultiplier, frustum, eye, out);
+}
+
+int SceneManager::ViewSnapshot::getEntitiesInView(const Frustum& frustum, const QVector3D& eye,
+                                                  QVector<EntityId>& out) const {
+    return queryView(spatialIndex, transforms, lods, drawDistanceMultiplier, frustum, eye, out);
+}
+
+SceneManager::ViewSnapshot SceneManager::snapshotView() const {
+    syncSpatialIndex();
+    
+    ViewSnapshot snapshot;
+    snapshot.spatialIndex = m_spatialIndex;
+    snapshot.transforms = m_transformHierarchy;
+    snapshot.bounds = m_boundsCache;
+    snapshot.lods = m_lodTable;
+    snapshot.layers = m_layerTable;
+    snapshot.occluders = m_occlusionZones;
+    snapshot.drawDistanceMultiplier = m_drawDistanceMultiplier;
+    snapshot.frame = m_changeTracker.getCurrentFrame();
+    return snapshot;
+}
+
+void SceneManager::setSnapshotFence(std::function<void()> fence) {
+    m_snapshotFence = std::move(fence);
+}
+
+int SceneManager::queryView(const DynamicBVH& spatialIndex, const TransformHierarchy& transforms,
+                            const LodTable& lods, float multiplier, const Frustum& frustum,
+                            const QVector3D& eye, QVector<EntityId>& out) {
+    // The BVH drops whole subtrees that are out of range; the exact test
+    // against each entity's position and LOD handover follow, compacting
+    // the new entries in place
+    int first = out.size();
+    int visited = spatialIndex.queryFrustum(frustum, out, eye, multiplier);
+    int kept = first;
+    for (int i = first; i < out.size(); ++i) {
+        EntityId id = out[i];
+        float distance = (transforms.getWorldMatrix(id).column(3).toVector3D() - eye).length();
+        if (lods.isDrawnAt(id, distance, multiplier)) {
+            out[kept++] = id;
+        }
+    }
+    out.resize(kept);
+    return visited;
+}
+
 Entity* SceneManager::raycast(const QVector3D& origin, const QVector3D& direction, float maxDistance) const {
-    Entity* closestEntity = nullptr;
-    float closestDistance = maxDistance;
+    RaycastHit hit;
+    return raycast(origin, direction, hit, maxDistance) ? getEntity(hit.entity) : nullptr;
+}
+
+bool SceneManager::raycast(const QVector3D& origin, const QVector3D& direction, RaycastHit& hit,
+                           float maxDistance, const QSet<EntityId>* ignore) const {
+    syncSpatialIndex();
     
-    for (Entity* entity : getAllEntities()) {
-        if (!entity) continue;
-        
-        // Get entity's mesh component for bounding box
-        MeshComponent* meshComp = entity->getComponent<MeshComponent>();
-        if (!meshComp) continue;
-        
-        // Transform bounding box to world space
-        Transform* transform = entity->getTransform();
-        if (!transform) continue;
-        
-        QMatrix4x4 worldMatrix = transform->getMatrix();
-        QVector3D worldMin = worldMatrix * meshComp->boundingBox.min;
-        QVector3D worldMax = worldMatrix * meshComp->boundingBox.max;
+    QVector3D unitDirection = direction.normalized();
+    if (unitDirection.isNull()) {
+        return false;
+    }
+    
+    // The BVH orders candidates by their fattened boxes; each is tested
+    // against its cached world bounds and then, when the model is known,
+    // against its triangles in model space. The inverse world matrix keeps
+    // the ray parameter, so model-space distances compare directly.
+    // Entities on hidden or locked layers cannot be picked.
+    quint64 excludedLayers = m_layerTable.getHiddenMask() | m_layerTable.getLockedMask();
+    float closest = maxDistance;
+    QVector3D closestNormal;
+    EntityId hitId = m_spatialIndex.raycast(origin, unitDirection, maxDistance,
+        [&](EntityId id, float& distance) {
+            if ((m_layerTable.getLayerBit(id) & excludedLayers) || (ignore && ignore->contains(id))) {
+                return false;
+            }
+            const BoundingBox* worldBox = m_boundsCache.find(id);
+            if (!worldBox || !MathUtils::rayIntersectsBox(origin, unitDirection, worldBox->min, worldBox->max, distance)) {
+                return false;
+            }
+            
+            QVector3D normal;
+            if (const TriangleBVH* triangles = getModelTriangles(id)) {
+                bool invertible = false;
+                QMatrix4x4 inverse = m_transformHierarchy.getWorldMatrix(id).inverted(&invertible);
+                TriangleBVH::Hit local;
+                if (!invertible || !triangles->raycast(inverse.map(origin), inverse.mapVector(unitDirection),
+                                                       closest, local)) {
+                    return false;
+                }
+                distance = local.distance;
+                normal = inverse.transposed().mapVector(local.normal);
+            } else {
+                normal = MathUtils::boxNormalAt(*worldBox, origin + unitDirection * distance);
+            }
+            
+            if (distance < closest) {
+                closest = distance;
+                closestNormal = normal;
+            }
+            return true;
+        });
+    
+    if (!hitId) {
+        return false;
+    }
+    
+    hit.entity = hitId;
+    hit.distance = closest;
+    hit.position = origin + unitDirection * closest;
+    hit.normal = closestNormal.normalized();
+    if (QVector3D::dotProduct(hit.normal, unitDirection) > 0.0f) {
+        hit.normal = -hit.normal;
+    }
+    return true;
+}
+
+bool SceneManager::snapToSurface(QVector3D& position, QVector3D* normal, float maxDistance) const {
+    RaycastHit hit;
+    if (!raycast(position, -WorldUp, hit, maxDistance)) {
+        return false;
+    }
+    position = hit.position;
+    if (normal) {
+        *normal = hit.normal;
+    }
+    return true;
+}
+
+int SceneManager::dropToGround(const QVector<EntityId>& ids, float maxDistance) {
+    syncSpatialIndex();
+    
+    QSet<EntityId> batch;
+    batch.reserve(ids.size());
+    for (EntityId id : ids) {
+        batch.insert(id);
+    }
+    
+    // Probe for every entity before moving any, so results do not depend
+    // on batch order. Children of batch members move with their parent.
+    struct Drop {
+        Entity* entity;
+        float offset; // World Z
+    };
+    QVector<Drop> drops;
+    drops.reserve(ids.size());
+    for (EntityId id : ids) {
+        Entity* entity = getEntity(id);
+        if (!entity) {
+            continue;
+        }
+        bool ancestorInBatch = false;
+        for (EntityId parent = getEntityParent(id); parent && !ancestorInBatch; parent = getEntityParent(parent)) {
+            ancestorInBatch = batch.contains(parent);
+        }
+        if (ancestorInBatch) {
+            continue;
+        }
         
-        // Ensure min/max are correct
-        BoundingBox worldBox(
-            QVector3D(qMin(worldMin.x(), worldMax.x()), qMin(worldMin.y(), worldMax.y()), qMin(worldMin.z(), worldMax.z())),
-            QVector3D(qMax(worldMin.x(), worldMax.x()), qMax(worldMin.y(), worldMax.y()), qMax(worldMin.z(), worldMax.z()))
-        );
+        QVector3D position = getWorldPosition(id);
+        QVector3D probe = position;
+        float bottom = position.z();
+        if (const BoundingBox* bounds = m_boundsCache.find(id)) {
+            probe = QVector3D(bounds->center().x(), bounds->center().y(), bounds->max.z());
+            bottom = bounds->min.z();
+        }
         
-        float distance;
-        if (MathUtils::rayIntersectsBox(origin, direction, worldBox.min, worldBox.max, distance)) {
-            if (distance < closestDistance) {
-                closestDistance = distance;
-                closestEntity = entity;
-            }
+        RaycastHit hit;
+        if (raycast(probe, -WorldUp, hit, maxDistance, &batch)) {
+            drops.append(Drop{entity, hit.position.z() - bottom});
         }
     }
     
-    return closestEntity;
+    for (const Drop& drop : drops) {
+        QVector3D offset(0, 0, drop.offset);
+        EntityId parent = getEntityParent(drop.entity->getId());
+        if (parent) {
+            offset = m_transformHierarchy.getWorldMatrix(parent).inverted().mapVector(offset);
+        }
+        drop.entity->setPosition(drop.entity->getPosition() + offset);
+    }
+    
+    qDebug() << "SceneManager: Dropped" << drops.size() << "of" << ids.size() << "entities to the ground";
+    return drops.size();
+}
+
+bool SceneManager::getWorldBounds(EntityId id, BoundingBox& bounds) const {
+    syncSpatialIndex();
+    
+    const BoundingBox* cached = m_boundsCache.find(id);
+    if (!cached) {
+        return false;
+    }
+    bounds = *cached;
+    return true;
+}
+
+const BoundsCache& SceneManager::getBoundsCache() const {
+    syncSpatialIndex();
+    return m_boundsCache;
+}
+
+const WorldGrid& SceneManager::getWorldGrid() const {
+    syncSpatialIndex();
+    return m_worldGrid;
+}
+
+void SceneManager::setWorldCellSize(float size) {
+    m_worldGrid.setCellSize(size);
+}
+
+QVector<EntityId> SceneManager::getEntitiesInCells(const GridCell& min, const GridCell& max) const {
+    syncSpatialIndex();
+    
+    QVector<EntityId> result;
+    m_worldGrid.queryCells(min, max, result);
+    return result;
 }
 
 void SceneManager::createLayer(const QString& name) {
-    if (!m_layers.contains(name)) {
-        m_layers[name] = LayerInfo();
-        qDebug() << "SceneManager: Created layer:" << name;
-        emit layerCreated(name);
+    if (m_layerTable.find(name) != LayerTable::NoLayer) {
+        return;
+    }
+    
+    releaseSnapshots();
+    if (m_layerTable.create(name) == LayerTable::NoLayer) {
+        qWarning() << "SceneManager: Cannot create layer" << name << "- limit of" << LayerTable::MaxLayers << "reached";
+        return;
     }
+    qDebug() << "SceneManager: Created layer:" << name;
+    emit layerCreated(name);
 }
 
 void SceneManager::deleteLayer(const QString& name) {
@@ -238,61 +758,73 @@ void SceneManager::deleteLayer(const QString& name) {
         return;
     }
     
-    if (m_layers.contains(name)) {
-        // Move entities to default layer
-        LayerInfo& layerInfo = m_layers[name];
-        for (EntityId id : layerInfo.entities) {
-            setEntityLayer(id, "Default");
-        }
+    LayerId layer = m_layerTable.find(name);
+    if (layer != LayerTable::NoLayer) {
+        releaseSnapshots();
         
-        m_layers.remove(name);
+        // Members move to the default layer in one bulk pass
+        m_layerTable.destroy(layer, m_layerTable.find("Default"));
         qDebug() << "SceneManager: Deleted layer:" << name;
         emit layerDeleted(name);
     }
 }
 
 void SceneManager::setEntityLayer(EntityId id, const QString& layer) {
-    // Remove from old layer
-    QString oldLayer = getEntityLayer(id);
-    if (!oldLayer.isEmpty() && m_layers.contains(oldLayer)) {
-        m_layers[oldLayer].entities.removeAll(id);
+    LayerId layerId = m_layerTable.find(layer);
+    if (layerId == LayerTable::NoLayer) {
+        qWarning() << "SceneManager: Unknown layer" << layer;
+        return;
     }
-    
-    // Add to new layer
-    if (m_layers.contains(layer)) {
-        m_layers[layer].entities.append(id);
-        m_entityLayers[id] = layer;
+    releaseSnapshots();
+    m_layerTable.assign(id, layerId);
+}
+
+void SceneManager::setEntitiesLayer(const QVector<EntityId>& ids, const QString& layer) {
+    LayerId layerId = m_layerTable.find(layer);
+    if (layerId == LayerTable::NoLayer) {
+        qWarning() << "SceneManager: Unknown layer" << layer;
+        return;
     }
+    releaseSnapshots();
+    m_layerTable.assign(ids, layerId);
 }
 
 QString SceneManager::getEntityLayer(EntityId id) const {
-    return m_entityLayers.value(id, "");
+    return m_layerTable.getName(m_layerTable.getLayer(id));
 }
 
 QStringList SceneManager::getAllLayers() const {
-    return m_layers.keys();
+    return m_layerTable.getNames();
+}
+
+const LayerTable& SceneManager::getLayerTable() const {
+    return m_layerTable;
 }
 
 void SceneManager::setLayerVisible(const QString& layer, bool visible) {
-    if (m_layers.contains(layer)) {
-        m_layers[layer].visible = visible;
+    LayerId layerId = m_layerTable.find(layer);
+    if (layerId != LayerTable::NoLayer) {
+        releaseSnapshots();
+        m_layerTable.setHidden(layerId, !visible);
         emit layerVisibilityChanged(layer, visible);
     }
 }
 
 bool SceneManager::isLayerVisible(const QString& layer) const {
-    return m_layers.value(layer).visible;
+    return !(m_layerTable.getHiddenMask() & LayerTable::layerBit(m_layerTable.find(layer)));
 }
 
 void SceneManager::setLayerLocked(const QString& layer, bool locked) {
-    if (m_layers.contains(layer)) {
-        m_layers[layer].locked = locked;
+    LayerId layerId = m_layerTable.find(layer);
+    if (layerId != LayerTable::NoLayer) {
+        releaseSnapshots();
+        m_layerTable.setLocked(layerId, locked);
         emit layerLockChanged(layer, locked);
     }
 }
 
 bool SceneManager::isLayerLocked(const QString& layer) const {
-    return m_layers.value(layer).locked;
+    return (m_layerTable.getLockedMask() & LayerTable::layerBit(m_layerTable.find(layer))) != 0;
 }
 
 void SceneManager::setGridSize(float size) {
@@ -343,6 +875,23 @@ QVector3D SceneManager::getCameraUp() const {
     return m_cameraUp;
 }
 
+void SceneManager::setDrawDistanceMultiplier(float multiplier) {
+    multiplier = qMax(0.01f, multiplier);
+    if (m_drawDistanceMultiplier != multiplier) {
+        m_drawDistanceMultiplier = multiplier;
+        emit sceneChanged();
+    }
+}
+
+float SceneManager::getDrawDistanceMultiplier() const {
+    return m_drawDistanceMultiplier;
+}
+
+const LodTable& SceneManager::getLodTable() const {
+    syncSpatialIndex();
+    return m_lodTable;
+}
+
 void SceneManager::setWireframeMode(bool enabled) {
     if (m_wireframeMode != enabled) {
         m_wireframeMode = enabled;
@@ -377,33 +926,136 @@ bool SceneManager::isShowBoundingBoxes() const {
 }
 
 bool SceneManager::loadGTAMap(const QString& iplPath, const QString& idePath) {
-    // This would use the file parsers to load GTA map data
-    // For now, we'll create a placeholder implementation
     qDebug() << "SceneManager: Loading GTA map from" << iplPath << "and" << idePath;
     
-    // TODO: Implement actual GTA map loading using IPL and IDE parsers
-    // This would involve:
-    // 1. Parse IDE file to get object definitions
-    // 2. Parse IPL file to get object placements
-    // 3. Create entities for each placed object
-    // 4. Load associated DFF and TXD files
+    QVector<IDEObject> definitions;
+    if (!idePath.isEmpty() && !IDEParser::parseFromFile(idePath, definitions)) {
+        return false;
+    }
+    
+    QVector<IPLInstance> instances;
+    QVector<IPLOcclusionZone> occluders;
+    if (!IPLParser::parseFromFile(iplPath, instances, occluders)) {
+        return false;
+    }
+    
+    QHash<uint32_t, int> definitionIndex;
+    definitionIndex.reserve(definitions.size());
+    for (int i = 0; i < definitions.size(); ++i) {
+        definitionIndex.insert(definitions[i].id, i);
+    }
     
+    // Create every instance first; LOD links are indices into this file's
+    // INST list, so they are resolved once all entities exist
+    QVector<EntityId> created;
+    QVector<MeshComponent*> meshes;
+    created.reserve(instances.size());
+    meshes.reserve(instances.size());
+    for (const IPLInstance& instance : instances) {
+        Entity* entity = createEntity(instance.modelName);
+        if (!entity) {
+            created.append(0);
+            meshes.append(nullptr);
+            continue;
+        }
+        entity->setPosition(instance.transform.position);
+        entity->setRotation(instance.transform.rotation);
+        
+        MeshComponent* meshComp = entity->addComponent<MeshComponent>();
+        meshComp->meshPath = instance.modelName;
+        int definition = definitionIndex.value(instance.id, -1);
+        if (definition >= 0) {
+            meshComp->materialPath = definitions[definition].textureName;
+            meshComp->drawDistance = definitions[definition].drawDistance;
+            meshComp->objectFlags = definitions[definition].flags;
+        }
+        created.append(entity->getId());
+        meshes.append(meshComp);
+    }
+    
+    int linked = 0;
+    for (int i = 0; i < instances.size(); ++i) {
+        int lod = instances[i].lod;
+        if (meshes[i] && lod >= 0 && lod < created.size() && lod != i && created[lod]) {
+            // The mesh was added this call, so the spatial sync still
+            // sees it as changed and picks the link up
+            meshes[i]->lodParent = created[lod];
+            ++linked;
+        }
+    }
+    
+    addOcclusionZones(occluders);
+    
+    qDebug() << "SceneManager: Loaded" << instances.size() << "instances," << linked << "with LOD parents,"
+             << occluders.size() << "occluders";
+    emit sceneChanged();
     return true;
 }
 
 bool SceneManager::loadDFFModel(const QString& dffPath, const QString& txdPath) {
-    // This would use the DFF parser to load a model
     qDebug() << "SceneManager: Loading DFF model from" << dffPath;
     
-    // TODO: Implement actual DFF model loading
-    // This would involve:
-    // 1. Parse DFF file to get model data
-    // 2. Parse TXD file to get textures (if provided)
-    // 3. Create entity with mesh component
+    GTAModel model;
+    if (!DFFParser::parseFromFile(dffPath, model)) {
+        qWarning() << "SceneManager: Failed to parse DFF model" << dffPath;
+        return false;
+    }
+    
+    QString name = model.name.isEmpty() ? QFileInfo(dffPath).completeBaseName() : model.name;
+    registerModel(name, model);
+    
+    Entity* entity = createEntity(name);
+    if (!entity) {
+        return false;
+    }
+    MeshComponent* meshComp = entity->addComponent<MeshComponent>();
+    meshComp->meshPath = name;
+    if (!txdPath.isEmpty()) {
+        // A TXD that fails to load still names the dictionary to look for
+        loadTextureDictionary(txdPath);
+        meshComp->materialPath = QFileInfo(txdPath).completeBaseName();
+    }
+    meshComp->boundingBox = model.boundingBox;
     
+    emit sceneChanged();
     return true;
 }
 
+void SceneManager::registerModel(const QString& name, const GTAModel& model) {
+    m_modelLibrary.add(name, model);
+    
+    for (Entity* entity : getAllEntities()) {
+        MeshComponent* meshComp = entity->getComponent<MeshComponent>();
+        if (meshComp && meshComp->meshPath == name && meshComp->boundingBox.min == meshComp->boundingBox.max) {
+            meshComp->boundingBox = model.boundingBox;
+            entity->markComponentChanged(ComponentType::Mesh);
+        }
+    }
+}
+
+const ModelLibrary& SceneManager::getModelLibrary() const {
+    return m_modelLibrary;
+}
+
+bool SceneManager::loadTextureDictionary(const QString& txdPath) {
+    QVector<TXDParser::GTATexture> textures;
+    if (!TXDParser::parseFromFile(txdPath, textures)) {
+        qWarning() << "SceneManager: Failed to parse TXD" << txdPath;
+        return false;
+    }
+    
+    registerTextureDictionary(QFileInfo(txdPath).completeBaseName(), textures);
+    return true;
+}
+
+void SceneManager::registerTextureDictionary(const QString& name, const QVector<TXDParser::GTATexture>& textures) {
+    m_textureLibrary.add(name, textures);
+}
+
+const TextureLibrary& SceneManager::getTextureLibrary() const {
+    return m_textureLibrary;
+}
+
 void SceneManager::addTriggerZone(const TriggerZone& zone) {
     m_triggerZones.append(zone);
     emit sceneChanged();
@@ -432,6 +1084,62 @@ TriggerZone* SceneManager::getTriggerZone(const QString& name) {
     return nullptr;
 }
 
+void SceneManager::addOcclusionZones(const QVector<IPLOcclusionZone>& zones) {
+    if (zones.isEmpty()) {
+        return;
+    }
+    releaseSnapshots();
+    m_occlusionZones.append(zones);
+    emit sceneChanged();
+}
+
+void SceneManager::clearOcclusionZones() {
+    if (!m_occlusionZones.isEmpty()) {
+        releaseSnapshots();
+        m_occlusionZones.clear();
+        emit sceneChanged();
+    }
+}
+
+const QVector<IPLOcclusionZone>& SceneManager::getOcclusionZones() const {
+    return m_occlusionZones;
+}
+
+bool SceneManager::loadPathFile(const QString& datPath) {
+    QVector<DATParser::PathNode> nodes;
+    if (!DATParser::parsePathFromFile(datPath, nodes)) {
+        qWarning() << "SceneManager: Failed to load path file:" << datPath;
+        return false;
+    }
+    addPathNodes(nodes);
+    return true;
+}
+
+void SceneManager::addPathNodes(const QVector<DATParser::PathNode>& nodes) {
+    if (nodes.isEmpty()) {
+        return;
+    }
+    m_pathNodes.append(nodes);
+    ++m_pathRevision;
+    emit sceneChanged();
+}
+
+void SceneManager::clearPathNodes() {
+    if (!m_pathNodes.isEmpty()) {
+        m_pathNodes.clear();
+        ++m_pathRevision;
+        emit sceneChanged();
+    }
+}
+
+const QVector<DATParser::PathNode>& SceneManager::getPathNodes() const {
+    return m_pathNodes;
+}
+
+quint64 SceneManager::getPathRevision() const {
+    return m_pathRevision;
+}
+
 void SceneManager::addMissionObjective(const MissionObjective& objective) {
     m_missionObjectives.append(objective);
     emit sceneChanged();
@@ -480,16 +1188,17 @@ QVariantMap SceneManager::serialize() const {
     
     // Serialize layers
     QVariantMap layersData;
-    for (auto it = m_layers.begin(); it != m_layers.end(); ++it) {
+    for (const QString& name : m_layerTable.getNames()) {
+        LayerId layer = m_layerTable.find(name);
         QVariantMap layerData;
-        layerData["visible"] = it->visible;
-        layerData["locked"] = it->locked;
+        layerData["visible"] = !(m_layerTable.getHiddenMask() & LayerTable::layerBit(layer));
+        layerData["locked"] = (m_layerTable.getLockedMask() & LayerTable::layerBit(layer)) != 0;
         QVariantList entityIds;
-        for (EntityId id : it->entities) {
+        for (EntityId id : m_layerTable.getMembers(layer)) {
             entityIds.append(id);
         }
         layerData["entities"] = entityIds;
-        layersData[it.key()] = layerData;
+        layersData[name] = layerData;
     }
     data["layers"] = layersData;
     
@@ -506,6 +1215,18 @@ QVariantMap SceneManager::serialize() const {
     }
     data["triggerZones"] = triggerZonesData;
     
+    // Serialize occlusion zones
+    QVariantList occlusionZonesData;
+    for (const auto& zone : m_occlusionZones) {
+        QVariantMap zoneData;
+        zoneData["position"] = QVariant::fromValue(zone.position);
+        zoneData["size"] = QVariant::fromValue(zone.size);
+        zoneData["rotation"] = QVariant::fromValue(zone.rotation);
+        zoneData["flags"] = zone.flags;
+        occlusionZonesData.append(zoneData);
+    }
+    data["occlusionZones"] = occlusionZonesData;
+    
     // Serialize mission objectives
     QVariantList objectivesData;
     for (const auto& objective : m_missionObjectives) {
@@ -523,6 +1244,7 @@ QVariantMap SceneManager::serialize() const {
 }
 
 void SceneManager::deserialize(const QVariantMap& data) {
+    releaseSnapshots();
     m_sceneName = data.value("sceneName", "Untitled Scene").toString();
     m_sceneDescription = data.value("sceneDescription", "").toString();
     m_gridSize = data.value("gridSize", 1.0f).toFloat();
@@ -540,24 +1262,29 @@ void SceneManager::deserialize(const QVariantMap& data) {
     // Connect signals for all entities
     for (Entity* entity : getAllEntities()) {
         connectEntitySignals(entity);
+        m_changeTracker.recordChange(entity->getId(), ChangeTracker::Structural::Created);
     }
+    rebuildTransformHierarchy();
     
     // Deserialize layers
     QVariantMap layersData = data.value("layers").toMap();
     for (auto it = layersData.begin(); it != layersData.end(); ++it) {
         QVariantMap layerData = it.value().toMap();
-        LayerInfo layerInfo;
-        layerInfo.visible = layerData.value("visible", true).toBool();
-        layerInfo.locked = layerData.value("locked", false).toBool();
+        LayerId layer = m_layerTable.create(it.key());
+        if (layer == LayerTable::NoLayer) {
+            qWarning() << "SceneManager: Dropping layer" << it.key() << "- limit of" << LayerTable::MaxLayers << "reached";
+            continue;
+        }
+        m_layerTable.setHidden(layer, !layerData.value("visible", true).toBool());
+        m_layerTable.setLocked(layer, layerData.value("locked", false).toBool());
         
         QVariantList entityIds = layerData.value("entities").toList();
+        QVector<EntityId> members;
+        members.reserve(entityIds.size());
         for (const QVariant& idVariant : entityIds) {
-            EntityId id = idVariant.toUInt();
-            layerInfo.entities.append(id);
-            m_entityLayers[id] = it.key();
+            members.append(idVariant.toUInt());
         }
-        
-        m_layers[it.key()] = layerInfo;
+        m_layerTable.assign(members, layer);
     }
     
     // Deserialize trigger zones
@@ -573,6 +1300,18 @@ void SceneManager::deserialize(const QVariantMap& data) {
         m_triggerZones.append(zone);
     }
     
+    // Deserialize occlusion zones
+    QVariantList occlusionZonesData = data.value("occlusionZones").toList();
+    for (const QVariant& zoneVariant : occlusionZonesData) {
+        QVariantMap zoneData = zoneVariant.toMap();
+        IPLOcclusionZone zone;
+        zone.position = zoneData.value("position").value<QVector3D>();
+        zone.size = zoneData.value("size").value<QVector3D>();
+        zone.rotation = zoneData.value("rotation").value<QVector3D>();
+        zone.flags = zoneData.value("flags").toUInt();
+        m_occlusionZones.append(zone);
+    }
+    
     // Deserialize mission objectives
     QVariantList objectivesData = data.value("missionObjectives").toList();
     for (const QVariant& objVariant : objectivesData) {
@@ -589,9 +1328,22 @@ void SceneManager::deserialize(const QVariantMap& data) {
 
 void SceneManager::connectEntitySignals(Entity* entity) {
     if (entity) {
-        connect(entity, &Entity::nameChanged, this, &SceneManager::sceneChanged);
-        connect(entity, &Entity::componentAdded, this, &SceneManager::sceneChanged);
-        connect(entity, &Entity::componentRemoved, this, &SceneManager::sceneChanged);
+        EntityId id = entity->getId();
+        connect(entity, &Entity::nameChanged, this, [this, id]() {
+            m_changeTracker.recordChange(id, ChangeTracker::Structural::Renamed);
+            emit sceneChanged();
+        });
+        connect(entity, &Entity::componentAdded, this, [this, id](Component* component) {
+            m_changeTracker.recordChange(id, ChangeTracker::Structural::ComponentsChanged);
+            m_changeTracker.recordChange(id, component->getType());
+            emit sceneChanged();
+        });
+        connect(entity, &Entity::componentRemoved, this, [this, id](Component* component) {
+            m_changeTracker.recordChange(id, ChangeTracker::Structural::ComponentsChanged);
+            m_changeTracker.recordChange(id, component->getType());
+            emit sceneChanged();
+        });
+        connect(entity, &Entity::componentChanged, this, &SceneManager::onEntityComponentChanged);
     }
 }
 
@@ -601,5 +1353,198 @@ void SceneManager::disconnectEntitySignals(Entity* entity) {
     }
 }
 
-#include "scene_manager.moc"
+void SceneManager::rebuildTransformHierarchy() {
+    m_transformHierarchy.clear();
+    
+    const QVector<Entity*> entities = getAllEntities();
+    for (Entity* entity : entities) {
+        if (Transform* transform = entity->getTransform()) {
+            m_transformHierarchy.addNode(entity->getId(), *transform);
+        }
+    }
+    
+    // Links are restored once every node exists
+    for (Entity* entity : entities) {
+        EntityId parentId = entity->getParentId();
+        if (parentId != 0 && !m_transformHierarchy.setParent(entity->getId(), parentId)) {
+            qWarning() << "SceneManager: Dropping invalid parent" << parentId << "of entity" << entity->getId();
+            entity->getComponent<TransformComponent>()->parentId = 0;
+        }
+    }
+}
+
+void SceneManager::refreshTransforms(JobSystem* jobs) const {
+    releaseSnapshots();
+    if (m_transformHierarchy.update(jobs) > 0) {
+        recordMovedTransforms();
+    }
+}
+
+void SceneManager::recordMovedTransforms() const {
+    // Moved entities need their spatial index leaf refreshed, and
+    // renderers holding copies of their matrices need to hear about it
+    for (EntityId id : m_transformHierarchy.getLastUpdated()) {
+        m_spatialDirty.insert(id);
+        m_changeTracker.recordChange(id, ChangeTracker::Structural::Moved);
+    }
+}
+
+void SceneManager::releaseSnapshots() const {
+    if (m_snapshotFence) {
+        m_snapshotFence();
+    }
+}
+
+void SceneManager::syncSpatialIndex() const {
+    refreshTransforms(&JobSystem::instance());
+    
+    QVector<EntityId> dirty;
+    if (collectSpatialChanges(dirty)) {
+        m_boundsCache.refresh(dirty, m_transformHierarchy);
+        applySpatialChanges(dirty);
+    }
+}
+
+bool SceneManager::collectSpatialChanges(QVector<EntityId>& dirty) const {
+    if (m_spatialSyncedFrame == 0) {
+        rebuildSpatialIndex();
+        return false;
+    }
+    
+    QVector<EntityId> changed;
+    bool complete = m_changeTracker.getChangedSince(ChangeTracker::Structural::Created, m_spatialSyncedFrame, changed)
+        && m_changeTracker.getChangedSince(ChangeTracker::Structural::Destroyed, m_spatialSyncedFrame, changed)
+        && m_changeTracker.getChangedSince(ChangeTracker::Structural::ComponentsChanged, m_spatialSyncedFrame, changed)
+        && m_changeTracker.getChangedSince(ComponentType::Mesh, m_spatialSyncedFrame, changed);
+    if (!complete) {
+        rebuildSpatialIndex();
+        return false;
+    }
+    
+    for (EntityId id : changed) {
+        m_spatialDirty.insert(id);
+    }
+    dirty = m_spatialDirty.values();
+    m_spatialDirty.clear();
+    m_spatialSyncedFrame = m_changeTracker.getCurrentFrame();
+    
+    // Local mesh bounds first; the world boxes of every dirty entity are
+    // then recomputed in one batch before the tree and grid consume them
+    for (EntityId id : dirty) {
+        Entity* entity = getEntity(id);
+        MeshComponent* meshComp = entity ? entity->getComponent<MeshComponent>() : nullptr;
+        if (meshComp) {
+            m_boundsCache.setLocalBounds(id, meshComp->boundingBox);
+            m_lodTable.set(id, meshComp->drawDistance, meshComp->lodParent);
+        } else {
+            m_boundsCache.remove(id);
+            m_lodTable.remove(id);
+        }
+    }
+    return !dirty.isEmpty();
+}
+
+void SceneManager::applySpatialChanges(const QVector<EntityId>& dirty) const {
+    for (EntityId id : dirty) {
+        Entity* entity = getEntity(id);
+        if (entity) {
+            m_spatialIndex.update(id, computeEntityBounds(entity));
+            m_spatialIndex.setDrawDistance(id, m_lodTable.getDrawDistance(id));
+            m_worldGrid.set(id, getWorldPosition(id), estimateEntityMemory(entity));
+        } else {
+            m_spatialIndex.remove(id);
+            m_worldGrid.remove(id);
+        }
+    }
+}
+
+void SceneManager::rebuildSpatialIndex() const {
+    QVector<Entity*> entities = getAllEntities();
+    QVector<EntityId> ids;
+    QVector<BoundingBox> boxes;
+    ids.reserve(entities.size());
+    boxes.reserve(entities.size());
+    
+    m_boundsCache.clear();
+    m_lodTable.clear();
+    for (Entity* entity : entities) {
+        if (MeshComponent* meshComp = entity->getComponent<MeshComponent>()) {
+            m_boundsCache.setLocalBounds(entity->getId(), meshComp->boundingBox);
+            m_lodTable.set(entity->getId(), meshComp->drawDistance, meshComp->lodParent);
+        }
+    }
+    m_boundsCache.refreshAll(m_transformHierarchy);
+    
+    QVector<float> drawDistances;
+    drawDistances.reserve(entities.size());
+    m_worldGrid.clear();
+    for (Entity* entity : entities) {
+        ids.append(entity->getId());
+        boxes.append(computeEntityBounds(entity));
+        drawDistances.append(m_lodTable.getDrawDistance(entity->getId()));
+        m_worldGrid.set(entity->getId(), getWorldPosition(entity->getId()), estimateEntityMemory(entity));
+    }
+    
+    m_spatialIndex.build(ids, boxes, drawDistances);
+    m_spatialDirty.clear();
+    m_spatialSyncedFrame = m_changeTracker.getCurrentFrame();
+}
+
+BoundingBox SceneManager::computeEntityBounds(Entity* entity) const {
+    QVector3D position = getWorldPosition(entity->getId());
+    BoundingBox bounds(position, position);
+    
+    const BoundingBox* meshBounds = m_boundsCache.find(entity->getId());
+    if (meshBounds) {
+        bounds.min = QVector3D(qMin(bounds.min.x(), meshBounds->min.x()), qMin(bounds.min.y(), meshBounds->min.y()), qMin(bounds.min.z(), meshBounds->min.z()));
+        bounds.max = QVector3D(qMax(bounds.max.x(), meshBounds->max.x()), qMax(bounds.max.y(), meshBounds->max.y()), qMax(bounds.max.z(), meshBounds->max.z()));
+    }
+    return bounds;
+}
+
+qint64 SceneManager::estimateEntityMemory(Entity* entity) const {
+    // Editor-side footprint: the entity, its components and their strings
+    qint64 bytes = sizeof(Entity) + entity->getName().size() * sizeof(QChar);
+    for (int componentId = 0; componentId < Components::Count; ++componentId) {
+        if (entity->getComponent(Components::typeOf(componentId))) {
+            bytes += Components::sizeOf(componentId);
+        }
+    }
+    if (MeshComponent* meshComp = entity->getComponent<MeshComponent>()) {
+        bytes += (meshComp->meshPath.size() + meshComp->materialPath.size()) * sizeof(QChar);
+    }
+    if (ScriptComponent* scriptComp = entity->getComponent<ScriptComponent>()) {
+        bytes += scriptComp->scriptPath.size() * sizeof(QChar);
+    }
+    return bytes;
+}
+
+QVector3D SceneManager::getWorldPosition(EntityId id) const {
+    return m_transformHierarchy.getWorldMatrix(id).column(3).toVector3D();
+}
+
+const TriangleBVH* SceneManager::getModelTriangles(EntityId id) const {
+    if (m_modelLibrary.size() == 0) {
+        return nullptr;
+    }
+    Entity* entity = getEntity(id);
+    MeshComponent* meshComp = entity ? entity->getComponent<MeshComponent>() : nullptr;
+    return meshComp ? m_modelLibrary.getTriangleBVH(meshComp->meshPath) : nullptr;
+}
+
+void SceneManager::onEntityComponentChanged(EntityId id, ComponentType type) {
+    m_changeTracker.recordChange(id, type);
+    
+    if (type == ComponentType::Transform) {
+        Entity* entity = getEntity(id);
+        if (entity && entity->getTransform()) {
+            releaseSnapshots();
+            m_transformHierarchy.setLocalTransform(id, *entity->getTransform());
+        }
+    }
+    
+    emit sceneChanged();
+}
+
+#include "moc_scene_manager.cpp"
 
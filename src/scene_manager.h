@@ -3,9 +3,24 @@
 
 #include "types.h"
 #include "entity_system.h"
+#include "transform_hierarchy.h"
+#include "change_tracker.h"
+#include "system_scheduler.h"
+#include "entity_query.h"
+#include "selection_set.h"
+#include "layer_table.h"
+#include "lod_table.h"
+#include "model_library.h"
+#include "texture_library.h"
+#include "dat_parser.h"
+#include "dynamic_bvh.h"
+#include "world_grid.h"
+#include "bounds_cache.h"
 #include <QObject>
 #include <QVector>
 #include <QMap>
+#include <QSet>
+#include <functional>
 
 // Scene manager handles the 3D world and all entities within it
 class SceneManager : public QObject {
@@ -26,25 +41,127 @@ public:
     Entity* getEntity(EntityId id) const;
     QVector<Entity*> getAllEntities() const;
     
-    // Selection management
+    // Indexed search; cost scales with the most selective predicate's matches
+    QVector<EntityId> findEntities(const EntityQuery& query) const;
+    
+    // Transform hierarchy
+    bool setEntityParent(EntityId id, EntityId parentId);
+    EntityId getEntityParent(EntityId id) const;
+    QVector<EntityId> getEntityChildren(EntityId id) const;
+    QMatrix4x4 getWorldMatrix(EntityId id) const;
+    void updateTransforms();
+    
+    // Per-frame systems. Transforms are updated by the built-in "Transforms"
+    // system; other systems register here and run after it as access allows.
+    SystemScheduler& getSystemScheduler();
+    void runSystems();
+    
+    // Change tracking. The viewport advances the frame once per paint;
+    // consumers pull deltas from the tracker instead of rescanning.
+    const ChangeTracker& getChangeTracker() const;
+    quint64 getCurrentFrame() const;
+    void advanceFrame();
+    
+    // Selection management. Every change emits selectionChanged() with only
+    // the ids that were added and removed.
     void selectEntity(EntityId id);
     void deselectEntity(EntityId id);
     void clearSelection();
-    void selectMultiple(const QVector<EntityId>& ids);
-    QVector<EntityId> getSelectedEntities() const;
+    void selectMultiple(const QVector<EntityId>& ids); // Replaces the selection
+    void addToSelection(const QVector<EntityId>& ids);
+    void removeFromSelection(const QVector<EntityId>& ids);
+    bool isSelected(EntityId id) const;
+    int getSelectionCount() const;
+    const QVector<EntityId>& getSelectedEntities() const;
     Entity* getPrimarySelection() const;
     
-    // Spatial queries
+    // Spatial queries, answered from a BVH over entity world bounds (the
+    // mesh bounds, if any, grown to include the entity's origin)
     QVector<Entity*> getEntitiesInRadius(const QVector3D& center, float radius) const;
     QVector<Entity*> getEntitiesInBox(const BoundingBox& box) const;
     Entity* raycast(const QVector3D& origin, const QVector3D& direction, float maxDistance = 1000.0f) const;
     
-    // Layer management
+    struct RaycastHit {
+        EntityId entity = 0;
+        float distance = 0.0f;
+        QVector3D position;
+        QVector3D normal; // World space, unit length, facing the ray
+    };
+    
+    // Closest hit. Entities whose model is in the model library are tested
+    // against its triangles, others against their world bounds. Entities in
+    // ignore, if given, are skipped.
+    bool raycast(const QVector3D& origin, const QVector3D& direction, RaycastHit& hit,
+                 float maxDistance = 1000.0f, const QSet<EntityId>* ignore = nullptr) const;
+    
+    // Placement. snapToSurface() moves position straight down (-WorldUp)
+    // onto the first surface below it. dropToGround() lowers each entity
+    // until the bottom of its bounds rests on whatever is below its center,
+    // ignoring the other entities in the batch; returns how many were moved.
+    bool snapToSurface(QVector3D& position, QVector3D* normal = nullptr, float maxDistance = 1000.0f) const;
+    int dropToGround(const QVector<EntityId>& ids, float maxDistance = 1000.0f);
+    
+    // Per-frame visibility: appends entities whose (fattened) bounds touch
+    // the frustum, in no particular order, and returns the BVH nodes visited
+    int getEntitiesInFrustum(const Frustum& frustum, QVector<EntityId>& out) const;
+    
+    // Marquee query: pickable entities (as for raycast()) whose world bounds
+    // touch the frustum, or lie entirely inside it when fullyInside is set.
+    // Entities without a mesh are tested by their origin.
+    QVector<EntityId> pickEntitiesInFrustum(const Frustum& frustum, bool fullyInside) const;
+    
+    // As above, but also applies draw distances from eye: entities beyond
+    // their scaled draw distance are dropped, and HD instances hand over to
+    // their LOD parent (see LodTable)
+    int getEntitiesInView(const Frustum& frustum, const QVector3D& eye, QVector<EntityId>& out) const;
+    
+    // What getEntitiesInView() and the renderer's per-entity tests read,
+    // synced and copied. The tables are implicitly shared, so taking a
+    // snapshot costs a few reference counts. A snapshot can be read on a
+    // worker thread; the scene calls the snapshot fence before it writes
+    // any of these tables, so the reader is done with it by then and the
+    // write does not detach a copy of the whole table.
+    struct ViewSnapshot {
+        DynamicBVH spatialIndex;
+        TransformHierarchy transforms;
+        BoundsCache bounds;
+        LodTable lods;
+        LayerTable layers;
+        QVector<IPLOcclusionZone> occluders;
+        float drawDistanceMultiplier = 1.0f;
+        quint64 frame = 0; // Change tracker frame it was taken in
+        
+        int getEntitiesInView(const Frustum& frustum, const QVector3D& eye, QVector<EntityId>& out) const;
+    };
+    ViewSnapshot snapshotView() const;
+    
+    // Called on the GUI thread before the scene writes a table that a
+    // snapshot shares; waits for the (one) reader to release its snapshot
+    void setSnapshotFence(std::function<void()> fence);
+    
+    // World AABB of the entity's mesh bounds; false if it has no mesh
+    bool getWorldBounds(EntityId id, BoundingBox& bounds) const;
+    
+    // The whole bounds cache, synced once; for per-frame loops that would
+    // otherwise call getWorldBounds() per entity
+    const BoundsCache& getBoundsCache() const;
+    
+    // Streaming grid: entities bucketed into XY cells by world position,
+    // with per-cell counts and memory estimates. Pending moves are applied
+    // before the grid is returned.
+    const WorldGrid& getWorldGrid() const;
+    void setWorldCellSize(float size);
+    QVector<EntityId> getEntitiesInCells(const GridCell& min, const GridCell& max) const;
+    
+    // Layer management. Names are mapped to small ids; the renderer and
+    // picking test getLayerTable() masks directly.
     void createLayer(const QString& name);
     void deleteLayer(const QString& name);
     void setEntityLayer(EntityId id, const QString& layer);
+    void setEntitiesLayer(const QVector<EntityId>& ids, const QString& layer);
     QString getEntityLayer(EntityId id) const;
     QStringList getAllLayers() const;
+    const LayerTable& getLayerTable() const;
     void setLayerVisible(const QString& layer, bool visible);
     bool isLayerVisible(const QString& layer) const;
     void setLayerLocked(const QString& layer, bool locked);
@@ -71,16 +188,47 @@ public:
     void setShowBoundingBoxes(bool enabled);
     bool isShowBoundingBoxes() const;
     
+    // Draw distance and LOD. Per-definition distances are scaled by the
+    // multiplier; the table is synced from MeshComponents before returning.
+    void setDrawDistanceMultiplier(float multiplier);
+    float getDrawDistanceMultiplier() const;
+    const LodTable& getLodTable() const;
+    
     // Asset loading
     bool loadGTAMap(const QString& iplPath, const QString& idePath);
     bool loadDFFModel(const QString& dffPath, const QString& txdPath = "");
     
+    // Model geometry for exact picking and placement. Registering a model
+    // gives entities that use it (by meshPath) and have no mesh bounds yet
+    // the model's bounds.
+    void registerModel(const QString& name, const GTAModel& model);
+    const ModelLibrary& getModelLibrary() const;
+    
+    // Decoded TXDs, by the name MeshComponent::materialPath uses. Loading
+    // a file registers it under its base name.
+    bool loadTextureDictionary(const QString& txdPath);
+    void registerTextureDictionary(const QString& name, const QVector<TXDParser::GTATexture>& textures);
+    const TextureLibrary& getTextureLibrary() const;
+    
     // Mission data
     void addTriggerZone(const TriggerZone& zone);
     void removeTriggerZone(const QString& name);
     QVector<TriggerZone> getTriggerZones() const;
     TriggerZone* getTriggerZone(const QString& name);
     
+    // IPL OCCL occluder boxes, used by the viewport's occlusion culler
+    void addOcclusionZones(const QVector<IPLOcclusionZone>& zones);
+    void clearOcclusionZones();
+    const QVector<IPLOcclusionZone>& getOcclusionZones() const;
+    
+    // Path nodes from path DAT files, drawn by the viewport. Loading a file
+    // adds its nodes; the revision changes whenever the set does.
+    bool loadPathFile(const QString& datPath);
+    void addPathNodes(const QVector<DATParser::PathNode>& nodes);
+    void clearPathNodes();
+    const QVector<DATParser::PathNode>& getPathNodes() const;
+    quint64 getPathRevision() const;
+    
     void addMissionObjective(const MissionObjective& objective);
     void removeMissionObjective(const QString& id);
     QVector<MissionObjective> getMissionObjectives() const;
@@ -93,7 +241,8 @@ public:
 signals:
     void entityCreated(Entity* entity);
     void entityDestroyed(EntityId id);
-    void selectionChanged(const QVector<EntityId>& selectedIds);
+    void entityParentChanged(EntityId id, EntityId parentId);
+    void selectionChanged(const QVector<EntityId>& added, const QVector<EntityId>& removed);
     void layerCreated(const QString& name);
     void layerDeleted(const QString& name);
     void layerVisibilityChanged(const QString& name, bool visible);
@@ -101,41 +250,101 @@ signals:
     void sceneChanged();
     void cameraChanged();
     
+private slots:
+    void onEntityComponentChanged(EntityId id, ComponentType type);
+    
 private:
-    SceneManager() = default;
+    SceneManager();
     Q_DISABLE_COPY(SceneManager)
     
     void connectEntitySignals(Entity* entity);
     void disconnectEntitySignals(Entity* entity);
+    void rebuildTransformHierarchy();
+    void refreshTransforms(JobSystem* jobs) const;
+    void recordMovedTransforms() const; // GUI thread only
+    void releaseSnapshots() const;
+    
+    // Spatial index maintenance. A sync is collect (GUI thread), then the
+    // bounds cache refresh, then apply (GUI thread); the Bounds system runs
+    // the same steps once per frame.
+    void syncSpatialIndex() const;
+    bool collectSpatialChanges(QVector<EntityId>& dirty) const;
+    void applySpatialChanges(const QVector<EntityId>& dirty) const;
+    void rebuildSpatialIndex() const;
+    BoundingBox computeEntityBounds(Entity* entity) const;
+    QVector3D getWorldPosition(EntityId id) const;
+    const TriangleBVH* getModelTriangles(EntityId id) const;
+    qint64 estimateEntityMemory(Entity* entity) const;
+    static int queryView(const DynamicBVH& spatialIndex, const TransformHierarchy& transforms,
+                         const LodTable& lods, float multiplier, const Frustum& frustum,
+                         const QVector3D& eye, QVector<EntityId>& out);
+    
+    // See setSnapshotFence()
+    std::function<void()> m_snapshotFence;
+    
+    // Cached local/world matrices, refreshed lazily from const queries
+    mutable TransformHierarchy m_transformHierarchy;
+    
+    // Per-component change journal; lazy transform refreshes record moves
+    mutable ChangeTracker m_changeTracker;
+    static const int ChangeHistoryFrames = 600;
+    
+    // Per-frame entity work: Transforms, then Bounds. They conflict, so
+    // each has a stage to itself; concurrent stages only form once systems
+    // with disjoint masks are registered.
+    SystemScheduler m_systemScheduler;
+    
+    // Secondary indexes for findEntities(), synced lazily from the tracker
+    mutable EntityIndex m_entityIndex;
+    
+    // World bounds BVH. Entities whose world matrix was recomputed are
+    // queued in m_spatialDirty; mesh and structural changes come from the
+    // change tracker. Both are applied before each spatial query.
+    mutable DynamicBVH m_spatialIndex;
+    mutable QSet<EntityId> m_spatialDirty;
+    mutable quint64 m_spatialSyncedFrame = 0;
+    
+    // Streaming cells, maintained alongside the BVH from the same updates
+    mutable WorldGrid m_worldGrid;
+    
+    // World mesh bounds, recomputed in batches for the same dirty entities
+    mutable BoundsCache m_boundsCache;
+    
+    // Draw distances and LOD links from MeshComponents, synced with the BVH
+    mutable LodTable m_lodTable;
+    
+    // Parsed models and their lazily built triangle BVHs
+    ModelLibrary m_modelLibrary;
+    
+    // Decoded texture dictionaries, uploaded by the viewport on first use
+    TextureLibrary m_textureLibrary;
     
     // Selection state
-    QVector<EntityId> m_selectedEntities;
+    SelectionSet m_selection;
     
     // Layer management
-    struct LayerInfo {
-        bool visible = true;
-        bool locked = false;
-        QVector<EntityId> entities;
-    };
-    QMap<QString, LayerInfo> m_layers;
-    QMap<EntityId, QString> m_entityLayers;
+    LayerTable m_layerTable;
     
     // Grid and snapping
     float m_gridSize = 1.0f;
     bool m_snapToGrid = false;
     
     // Camera state
-    QVector3D m_cameraPosition{0, 0, 10};
+    QVector3D m_cameraPosition{0, -10, 0};
     QVector3D m_cameraTarget{0, 0, 0};
-    QVector3D m_cameraUp{0, 1, 0};
+    QVector3D m_cameraUp = WorldUp;
     
     // Rendering settings
     bool m_wireframeMode = false;
     bool m_showGrid = true;
     bool m_showBoundingBoxes = false;
+    float m_drawDistanceMultiplier = 1.0f;
     
     // Mission data
     QVector<TriggerZone> m_triggerZones;
+    QVector<IPLOcclusionZone> m_occlusionZones;
+    QVector<DATParser::PathNode> m_pathNodes;
+    quint64 m_pathRevision = 0;
     QVector<MissionObjective> m_missionObjectives;
     
     // Scene metadata
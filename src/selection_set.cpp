@@ -0,0 +1,64 @@
+#include "selection_set.h"
+
+bool SelectionSet::contains(EntityId id) const {
+    int word = int(id >> 6);
+    return word < m_bits.size() && (m_bits[word] & (quint64(1) << (id & 63))) != 0;
+}
+
+bool SelectionSet::insert(EntityId id) {
+    if (contains(id)) {
+        return false;
+    }
+
+    int word = int(id >> 6);
+    if (word >= m_bits.size()) {
+        m_bits.resize(word + 1);
+    }
+    m_bits[word] |= quint64(1) << (id & 63);
+    m_positions.insert(id, m_ids.size());
+    m_ids.append(id);
+    return true;
+}
+
+bool SelectionSet::remove(EntityId id) {
+    if (!contains(id)) {
+        return false;
+    }
+
+    m_bits[int(id >> 6)] &= ~(quint64(1) << (id & 63));
+
+    // Swap-remove to keep the list packed
+    int position = m_positions.take(id);
+    EntityId last = m_ids.last();
+    if (last != id) {
+        m_ids[position] = last;
+        m_positions[last] = position;
+    }
+    m_ids.removeLast();
+    return true;
+}
+
+void SelectionSet::clear() {
+    // Only the words that hold set bits need clearing
+    for (EntityId id : m_ids) {
+        m_bits[int(id >> 6)] = 0;
+    }
+    m_ids.clear();
+    m_positions.clear();
+}
+
+int SelectionSet::size() const {
+    return m_ids.size();
+}
+
+bool SelectionSet::isEmpty() const {
+    return m_ids.isEmpty();
+}
+
+const QVector<EntityId>& SelectionSet::getIds() const {
+    return m_ids;
+}
+
+EntityId SelectionSet::getFirst() const {
+    return m_ids.isEmpty() ? 0 : m_ids.first();
+}
@@ -0,0 +1,32 @@
+#ifndef SELECTION_SET_H
+#define SELECTION_SET_H
+
+#include "types.h"
+#include <QHash>
+#include <QVector>
+
+// Set of selected entities. Membership is one bit per EntityId, so lookups
+// never touch the id list; the ids themselves are kept in a packed list for
+// iteration, with each id's position so removal is a swap with the last
+// element. Insert, remove and contains are all O(1).
+class SelectionSet {
+public:
+    bool contains(EntityId id) const;
+    bool insert(EntityId id); // False if already selected
+    bool remove(EntityId id); // False if not selected
+    void clear();
+
+    int size() const;
+    bool isEmpty() const;
+
+    // Packed ids; order is insertion order until something is removed
+    const QVector<EntityId>& getIds() const;
+    EntityId getFirst() const; // 0 if empty
+
+private:
+    QVector<quint64> m_bits;
+    QVector<EntityId> m_ids;
+    QHash<EntityId, int> m_positions;
+};
+
+#endif // SELECTION_SET_H
@@ -0,0 +1,134 @@
+#include "bounds_cache.h"
+#include "transform_hierarchy.h"
+#include "math_utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BOUNDS_CACHE_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+void BoundsCache::setLocalBounds(EntityId id, const BoundingBox& local) {
+    auto it = m_slots.find(id);
+    if (it != m_slots.end()) {
+        m_localBounds[it.value()] = local;
+        return;
+    }
+
+    m_slots.insert(id, m_ids.size());
+    m_ids.append(id);
+    m_localBounds.append(local);
+    m_worldBounds.append(local);
+}
+
+void BoundsCache::remove(EntityId id) {
+    auto it = m_slots.find(id);
+    if (it == m_slots.end()) {
+        return;
+    }
+
+    // Swap-remove to keep the arrays dense
+    int slot = it.value();
+    int last = m_ids.size() - 1;
+    if (slot != last) {
+        m_ids[slot] = m_ids[last];
+        m_localBounds[slot] = m_localBounds[last];
+        m_worldBounds[slot] = m_worldBounds[last];
+        m_slots[m_ids[slot]] = slot;
+    }
+    m_ids.removeLast();
+    m_localBounds.removeLast();
+    m_worldBounds.removeLast();
+    m_slots.remove(id);
+}
+
+void BoundsCache::clear() {
+    m_slots.clear();
+    m_ids.clear();
+    m_localBounds.clear();
+    m_worldBounds.clear();
+}
+
+bool BoundsCache::contains(EntityId id) const {
+    return m_slots.contains(id);
+}
+
+int BoundsCache::size() const {
+    return m_ids.size();
+}
+
+void BoundsCache::refresh(const QVector<EntityId>& ids, const TransformHierarchy& hierarchy) {
+    m_batchMatrices.clear();
+    m_batchLocal.clear();
+    m_batchWorld.clear();
+
+    BoundingBox* world = m_worldBounds.data();
+    for (EntityId id : ids) {
+        auto it = m_slots.find(id);
+        if (it != m_slots.end()) {
+            m_batchMatrices.append(&hierarchy.getWorldMatrix(id));
+            m_batchLocal.append(&m_localBounds.at(it.value()));
+            m_batchWorld.append(world + it.value());
+        }
+    }
+
+    transformBatch(m_batchMatrices.constData(), m_batchLocal.constData(), m_batchWorld.constData(), m_batchMatrices.size());
+}
+
+void BoundsCache::refreshAll(const TransformHierarchy& hierarchy) {
+    refresh(m_ids, hierarchy);
+}
+
+const BoundingBox* BoundsCache::find(EntityId id) const {
+    auto it = m_slots.find(id);
+    return it != m_slots.end() ? &m_worldBounds.at(it.value()) : nullptr;
+}
+
+void BoundsCache::transformBatch(const QMatrix4x4* const* matrices, const BoundingBox* const* local,
+                                 BoundingBox* const* world, int count) {
+#ifdef BOUNDS_CACHE_USE_SSE
+    // QMatrix4x4 is column-major, so each column loads as one register:
+    // center' = c0 * cx + c1 * cy + c2 * cz + c3, extent' = |c0| * hx + ...
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 half = _mm_set1_ps(0.5f);
+    alignas(16) float minOut[4];
+    alignas(16) float maxOut[4];
+
+    for (int i = 0; i < count; ++i) {
+        const float* m = matrices[i]->constData();
+        const __m128 c0 = _mm_loadu_ps(m);
+        const __m128 c1 = _mm_loadu_ps(m + 4);
+        const __m128 c2 = _mm_loadu_ps(m + 8);
+        const __m128 c3 = _mm_loadu_ps(m + 12);
+
+        const BoundingBox& box = *local[i];
+        const __m128 boxMin = _mm_set_ps(0.0f, box.min.z(), box.min.y(), box.min.x());
+        const __m128 boxMax = _mm_set_ps(0.0f, box.max.z(), box.max.y(), box.max.x());
+        const __m128 center = _mm_mul_ps(_mm_add_ps(boxMin, boxMax), half);
+        const __m128 extent = _mm_mul_ps(_mm_sub_ps(boxMax, boxMin), half);
+
+        const __m128 cx = _mm_shuffle_ps(center, center, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m128 cy = _mm_shuffle_ps(center, center, _MM_SHUFFLE(1, 1, 1, 1));
+        const __m128 cz = _mm_shuffle_ps(center, center, _MM_SHUFFLE(2, 2, 2, 2));
+        const __m128 hx = _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m128 hy = _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(1, 1, 1, 1));
+        const __m128 hz = _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(2, 2, 2, 2));
+
+        __m128 worldCenter = _mm_add_ps(c3, _mm_mul_ps(c0, cx));
+        worldCenter = _mm_add_ps(worldCenter, _mm_mul_ps(c1, cy));
+        worldCenter = _mm_add_ps(worldCenter, _mm_mul_ps(c2, cz));
+
+        __m128 worldExtent = _mm_mul_ps(_mm_and_ps(c0, absMask), hx);
+        worldExtent = _mm_add_ps(worldExtent, _mm_mul_ps(_mm_and_ps(c1, absMask), hy));
+        worldExtent = _mm_add_ps(worldExtent, _mm_mul_ps(_mm_and_ps(c2, absMask), hz));
+
+        _mm_store_ps(minOut, _mm_sub_ps(worldCenter, worldExtent));
+        _mm_store_ps(maxOut, _mm_add_ps(worldCenter, worldExtent));
+        world[i]->min = QVector3D(minOut[0], minOut[1], minOut[2]);
+        world[i]->max = QVector3D(maxOut[0], maxOut[1], maxOut[2]);
+    }
+#else
+    for (int i = 0; i < count; ++i) {
+        *world[i] = MathUtils::transformBox(*matrices[i], *local[i]);
+    }
+#endif
+}
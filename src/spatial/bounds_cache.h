@@ -0,0 +1,56 @@
+#ifndef BOUNDS_CACHE_H
+#define BOUNDS_CACHE_H
+
+#include "types.h"
+#include <QHash>
+#include <QMatrix4x4>
+#include <QVector>
+
+class TransformHierarchy;
+
+// World-space AABBs of entity mesh bounds, stored in one contiguous array.
+// Local boxes are registered per entity; refresh() recomputes the world
+// boxes of a batch of entities from their cached world matrices in a single
+// pass, using SSE where available. Boxes are only recomputed for entities
+// passed to refresh(), so callers feed it the transforms that changed.
+class BoundsCache {
+public:
+    // Local bounds; the world box is stale until the next refresh()
+    void setLocalBounds(EntityId id, const BoundingBox& local);
+    void remove(EntityId id);
+    void clear();
+
+    bool contains(EntityId id) const;
+    int size() const;
+
+    // Recompute world boxes for the given ids; unknown ids are skipped
+    void refresh(const QVector<EntityId>& ids, const TransformHierarchy& hierarchy);
+    void refreshAll(const TransformHierarchy& hierarchy);
+
+    // Cached world box, or nullptr if the entity has no bounds
+    const BoundingBox* find(EntityId id) const;
+
+    // Dense storage, parallel arrays
+    const QVector<EntityId>& getIds() const { return m_ids; }
+    const QVector<BoundingBox>& getWorldBounds() const { return m_worldBounds; }
+
+    // Arvo's method over a batch: world[i] = bounds of local[i] under
+    // matrices[i]. Exposed for callers with their own storage.
+    static void transformBatch(const QMatrix4x4* const* matrices, const BoundingBox* const* local,
+                               BoundingBox* const* world, int count);
+
+private:
+    void refreshSlots();
+
+    QHash<EntityId, int> m_slots;
+    QVector<EntityId> m_ids;
+    QVector<BoundingBox> m_localBounds;
+    QVector<BoundingBox> m_worldBounds;
+
+    // Gather buffers for refresh(), reused between calls
+    QVector<const QMatrix4x4*> m_batchMatrices;
+    QVector<const BoundingBox*> m_batchLocal;
+    QVector<BoundingBox*> m_batchWorld;
+};
+
+#endif // BOUNDS_CACHE_H
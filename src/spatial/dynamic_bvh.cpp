@@ -0,0 +1,655 @@
+#include "dynamic_bvh.h"
+#include <QVarLengthArray>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+const int kSahBins = 12;
+
+bool containsBox(const BoundingBox& outer, const BoundingBox& inner) {
+    return outer.min.x() <= inner.min.x() && outer.min.y() <= inner.min.y() && outer.min.z() <= inner.min.z()
+        && outer.max.x() >= inner.max.x() && outer.max.y() >= inner.max.y() && outer.max.z() >= inner.max.z();
+}
+
+// Leaves are reinserted once their fat box has grown this much larger than
+// needed, so the tree tightens again after large moves
+const float kShrinkRatio = 4.0f;
+}
+
+DynamicBVH::DynamicBVH() {
+}
+
+void DynamicBVH::build(const QVector<EntityId>& ids, const QVector<BoundingBox>& boxes,
+                       const QVector<float>& drawDistances) {
+    clear();
+
+    const int count = qMin(ids.size(), boxes.size());
+    if (count == 0) {
+        return;
+    }
+
+    QVector<BoundingBox> fatBoxes(count);
+    QVector<QVector3D> centroids(count);
+    for (int i = 0; i < count; ++i) {
+        fatBoxes[i] = fatten(boxes[i]);
+        centroids[i] = boxes[i].center();
+    }
+
+    QVector<int> items(count);
+    std::iota(items.begin(), items.end(), 0);
+    m_nodes.reserve(2 * count - 1);
+    m_leaves.reserve(count);
+
+    // Top-down binned SAH build with an explicit task stack; parents are
+    // always allocated before their children
+    struct Task {
+        int begin;
+        int end;
+        int parent;
+        bool isLeft;
+    };
+    QVector<Task> tasks;
+    tasks.append(Task{0, count, -1, false});
+
+    while (!tasks.isEmpty()) {
+        Task task = tasks.takeLast();
+
+        int node = allocateNode();
+        m_nodes[node].parent = task.parent;
+        if (task.parent < 0) {
+            m_root = node;
+        } else if (task.isLeft) {
+            m_nodes[task.parent].left = node;
+        } else {
+            m_nodes[task.parent].right = node;
+        }
+
+        int itemCount = task.end - task.begin;
+        if (itemCount == 1) {
+            int item = items[task.begin];
+            m_nodes[node].box = fatBoxes[item];
+            m_nodes[node].id = ids[item];
+            if (item < drawDistances.size() && drawDistances[item] > 0.0f) {
+                m_nodes[node].drawDistance = drawDistances[item];
+            }
+            m_leaves.insert(ids[item], node);
+            continue;
+        }
+
+        // Split along the axis with the widest centroid spread
+        QVector3D centroidMin = centroids[items[task.begin]];
+        QVector3D centroidMax = centroidMin;
+        for (int i = task.begin + 1; i < task.end; ++i) {
+            const QVector3D& c = centroids[items[i]];
+            centroidMin = QVector3D(qMin(centroidMin.x(), c.x()), qMin(centroidMin.y(), c.y()), qMin(centroidMin.z(), c.z()));
+            centroidMax = QVector3D(qMax(centroidMax.x(), c.x()), qMax(centroidMax.y(), c.y()), qMax(centroidMax.z(), c.z()));
+        }
+        QVector3D spread = centroidMax - centroidMin;
+        int axis = 0;
+        if (spread.y() > spread[axis]) axis = 1;
+        if (spread.z() > spread[axis]) axis = 2;
+
+        int middle = task.begin;
+        if (spread[axis] > 1e-6f) {
+            float scale = kSahBins / spread[axis];
+            auto binOf = [&](int item) {
+                return qMin(kSahBins - 1, static_cast<int>((centroids[item][axis] - centroidMin[axis]) * scale));
+            };
+
+            int binCounts[kSahBins] = {};
+            BoundingBox binBoxes[kSahBins];
+            for (int i = task.begin; i < task.end; ++i) {
+                int item = items[i];
+                int bin = binOf(item);
+                binBoxes[bin] = binCounts[bin] ? merge(binBoxes[bin], fatBoxes[item]) : fatBoxes[item];
+                ++binCounts[bin];
+            }
+
+            // Sweep from the right to get the cost of everything after each split
+            float rightAreas[kSahBins] = {};
+            int rightCounts[kSahBins] = {};
+            BoundingBox accumulated;
+            int accumulatedCount = 0;
+            for (int bin = kSahBins - 1; bin > 0; --bin) {
+                if (binCounts[bin]) {
+                    accumulated = accumulatedCount ? merge(accumulated, binBoxes[bin]) : binBoxes[bin];
+                    accumulatedCount += binCounts[bin];
+                }
+                rightAreas[bin - 1] = accumulatedCount ? area(accumulated) : 0.0f;
+                rightCounts[bin - 1] = accumulatedCount;
+            }
+
+            float bestCost = std::numeric_limits<float>::max();
+            int bestSplit = -1;
+            accumulatedCount = 0;
+            for (int bin = 0; bin < kSahBins - 1; ++bin) {
+                if (binCounts[bin]) {
+                    accumulated = accumulatedCount ? merge(accumulated, binBoxes[bin]) : binBoxes[bin];
+                    accumulatedCount += binCounts[bin];
+                }
+                if (accumulatedCount == 0 || rightCounts[bin] == 0) {
+                    continue;
+                }
+                float cost = area(accumulated) * accumulatedCount + rightAreas[bin] * rightCounts[bin];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestSplit = bin;
+                }
+            }
+
+            if (bestSplit >= 0) {
+                auto split = std::partition(items.begin() + task.begin, items.begin() + task.end,
+                    [&](int item) { return binOf(item) <= bestSplit; });
+                middle = static_cast<int>(split - items.begin());
+            }
+        }
+
+        // Coincident centroids or a degenerate split: fall back to the median
+        if (middle <= task.begin || middle >= task.end) {
+            middle = task.begin + itemCount / 2;
+            std::nth_element(items.begin() + task.begin, items.begin() + middle, items.begin() + task.end,
+                [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+        }
+
+        tasks.append(Task{middle, task.end, node, false});
+        tasks.append(Task{task.begin, middle, node, true});
+    }
+
+    // Children always have higher indices than their parent
+    for (int i = m_nodes.size() - 1; i >= 0; --i) {
+        if (!m_nodes[i].isLeaf()) {
+            refitNode(i);
+        }
+    }
+}
+
+void DynamicBVH::insert(EntityId id, const BoundingBox& box) {
+    if (m_leaves.contains(id)) {
+        update(id, box);
+        return;
+    }
+
+    int leaf = allocateNode();
+    m_nodes[leaf].box = fatten(box);
+    m_nodes[leaf].id = id;
+    m_leaves.insert(id, leaf);
+    insertLeaf(leaf);
+}
+
+bool DynamicBVH::update(EntityId id, const BoundingBox& box) {
+    auto it = m_leaves.find(id);
+    if (it == m_leaves.end()) {
+        insert(id, box);
+        return true;
+    }
+
+    int leaf = it.value();
+    BoundingBox fat = fatten(box);
+    if (containsBox(m_nodes[leaf].box, box) && area(m_nodes[leaf].box) <= kShrinkRatio * area(fat)) {
+        return false;
+    }
+
+    removeLeaf(leaf);
+    m_nodes[leaf].box = fat;
+    insertLeaf(leaf);
+    return true;
+}
+
+void DynamicBVH::remove(EntityId id) {
+    auto it = m_leaves.find(id);
+    if (it == m_leaves.end()) {
+        return;
+    }
+
+    int leaf = it.value();
+    m_leaves.erase(it);
+    removeLeaf(leaf);
+    freeNode(leaf);
+}
+
+void DynamicBVH::clear() {
+    m_nodes.clear();
+    m_root = -1;
+    m_freeList = -1;
+    m_nodeCount = 0;
+    m_leaves.clear();
+}
+
+bool DynamicBVH::contains(EntityId id) const {
+    return m_leaves.contains(id);
+}
+
+int DynamicBVH::size() const {
+    return m_leaves.size();
+}
+
+void DynamicBVH::setDrawDistance(EntityId id, float distance) {
+    auto it = m_leaves.constFind(id);
+    if (it == m_leaves.constEnd()) {
+        return;
+    }
+
+    int index = it.value();
+    m_nodes[index].drawDistance = distance > 0.0f ? distance : std::numeric_limits<float>::infinity();
+
+    // Propagate until an ancestor's maximum no longer changes
+    for (index = m_nodes[index].parent; index >= 0; index = m_nodes[index].parent) {
+        Node& node = m_nodes[index];
+        float maximum = qMax(m_nodes[node.left].drawDistance, m_nodes[node.right].drawDistance);
+        if (maximum == node.drawDistance) {
+            break;
+        }
+        node.drawDistance = maximum;
+    }
+}
+
+void DynamicBVH::setMargin(float absolute, float relative) {
+    m_marginAbsolute = qMax(0.0f, absolute);
+    m_marginRelative = qMax(0.0f, relative);
+}
+
+void DynamicBVH::queryBox(const BoundingBox& box, QVector<EntityId>& out) const {
+    if (m_root < 0) {
+        return;
+    }
+
+    QVarLengthArray<int, 64> stack;
+    stack.append(m_root);
+    while (!stack.isEmpty()) {
+        const Node& node = m_nodes[stack.takeLast()];
+        if (!overlaps(node.box, box)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            out.append(node.id);
+        } else {
+            stack.append(node.left);
+            stack.append(node.right);
+        }
+    }
+}
+
+void DynamicBVH::querySphere(const QVector3D& center, float radius, QVector<EntityId>& out) const {
+    if (m_root < 0) {
+        return;
+    }
+
+    float radiusSquared = radius * radius;
+    QVarLengthArray<int, 64> stack;
+    stack.append(m_root);
+    while (!stack.isEmpty()) {
+        const Node& node = m_nodes[stack.takeLast()];
+
+        // Squared distance from the center to the box
+        float distanceSquared = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            float v = center[axis];
+            if (v < node.box.min[axis]) {
+                distanceSquared += (node.box.min[axis] - v) * (node.box.min[axis] - v);
+            } else if (v > node.box.max[axis]) {
+                distanceSquared += (v - node.box.max[axis]) * (v - node.box.max[axis]);
+            }
+        }
+        if (distanceSquared > radiusSquared) {
+            continue;
+        }
+
+        if (node.isLeaf()) {
+            out.append(node.id);
+        } else {
+            stack.append(node.left);
+            stack.append(node.right);
+        }
+    }
+}
+
+int DynamicBVH::queryFrustum(const Frustum& frustum, QVector<EntityId>& out,
+                             const QVector3D& eye, float distanceScale) const {
+    if (m_root < 0) {
+        return 0;
+    }
+
+    struct Entry {
+        int index;
+        quint8 mask; // Planes still straddled by the parent
+    };
+
+    int visited = 0;
+    quint8 lastRejected = 0; // Plane tried first; see the header
+    QVarLengthArray<Entry, 64> stack;
+    stack.append({m_root, Frustum::AllPlanes});
+    while (!stack.isEmpty()) {
+        Entry entry = stack.takeLast();
+        const Node& node = m_nodes[entry.index];
+        ++visited;
+        if (distanceScale > 0.0f) {
+            float range = node.drawDistance * distanceScale;
+            if (distanceSquared(eye, node.box) > range * range) {
+                continue;
+            }
+        }
+        if (entry.mask != 0 && !frustum.testBox(node.box, entry.mask, lastRejected)) {
+            continue;
+        }
+
+        if (node.isLeaf()) {
+            out.append(node.id);
+        } else {
+            stack.append({node.left, entry.mask});
+            stack.append({node.right, entry.mask});
+        }
+    }
+    return visited;
+}
+
+EntityId DynamicBVH::raycast(const QVector3D& origin, const QVector3D& direction, float maxDistance,
+                             const RayHitTest& hitTest, float* hitDistance) const {
+    EntityId closest = 0;
+    float closestDistance = maxDistance;
+    QVector3D invDirection(1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z());
+
+    float entry;
+    if (m_root < 0 || !rayHitsBox(origin, invDirection, m_nodes[m_root].box, closestDistance, entry)) {
+        return 0;
+    }
+
+    struct StackEntry {
+        int node;
+        float entry;
+    };
+    QVarLengthArray<StackEntry, 64> stack;
+    stack.append(StackEntry{m_root, entry});
+
+    while (!stack.isEmpty()) {
+        StackEntry current = stack.takeLast();
+        if (current.entry > closestDistance) {
+            continue;
+        }
+
+        const Node& node = m_nodes[current.node];
+        if (node.isLeaf()) {
+            float distance;
+            if (hitTest(node.id, distance) && distance >= 0.0f && distance < closestDistance) {
+                closestDistance = distance;
+                closest = node.id;
+            }
+            continue;
+        }
+
+        // Push the farther child first so the nearer one is visited next
+        float leftEntry, rightEntry;
+        bool hitLeft = rayHitsBox(origin, invDirection, m_nodes[node.left].box, closestDistance, leftEntry);
+        bool hitRight = rayHitsBox(origin, invDirection, m_nodes[node.right].box, closestDistance, rightEntry);
+        if (hitLeft && hitRight) {
+            if (leftEntry < rightEntry) {
+                stack.append(StackEntry{node.right, rightEntry});
+                stack.append(StackEntry{node.left, leftEntry});
+            } else {
+                stack.append(StackEntry{node.left, leftEntry});
+                stack.append(StackEntry{node.right, rightEntry});
+            }
+        } else if (hitLeft) {
+            stack.append(StackEntry{node.left, leftEntry});
+        } else if (hitRight) {
+            stack.append(StackEntry{node.right, rightEntry});
+        }
+    }
+
+    if (closest && hitDistance) {
+        *hitDistance = closestDistance;
+    }
+    return closest;
+}
+
+int DynamicBVH::getHeight() const {
+    return m_root >= 0 ? m_nodes[m_root].height : 0;
+}
+
+int DynamicBVH::getNodeCount() const {
+    return m_nodeCount;
+}
+
+float DynamicBVH::getSAHCost() const {
+    if (m_root < 0) {
+        return 0.0f;
+    }
+
+    float rootArea = area(m_nodes[m_root].box);
+    if (rootArea <= 0.0f) {
+        return 0.0f;
+    }
+
+    float total = 0.0f;
+    for (const Node& node : m_nodes) {
+        if (node.height > 0) {
+            total += area(node.box);
+        }
+    }
+    return total / rootArea;
+}
+
+BoundingBox DynamicBVH::getBounds() const {
+    return m_root >= 0 ? m_nodes[m_root].box : BoundingBox();
+}
+
+int DynamicBVH::allocateNode() {
+    int index;
+    if (m_freeList >= 0) {
+        index = m_freeList;
+        m_freeList = m_nodes[index].parent;
+        m_nodes[index] = Node();
+    } else {
+        index = m_nodes.size();
+        m_nodes.append(Node());
+    }
+    ++m_nodeCount;
+    return index;
+}
+
+void DynamicBVH::freeNode(int index) {
+    m_nodes[index] = Node();
+    m_nodes[index].parent = m_freeList;
+    m_nodes[index].height = -1;
+    m_freeList = index;
+    --m_nodeCount;
+}
+
+BoundingBox DynamicBVH::fatten(const BoundingBox& box) const {
+    QVector3D extent = box.size();
+    float margin = m_marginAbsolute + m_marginRelative * qMax(extent.x(), qMax(extent.y(), extent.z()));
+    QVector3D offset(margin, margin, margin);
+    return BoundingBox(box.min - offset, box.max + offset);
+}
+
+void DynamicBVH::insertLeaf(int leaf) {
+    if (m_root < 0) {
+        m_root = leaf;
+        m_nodes[leaf].parent = -1;
+        return;
+    }
+
+    // Descend towards the sibling that adds the least surface area
+    const BoundingBox leafBox = m_nodes[leaf].box;
+    int index = m_root;
+    while (!m_nodes[index].isLeaf()) {
+        const Node& node = m_nodes[index];
+        float combinedArea = area(merge(node.box, leafBox));
+        float cost = 2.0f * combinedArea;
+        float inheritedCost = 2.0f * (combinedArea - area(node.box));
+
+        auto descendCost = [&](int child) {
+            const Node& childNode = m_nodes[child];
+            float mergedArea = area(merge(childNode.box, leafBox));
+            return childNode.isLeaf() ? mergedArea + inheritedCost
+                                      : mergedArea - area(childNode.box) + inheritedCost;
+        };
+        float leftCost = descendCost(node.left);
+        float rightCost = descendCost(node.right);
+
+        if (cost < leftCost && cost < rightCost) {
+            break;
+        }
+        index = leftCost < rightCost ? node.left : node.right;
+    }
+
+    int sibling = index;
+    int oldParent = m_nodes[sibling].parent;
+    int newParent = allocateNode();
+    m_nodes[newParent].parent = oldParent;
+    m_nodes[newParent].left = sibling;
+    m_nodes[newParent].right = leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+
+    if (oldParent < 0) {
+        m_root = newParent;
+    } else {
+        replaceChild(oldParent, sibling, newParent);
+    }
+
+    refitAndRotate(newParent);
+}
+
+void DynamicBVH::removeLeaf(int leaf) {
+    if (leaf == m_root) {
+        m_root = -1;
+        return;
+    }
+
+    int parent = m_nodes[leaf].parent;
+    int grandParent = m_nodes[parent].parent;
+    int sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+    if (grandParent < 0) {
+        m_root = sibling;
+        m_nodes[sibling].parent = -1;
+        freeNode(parent);
+    } else {
+        replaceChild(grandParent, parent, sibling);
+        m_nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refitAndRotate(grandParent);
+    }
+    m_nodes[leaf].parent = -1;
+}
+
+void DynamicBVH::refitAndRotate(int index) {
+    while (index >= 0) {
+        refitNode(index);
+        rotate(index);
+        index = m_nodes[index].parent;
+    }
+}
+
+void DynamicBVH::rotate(int index) {
+    // Try swapping one child with a grandchild under the other child. The
+    // node's own box is unchanged by this, but the child that receives the
+    // swapped-in subtree may shrink.
+    const int left = m_nodes[index].left;
+    const int right = m_nodes[index].right;
+    if (left < 0) {
+        return;
+    }
+
+    float bestGain = 0.0f;
+    int bestChild = -1;
+    int bestGrandChild = -1;
+
+    auto consider = [&](int child, int otherChild) {
+        const Node& other = m_nodes[otherChild];
+        if (other.isLeaf()) {
+            return;
+        }
+        const float otherArea = area(other.box);
+        // Swapping `child` with other.left leaves other.right next to `child`
+        float gainLeft = otherArea - area(merge(m_nodes[child].box, m_nodes[other.right].box));
+        float gainRight = otherArea - area(merge(m_nodes[child].box, m_nodes[other.left].box));
+        if (gainLeft > bestGain) {
+            bestGain = gainLeft;
+            bestChild = child;
+            bestGrandChild = other.left;
+        }
+        if (gainRight > bestGain) {
+            bestGain = gainRight;
+            bestChild = child;
+            bestGrandChild = other.right;
+        }
+    };
+    consider(left, right);
+    consider(right, left);
+
+    if (bestChild < 0) {
+        return;
+    }
+
+    int otherChild = m_nodes[bestGrandChild].parent;
+    replaceChild(index, bestChild, bestGrandChild);
+    replaceChild(otherChild, bestGrandChild, bestChild);
+    m_nodes[bestGrandChild].parent = index;
+    m_nodes[bestChild].parent = otherChild;
+    refitNode(otherChild);
+    refitNode(index);
+}
+
+void DynamicBVH::refitNode(int index) {
+    Node& node = m_nodes[index];
+    const Node& left = m_nodes[node.left];
+    const Node& right = m_nodes[node.right];
+    node.box = merge(left.box, right.box);
+    node.height = 1 + qMax(left.height, right.height);
+    node.drawDistance = qMax(left.drawDistance, right.drawDistance);
+}
+
+void DynamicBVH::replaceChild(int parent, int oldChild, int newChild) {
+    if (m_nodes[parent].left == oldChild) {
+        m_nodes[parent].left = newChild;
+    } else {
+        m_nodes[parent].right = newChild;
+    }
+}
+
+BoundingBox DynamicBVH::merge(const BoundingBox& a, const BoundingBox& b) {
+    return BoundingBox(
+        QVector3D(qMin(a.min.x(), b.min.x()), qMin(a.min.y(), b.min.y()), qMin(a.min.z(), b.min.z())),
+        QVector3D(qMax(a.max.x(), b.max.x()), qMax(a.max.y(), b.max.y()), qMax(a.max.z(), b.max.z()))
+    );
+}
+
+float DynamicBVH::area(const BoundingBox& box) {
+    QVector3D d = box.size();
+    return 2.0f * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+}
+
+bool DynamicBVH::overlaps(const BoundingBox& a, const BoundingBox& b) {
+    return a.min.x() <= b.max.x() && a.max.x() >= b.min.x()
+        && a.min.y() <= b.max.y() && a.max.y() >= b.min.y()
+        && a.min.z() <= b.max.z() && a.max.z() >= b.min.z();
+}
+
+float DynamicBVH::distanceSquared(const QVector3D& point, const BoundingBox& box) {
+    float result = 0.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+        float v = point[axis];
+        if (v < box.min[axis]) {
+            result += (box.min[axis] - v) * (box.min[axis] - v);
+        } else if (v > box.max[axis]) {
+            result += (v - box.max[axis]) * (v - box.max[axis]);
+        }
+    }
+    return result;
+}
+
+bool DynamicBVH::rayHitsBox(const QVector3D& origin, const QVector3D& invDirection,
+                            const BoundingBox& box, float maxDistance, float& entry) {
+    float tNear = 0.0f;
+    float tFar = maxDistance;
+    for (int axis = 0; axis < 3; ++axis) {
+        float t1 = (box.min[axis] - origin[axis]) * invDirection[axis];
+        float t2 = (box.max[axis] - origin[axis]) * invDirection[axis];
+        tNear = qMax(tNear, qMin(t1, t2));
+        tFar = qMin(tFar, qMax(t1, t2));
+    }
+    entry = tNear;
+    return tNear <= tFar;
+}
@@ -0,0 +1,114 @@
+#ifndef DYNAMIC_BVH_H
+#define DYNAMIC_BVH_H
+
+#include "types.h"
+#include "frustum.h"
+#include <QHash>
+#include <QVector>
+#include <QVector3D>
+#include <functional>
+#include <limits>
+
+// Bounding volume hierarchy over entity AABBs that is kept up to date
+// incrementally. Each entity is one leaf whose box is fattened by a margin,
+// so small moves do not touch the tree at all. Larger moves reinsert the
+// leaf; ancestors are refitted on the way up and rotated whenever swapping
+// a child with a grandchild reduces surface area. build() creates a tree
+// from scratch with a binned SAH split, used after loading a scene.
+class DynamicBVH {
+public:
+    DynamicBVH();
+
+    // Bulk build, replacing the current contents. drawDistances, if given,
+    // is parallel to ids (see setDrawDistance()).
+    void build(const QVector<EntityId>& ids, const QVector<BoundingBox>& boxes,
+               const QVector<float>& drawDistances = QVector<float>());
+
+    // Incremental maintenance
+    void insert(EntityId id, const BoundingBox& box);
+    bool update(EntityId id, const BoundingBox& box); // True if the tree changed
+    void remove(EntityId id);
+    void clear();
+
+    bool contains(EntityId id) const;
+    int size() const;
+
+    // Farthest distance at which a leaf can be seen; 0 means unlimited.
+    // Internal nodes keep the maximum over their subtree.
+    void setDrawDistance(EntityId id, float distance);
+    
+    // Fattening applied to leaf boxes: absolute + relative * largest extent
+    void setMargin(float absolute, float relative);
+
+    // Queries; candidates are tested against the fattened leaf boxes, so
+    // callers apply their exact test afterwards
+    void queryBox(const BoundingBox& box, QVector<EntityId>& out) const;
+    void querySphere(const QVector3D& center, float radius, QVector<EntityId>& out) const;
+    
+    // Frustum walk with plane masking: planes a node lies fully inside are
+    // not tested again below it, and fully inside subtrees are appended
+    // without any tests. Plane coherency is per walk only: the plane that
+    // rejected the last node is tried first on the next one, since
+    // neighbouring subtrees tend to fall outside the same side. Nothing is
+    // kept from frame to frame, as the tree is never written by a query
+    // and concurrent walks over shared copies are safe. With a positive
+    // distanceScale, subtrees farther from eye than their scaled draw
+    // distance are skipped too. Returns the number of nodes visited.
+    int queryFrustum(const Frustum& frustum, QVector<EntityId>& out,
+                     const QVector3D& eye = QVector3D(), float distanceScale = 0.0f) const;
+
+    // Closest-hit ray traversal, visiting nearer subtrees first. hitTest
+    // does the exact test for a candidate and returns true with the hit
+    // distance; subtrees beyond the best hit so far are skipped.
+    using RayHitTest = std::function<bool(EntityId id, float& distance)>;
+    EntityId raycast(const QVector3D& origin, const QVector3D& direction, float maxDistance,
+                     const RayHitTest& hitTest, float* hitDistance = nullptr) const;
+
+    // Diagnostics
+    int getHeight() const;
+    int getNodeCount() const;
+    float getSAHCost() const; // Sum of internal node areas relative to the root
+    BoundingBox getBounds() const;
+
+private:
+    struct Node {
+        BoundingBox box;
+        int parent = -1;
+        int left = -1;
+        int right = -1;
+        int height = 0;
+        EntityId id = 0;
+        float drawDistance = std::numeric_limits<float>::infinity();
+
+        bool isLeaf() const { return left < 0; }
+    };
+
+    int allocateNode();
+    void freeNode(int index);
+    BoundingBox fatten(const BoundingBox& box) const;
+
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    void refitAndRotate(int index);
+    void rotate(int index);
+    void refitNode(int index);
+    void replaceChild(int parent, int oldChild, int newChild);
+
+    static BoundingBox merge(const BoundingBox& a, const BoundingBox& b);
+    static float area(const BoundingBox& box);
+    static bool overlaps(const BoundingBox& a, const BoundingBox& b);
+    static float distanceSquared(const QVector3D& point, const BoundingBox& box);
+    static bool rayHitsBox(const QVector3D& origin, const QVector3D& invDirection,
+                           const BoundingBox& box, float maxDistance, float& entry);
+
+    QVector<Node> m_nodes;
+    int m_root = -1;
+    int m_freeList = -1; // Linked through Node::parent
+    int m_nodeCount = 0;
+    QHash<EntityId, int> m_leaves;
+
+    float m_marginAbsolute = 0.5f;
+    float m_marginRelative = 0.1f;
+};
+
+#endif // DYNAMIC_BVH_H
@@ -0,0 +1,77 @@
+#include "frustum.h"
+#include <cmath>
+
+Frustum::Frustum(const QMatrix4x4& viewProjection) {
+    set(viewProjection);
+}
+
+void Frustum::set(const QMatrix4x4& viewProjection) {
+    const QVector4D row0 = viewProjection.row(0);
+    const QVector4D row1 = viewProjection.row(1);
+    const QVector4D row2 = viewProjection.row(2);
+    const QVector4D row3 = viewProjection.row(3);
+
+    m_planes[Left] = row3 + row0;
+    m_planes[Right] = row3 - row0;
+    m_planes[Bottom] = row3 + row1;
+    m_planes[Top] = row3 - row1;
+    m_planes[Near] = row3 + row2;
+    m_planes[Far] = row3 - row2;
+
+    for (int i = 0; i < PlaneCount; ++i) {
+        QVector4D& plane = m_planes[i];
+        float length = plane.toVector3D().length();
+        if (length > 0.0f) {
+            plane /= length;
+        }
+        m_absNormals[i] = QVector3D(std::fabs(plane.x()), std::fabs(plane.y()), std::fabs(plane.z()));
+    }
+}
+
+bool Frustum::testBox(const BoundingBox& box, quint8& mask, quint8& firstPlane) const {
+    const QVector3D center = box.center();
+    const QVector3D extent = box.size() * 0.5f;
+
+    // Start with the plane that rejected this box last time, then the rest
+    for (int n = 0; n < PlaneCount; ++n) {
+        int i = n == 0 ? firstPlane : (n <= firstPlane ? n - 1 : n);
+        quint8 bit = quint8(1 << i);
+        if (!(mask & bit)) {
+            continue;
+        }
+
+        const QVector4D& plane = m_planes[i];
+        float distance = plane.x() * center.x() + plane.y() * center.y() + plane.z() * center.z() + plane.w();
+        float radius = QVector3D::dotProduct(m_absNormals[i], extent);
+        if (distance + radius < 0.0f) {
+            firstPlane = quint8(i);
+            return false;
+        }
+        if (distance - radius >= 0.0f) {
+            mask &= ~bit;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersects(const BoundingBox& box) const {
+    quint8 mask = AllPlanes;
+    quint8 firstPlane = 0;
+    return testBox(box, mask, firstPlane);
+}
+
+bool Frustum::contains(const QVector3D& point) const {
+    for (const QVector4D& plane : m_planes) {
+        if (plane.x() * point.x() + plane.y() * point.y() + plane.z() * point.z() + plane.w() < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::contains(const BoundingBox& box) const {
+    // testBox() clears the planes the box lies fully inside
+    quint8 mask = AllPlanes;
+    quint8 firstPlane = 0;
+    return testBox(box, mask, firstPlane) && mask == 0;
+}
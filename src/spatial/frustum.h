@@ -0,0 +1,39 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "types.h"
+#include <QMatrix4x4>
+#include <QVector4D>
+
+// View frustum as six world-space planes, extracted from a view-projection
+// matrix with the Gribb/Hartmann method. Normals point inwards and are
+// normalised, so plane distances are in world units.
+class Frustum {
+public:
+    enum Plane { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+    static constexpr quint8 AllPlanes = (1 << PlaneCount) - 1;
+
+    Frustum() = default;
+    explicit Frustum(const QMatrix4x4& viewProjection);
+
+    void set(const QMatrix4x4& viewProjection);
+    const QVector4D& getPlane(Plane plane) const { return m_planes[plane]; }
+
+    // Box test for hierarchy walks. Only planes whose bit is set in mask are
+    // tested, starting with firstPlane; planes the box lies fully inside are
+    // cleared from mask so children can skip them. Returns false as soon as
+    // the box is outside a plane, leaving that plane in firstPlane so the
+    // caller can try it first on the next box.
+    bool testBox(const BoundingBox& box, quint8& mask, quint8& firstPlane) const;
+
+    // Plain tests against all six planes
+    bool intersects(const BoundingBox& box) const;
+    bool contains(const QVector3D& point) const;
+    bool contains(const BoundingBox& box) const;
+
+private:
+    QVector4D m_planes[PlaneCount];
+    QVector3D m_absNormals[PlaneCount]; // |normal|, for box extent projection
+};
+
+#endif // FRUSTUM_H
@@ -0,0 +1,332 @@
+#include "triangle_bvh.h"
+#include <QVarLengthArray>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+const int kSahBins = 12;
+const int kMaxLeafTriangles = 4;
+
+struct Bounds {
+    float min[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    float max[3] = {-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max()};
+
+    void grow(const QVector3D& point) {
+        for (int axis = 0; axis < 3; ++axis) {
+            min[axis] = qMin(min[axis], point[axis]);
+            max[axis] = qMax(max[axis], point[axis]);
+        }
+    }
+
+    void grow(const Bounds& other) {
+        for (int axis = 0; axis < 3; ++axis) {
+            min[axis] = qMin(min[axis], other.min[axis]);
+            max[axis] = qMax(max[axis], other.max[axis]);
+        }
+    }
+
+    float area() const {
+        float dx = max[0] - min[0];
+        float dy = max[1] - min[1];
+        float dz = max[2] - min[2];
+        return dx < 0.0f ? 0.0f : 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+};
+
+// Axis-parallel rays are common (drop to ground) and model vertices often
+// sit on whole units; a huge finite inverse keeps the slab test free of
+// 0 * inf when the origin lies exactly on a node face
+float safeInverse(float value) {
+    return 1.0f / (value != 0.0f ? value : 1e-30f);
+}
+}
+
+void TriangleBVH::build(const GTAModel& model) {
+    QVector<QVector3D> positions;
+    QVector<uint32_t> indices;
+    for (const GTAMesh& mesh : model.meshes) {
+        uint32_t base = positions.size();
+        for (const GTAVertex& vertex : mesh.vertices) {
+            positions.append(vertex.position);
+        }
+        if (mesh.indices.isEmpty()) {
+            for (uint32_t i = 0; i < uint32_t(mesh.vertices.size() / 3 * 3); ++i) {
+                indices.append(base + i);
+            }
+        } else {
+            for (uint32_t index : mesh.indices) {
+                indices.append(base + index);
+            }
+        }
+    }
+    build(positions, indices);
+}
+
+void TriangleBVH::build(const QVector<QVector3D>& positions, const QVector<uint32_t>& indices) {
+    clear();
+
+    QVector<Triangle> triangles;
+    triangles.reserve(indices.size() / 3);
+    for (int i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t a = indices[i];
+        uint32_t b = indices[i + 1];
+        uint32_t c = indices[i + 2];
+        if (a >= uint32_t(positions.size()) || b >= uint32_t(positions.size()) || c >= uint32_t(positions.size())) {
+            continue;
+        }
+
+        Triangle triangle{positions[a], positions[b] - positions[a], positions[c] - positions[a]};
+        if (QVector3D::crossProduct(triangle.edge1, triangle.edge2).lengthSquared() > 0.0f) {
+            triangles.append(triangle);
+        }
+    }
+
+    buildNodes(triangles);
+}
+
+void TriangleBVH::clear() {
+    m_nodes.clear();
+    m_triangles.clear();
+}
+
+BoundingBox TriangleBVH::getBounds() const {
+    if (m_nodes.isEmpty()) {
+        return BoundingBox();
+    }
+    const Node& root = m_nodes.first();
+    return BoundingBox(QVector3D(root.min[0], root.min[1], root.min[2]),
+                       QVector3D(root.max[0], root.max[1], root.max[2]));
+}
+
+void TriangleBVH::buildNodes(const QVector<Triangle>& triangles) {
+    const int count = triangles.size();
+    if (count == 0) {
+        return;
+    }
+
+    QVector<Bounds> boxes(count);
+    QVector<QVector3D> centroids(count);
+    for (int i = 0; i < count; ++i) {
+        const Triangle& triangle = triangles[i];
+        boxes[i].grow(triangle.v0);
+        boxes[i].grow(triangle.v0 + triangle.edge1);
+        boxes[i].grow(triangle.v0 + triangle.edge2);
+        centroids[i] = triangle.v0 + (triangle.edge1 + triangle.edge2) / 3.0f;
+    }
+
+    QVector<int> items(count);
+    std::iota(items.begin(), items.end(), 0);
+    m_nodes.reserve(2 * count / kMaxLeafTriangles + 1);
+
+    // Depth-first with an explicit stack. The left task is pushed last, so
+    // it is allocated right after its parent; the right child's index is
+    // patched into the parent once that task is popped.
+    struct Task {
+        int begin;
+        int end;
+        int parent; // Node whose right child this is, or -1
+    };
+    QVector<Task> tasks;
+    tasks.append(Task{0, count, -1});
+
+    while (!tasks.isEmpty()) {
+        Task task = tasks.takeLast();
+
+        int index = m_nodes.size();
+        m_nodes.append(Node());
+        if (task.parent >= 0) {
+            m_nodes[task.parent].rightOrFirst = index;
+        }
+
+        Bounds bounds;
+        Bounds centroidBounds;
+        for (int i = task.begin; i < task.end; ++i) {
+            bounds.grow(boxes[items[i]]);
+            centroidBounds.grow(centroids[items[i]]);
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            m_nodes[index].min[axis] = bounds.min[axis];
+            m_nodes[index].max[axis] = bounds.max[axis];
+        }
+
+        int itemCount = task.end - task.begin;
+        if (itemCount <= kMaxLeafTriangles) {
+            m_nodes[index].rightOrFirst = task.begin;
+            m_nodes[index].count = itemCount;
+            continue;
+        }
+
+        int axis = 0;
+        for (int candidate = 1; candidate < 3; ++candidate) {
+            if (centroidBounds.max[candidate] - centroidBounds.min[candidate]
+                > centroidBounds.max[axis] - centroidBounds.min[axis]) {
+                axis = candidate;
+            }
+        }
+        float spread = centroidBounds.max[axis] - centroidBounds.min[axis];
+
+        int middle = task.begin;
+        if (spread > 1e-6f) {
+            float scale = kSahBins / spread;
+            auto binOf = [&](int item) {
+                return qMin(kSahBins - 1, static_cast<int>((centroids[item][axis] - centroidBounds.min[axis]) * scale));
+            };
+
+            int binCounts[kSahBins] = {};
+            Bounds binBounds[kSahBins];
+            for (int i = task.begin; i < task.end; ++i) {
+                int bin = binOf(items[i]);
+                binBounds[bin].grow(boxes[items[i]]);
+                ++binCounts[bin];
+            }
+
+            float rightAreas[kSahBins] = {};
+            int rightCounts[kSahBins] = {};
+            Bounds accumulated;
+            int accumulatedCount = 0;
+            for (int bin = kSahBins - 1; bin > 0; --bin) {
+                accumulated.grow(binBounds[bin]);
+                accumulatedCount += binCounts[bin];
+                rightAreas[bin - 1] = accumulated.area();
+                rightCounts[bin - 1] = accumulatedCount;
+            }
+
+            float bestCost = std::numeric_limits<float>::max();
+            int bestSplit = -1;
+            accumulated = Bounds();
+            accumulatedCount = 0;
+            for (int bin = 0; bin < kSahBins - 1; ++bin) {
+                accumulated.grow(binBounds[bin]);
+                accumulatedCount += binCounts[bin];
+                if (accumulatedCount == 0 || rightCounts[bin] == 0) {
+                    continue;
+                }
+                float cost = accumulated.area() * accumulatedCount + rightAreas[bin] * rightCounts[bin];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestSplit = bin;
+                }
+            }
+
+            if (bestSplit >= 0) {
+                auto split = std::partition(items.begin() + task.begin, items.begin() + task.end,
+                    [&](int item) { return binOf(item) <= bestSplit; });
+                middle = static_cast<int>(split - items.begin());
+            }
+        }
+
+        // Coincident centroids or a degenerate split: fall back to the median
+        if (middle <= task.begin || middle >= task.end) {
+            middle = task.begin + itemCount / 2;
+            std::nth_element(items.begin() + task.begin, items.begin() + middle, items.begin() + task.end,
+                [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+        }
+
+        tasks.append(Task{middle, task.end, index});
+        tasks.append(Task{task.begin, middle, -1});
+    }
+
+    // Leaves reference triangles by position, so store them in item order
+    m_triangles.reserve(count);
+    for (int item : items) {
+        m_triangles.append(triangles[item]);
+    }
+}
+
+bool TriangleBVH::raycast(const QVector3D& origin, const QVector3D& direction, float maxDistance, Hit& hit) const {
+    if (m_nodes.isEmpty()) {
+        return false;
+    }
+
+    const float rayOrigin[3] = {origin.x(), origin.y(), origin.z()};
+    const float invDirection[3] = {safeInverse(direction.x()), safeInverse(direction.y()), safeInverse(direction.z())};
+
+    float entry;
+    if (!rayHitsNode(m_nodes.first(), rayOrigin, invDirection, maxDistance, entry)) {
+        return false;
+    }
+
+    struct StackEntry {
+        int node;
+        float entry;
+    };
+    QVarLengthArray<StackEntry, 64> stack;
+    stack.append(StackEntry{0, entry});
+
+    float closest = maxDistance;
+    bool found = false;
+    while (!stack.isEmpty()) {
+        StackEntry current = stack.takeLast();
+        if (current.entry > closest) {
+            continue;
+        }
+
+        const Node& node = m_nodes[current.node];
+        if (node.count > 0) {
+            // Moller-Trumbore against each triangle in the leaf
+            for (int i = node.rightOrFirst; i < node.rightOrFirst + node.count; ++i) {
+                const Triangle& triangle = m_triangles[i];
+                QVector3D p = QVector3D::crossProduct(direction, triangle.edge2);
+                float det = QVector3D::dotProduct(triangle.edge1, p);
+                if (det == 0.0f) {
+                    continue;
+                }
+                float invDet = 1.0f / det;
+                QVector3D s = origin - triangle.v0;
+                float u = QVector3D::dotProduct(s, p) * invDet;
+                if (u < 0.0f || u > 1.0f) {
+                    continue;
+                }
+                QVector3D q = QVector3D::crossProduct(s, triangle.edge1);
+                float v = QVector3D::dotProduct(direction, q) * invDet;
+                if (v < 0.0f || u + v > 1.0f) {
+                    continue;
+                }
+                float t = QVector3D::dotProduct(triangle.edge2, q) * invDet;
+                if (t >= 0.0f && t < closest) {
+                    closest = t;
+                    hit.distance = t;
+                    hit.normal = QVector3D::crossProduct(triangle.edge1, triangle.edge2);
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // Push the farther child first so the nearer one is visited next
+        int left = current.node + 1;
+        int right = node.rightOrFirst;
+        float leftEntry, rightEntry;
+        bool hitLeft = rayHitsNode(m_nodes[left], rayOrigin, invDirection, closest, leftEntry);
+        bool hitRight = rayHitsNode(m_nodes[right], rayOrigin, invDirection, closest, rightEntry);
+        if (hitLeft && hitRight) {
+            if (leftEntry < rightEntry) {
+                stack.append(StackEntry{right, rightEntry});
+                stack.append(StackEntry{left, leftEntry});
+            } else {
+                stack.append(StackEntry{left, leftEntry});
+                stack.append(StackEntry{right, rightEntry});
+            }
+        } else if (hitLeft) {
+            stack.append(StackEntry{left, leftEntry});
+        } else if (hitRight) {
+            stack.append(StackEntry{right, rightEntry});
+        }
+    }
+    return found;
+}
+
+bool TriangleBVH::rayHitsNode(const Node& node, const float* origin, const float* invDirection,
+                              float maxDistance, float& entry) {
+    float tNear = 0.0f;
+    float tFar = maxDistance;
+    for (int axis = 0; axis < 3; ++axis) {
+        float t1 = (node.min[axis] - origin[axis]) * invDirection[axis];
+        float t2 = (node.max[axis] - origin[axis]) * invDirection[axis];
+        tNear = qMax(tNear, qMin(t1, t2));
+        tFar = qMin(tFar, qMax(t1, t2));
+    }
+    entry = tNear;
+    return tNear <= tFar;
+}
@@ -0,0 +1,57 @@
+#ifndef TRIANGLE_BVH_H
+#define TRIANGLE_BVH_H
+
+#include "types.h"
+#include <QVector>
+#include <QVector3D>
+
+// Static BVH over the triangles of one model, in model space, for exact
+// ray hits. Built once per model with a binned SAH split and stored as a
+// flat depth-first array: a node's left child follows it directly, so only
+// the right child index is kept. Triangles are reordered to match the
+// leaves and stored as a vertex plus two edges, ready for Moller-Trumbore.
+class TriangleBVH {
+public:
+    struct Hit {
+        float distance = 0.0f;  // Ray parameter; a world distance for unit rays
+        QVector3D normal;       // Geometric normal, unnormalised, model space
+    };
+
+    // Every mesh of the model, or one index/position set. Non-indexed
+    // meshes are treated as triangle lists.
+    void build(const GTAModel& model);
+    void build(const QVector<QVector3D>& positions, const QVector<uint32_t>& indices);
+    void clear();
+
+    bool isEmpty() const { return m_triangles.isEmpty(); }
+    int getTriangleCount() const { return m_triangles.size(); }
+    int getNodeCount() const { return m_nodes.size(); }
+    BoundingBox getBounds() const;
+
+    // Closest hit along origin + t * direction for t in [0, maxDistance].
+    // Triangles are double-sided.
+    bool raycast(const QVector3D& origin, const QVector3D& direction, float maxDistance, Hit& hit) const;
+
+private:
+    struct Node {
+        float min[3] = {};
+        float max[3] = {};
+        int rightOrFirst = 0; // Right child for internal nodes, first triangle for leaves
+        int count = 0;        // Triangle count; 0 for internal nodes
+    };
+
+    struct Triangle {
+        QVector3D v0;
+        QVector3D edge1;
+        QVector3D edge2;
+    };
+
+    void buildNodes(const QVector<Triangle>& triangles);
+    static bool rayHitsNode(const Node& node, const float* origin, const float* invDirection,
+                            float maxDistance, float& entry);
+
+    QVector<Node> m_nodes;
+    QVector<Triangle> m_triangles;
+};
+
+#endif // TRIANGLE_BVH_H
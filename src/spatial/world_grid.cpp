@@ -0,0 +1,198 @@
+#include "world_grid.h"
+#include <QDebug>
+#include <cmath>
+#include <limits>
+
+namespace {
+const QVector<EntityId> kNoEntities;
+
+// Floors to a cell index, clamped so far-away positions stay representable
+int cellIndex(float coordinate, float inverseCellSize) {
+    const float limit = 1.0e9f;
+    float index = std::floor(coordinate * inverseCellSize);
+    if (!(index > -limit)) {
+        return -int(limit);
+    }
+    return int(qMin(index, limit));
+}
+}
+
+WorldGrid::WorldGrid(float cellSize)
+    : m_cellSize(DefaultCellSize)
+    , m_inverseCellSize(1.0f / DefaultCellSize)
+{
+    setCellSize(cellSize);
+}
+
+void WorldGrid::setCellSize(float size) {
+    if (!(size > 0.0f)) {
+        qWarning() << "WorldGrid: Ignoring invalid cell size" << size;
+        return;
+    }
+    if (size == m_cellSize) {
+        return;
+    }
+
+    m_cellSize = size;
+    m_inverseCellSize = 1.0f / size;
+
+    // Entries keep their positions, so they can be bucketed again directly
+    m_cells.clear();
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        it->cell = cellAt(it->position);
+        addToCell(it.key(), it.value());
+    }
+}
+
+float WorldGrid::getCellSize() const {
+    return m_cellSize;
+}
+
+GridCell WorldGrid::cellAt(const QVector3D& position) const {
+    return GridCell{cellIndex(position.x(), m_inverseCellSize), cellIndex(position.y(), m_inverseCellSize)};
+}
+
+BoundingBox WorldGrid::getCellBounds(const GridCell& cell) const {
+    const float lowest = std::numeric_limits<float>::lowest();
+    const float highest = std::numeric_limits<float>::max();
+    return BoundingBox(QVector3D(cell.x * m_cellSize, cell.y * m_cellSize, lowest),
+                       QVector3D((cell.x + 1) * m_cellSize, (cell.y + 1) * m_cellSize, highest));
+}
+
+bool WorldGrid::set(EntityId id, const QVector3D& position, qint64 memoryBytes) {
+    GridCell cell = cellAt(position);
+
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        Entry entry;
+        entry.cell = cell;
+        entry.position = position;
+        entry.memoryBytes = memoryBytes;
+        addToCell(id, m_entries.insert(id, entry).value());
+        return true;
+    }
+
+    Entry& entry = it.value();
+    entry.position = position;
+    if (entry.cell == cell) {
+        m_cells[cell].memoryBytes += memoryBytes - entry.memoryBytes;
+        entry.memoryBytes = memoryBytes;
+        return false;
+    }
+
+    removeFromCell(entry);
+    entry.cell = cell;
+    entry.memoryBytes = memoryBytes;
+    addToCell(id, entry);
+    return true;
+}
+
+void WorldGrid::remove(EntityId id) {
+    auto it = m_entries.find(id);
+    if (it != m_entries.end()) {
+        removeFromCell(it.value());
+        m_entries.erase(it);
+    }
+}
+
+void WorldGrid::clear() {
+    m_cells.clear();
+    m_entries.clear();
+}
+
+bool WorldGrid::contains(EntityId id) const {
+    return m_entries.contains(id);
+}
+
+GridCell WorldGrid::getCellOf(EntityId id) const {
+    auto it = m_entries.find(id);
+    return it != m_entries.end() ? it->cell : GridCell();
+}
+
+int WorldGrid::size() const {
+    return m_entries.size();
+}
+
+const QVector<EntityId>& WorldGrid::getEntities(const GridCell& cell) const {
+    auto it = m_cells.find(cell);
+    return it != m_cells.end() ? it->entities : kNoEntities;
+}
+
+int WorldGrid::getEntityCount(const GridCell& cell) const {
+    return getEntities(cell).size();
+}
+
+qint64 WorldGrid::getMemoryUsage(const GridCell& cell) const {
+    auto it = m_cells.find(cell);
+    return it != m_cells.end() ? it->memoryBytes : 0;
+}
+
+QVector<GridCell> WorldGrid::getOccupiedCells() const {
+    return m_cells.keys();
+}
+
+int WorldGrid::getOccupiedCellCount() const {
+    return m_cells.size();
+}
+
+void WorldGrid::queryCells(const GridCell& min, const GridCell& max, QVector<EntityId>& out) const {
+    if (min.x > max.x || min.y > max.y) {
+        return;
+    }
+
+    // Large ranges over a sparse map are cheaper to answer by walking the
+    // occupied cells than by probing every coordinate in the range
+    qint64 rangeCells = (qint64(max.x) - min.x + 1) * (qint64(max.y) - min.y + 1);
+    if (rangeCells > m_cells.size()) {
+        for (auto it = m_cells.begin(); it != m_cells.end(); ++it) {
+            const GridCell& cell = it.key();
+            if (cell.x >= min.x && cell.x <= max.x && cell.y >= min.y && cell.y <= max.y) {
+                out.append(it->entities);
+            }
+        }
+        return;
+    }
+
+    for (int y = min.y; y <= max.y; ++y) {
+        for (int x = min.x; x <= max.x; ++x) {
+            auto it = m_cells.find(GridCell{x, y});
+            if (it != m_cells.end()) {
+                out.append(it->entities);
+            }
+        }
+    }
+}
+
+void WorldGrid::queryBox(const BoundingBox& box, QVector<EntityId>& out) const {
+    queryCells(cellAt(box.min), cellAt(box.max), out);
+}
+
+void WorldGrid::queryNeighbourhood(const GridCell& cell, int radius, QVector<EntityId>& out) const {
+    queryCells(GridCell{cell.x - radius, cell.y - radius}, GridCell{cell.x + radius, cell.y + radius}, out);
+}
+
+void WorldGrid::addToCell(EntityId id, Entry& entry) {
+    Cell& cell = m_cells[entry.cell];
+    entry.slot = cell.entities.size();
+    cell.entities.append(id);
+    cell.memoryBytes += entry.memoryBytes;
+}
+
+void WorldGrid::removeFromCell(const Entry& entry) {
+    auto it = m_cells.find(entry.cell);
+    if (it == m_cells.end()) {
+        return;
+    }
+
+    // Swap-remove, patching the slot of the entry that moves
+    Cell& cell = it.value();
+    EntityId last = cell.entities.last();
+    cell.entities[entry.slot] = last;
+    m_entries[last].slot = entry.slot;
+    cell.entities.removeLast();
+    cell.memoryBytes -= entry.memoryBytes;
+
+    if (cell.entities.isEmpty()) {
+        m_cells.erase(it);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef WORLD_GRID_H
+#define WORLD_GRID_H
+
+#include "types.h"
+#include <QHash>
+#include <QVector>
+#include <QVector3D>
+
+// Integer cell coordinate on the world XY plane
+struct GridCell {
+    int x = 0;
+    int y = 0;
+
+    bool operator==(const GridCell& other) const { return x == other.x && y == other.y; }
+    bool operator!=(const GridCell& other) const { return !(*this == other); }
+};
+
+inline size_t qHash(const GridCell& cell, size_t seed = 0) {
+    return qHash((quint64(quint32(cell.x)) << 32) | quint32(cell.y), seed);
+}
+
+// Sparse uniform grid over the XY plane. Only occupied cells are stored, so
+// memory follows the entity count rather than the map extent. Each entity
+// lives in the cell containing its position and carries a memory estimate
+// that is summed per cell, which makes a cell the unit for streaming and
+// per-region culling. Height is ignored.
+class WorldGrid {
+public:
+    static constexpr float DefaultCellSize = 250.0f;
+
+    explicit WorldGrid(float cellSize = DefaultCellSize);
+
+    // Changing the cell size re-buckets every entry
+    void setCellSize(float size);
+    float getCellSize() const;
+
+    GridCell cellAt(const QVector3D& position) const;
+    BoundingBox getCellBounds(const GridCell& cell) const; // Unbounded in Z
+
+    // Inserts or moves an entry; returns true if its cell changed
+    bool set(EntityId id, const QVector3D& position, qint64 memoryBytes);
+    void remove(EntityId id);
+    void clear();
+
+    bool contains(EntityId id) const;
+    GridCell getCellOf(EntityId id) const;
+    int size() const;
+
+    // Per-cell statistics; empty cells report zero
+    const QVector<EntityId>& getEntities(const GridCell& cell) const;
+    int getEntityCount(const GridCell& cell) const;
+    qint64 getMemoryUsage(const GridCell& cell) const;
+    QVector<GridCell> getOccupiedCells() const;
+    int getOccupiedCellCount() const;
+
+    // Entities in the inclusive cell range, or in the cells overlapping a
+    // box's XY extent. Results are grouped by cell, not sorted.
+    void queryCells(const GridCell& min, const GridCell& max, QVector<EntityId>& out) const;
+    void queryBox(const BoundingBox& box, QVector<EntityId>& out) const;
+    void queryNeighbourhood(const GridCell& cell, int radius, QVector<EntityId>& out) const;
+
+private:
+    struct Cell {
+        QVector<EntityId> entities;
+        qint64 memoryBytes = 0;
+    };
+
+    struct Entry {
+        GridCell cell;
+        int slot = 0; // Index into the cell's entity list
+        QVector3D position;
+        qint64 memoryBytes = 0;
+    };
+
+    void addToCell(EntityId id, Entry& entry);
+    void removeFromCell(const Entry& entry);
+
+    float m_cellSize;
+    float m_inverseCellSize;
+    QHash<GridCell, Cell> m_cells;
+    QHash<EntityId, Entry> m_entries;
+};
+
+#endif // WORLD_GRID_H
@@ -0,0 +1,292 @@
+#include "system_scheduler.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+
+namespace {
+// Set on worker threads so nested jobs go to the worker's own queue
+thread_local const JobSystem* t_owner = nullptr;
+thread_local int t_queueIndex = -1;
+}
+
+// JobSystem implementation
+JobSystem& JobSystem::instance() {
+    static JobSystem instance;
+    return instance;
+}
+
+JobSystem::JobSystem(int workerCount) {
+    if (workerCount <= 0) {
+        workerCount = qMax(1, QThread::idealThreadCount() - 1);
+    }
+
+    for (int i = 0; i <= workerCount; ++i) {
+        m_queues.push_back(new Queue());
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        m_threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+
+    qDebug() << "JobSystem: Started" << workerCount << "worker threads";
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+    for (Queue* queue : m_queues) {
+        delete queue;
+    }
+}
+
+int JobSystem::getWorkerCount() const {
+    return static_cast<int>(m_threads.size());
+}
+
+int JobSystem::getConcurrency() const {
+    return getWorkerCount() + 1;
+}
+
+void JobSystem::run(Job job, Counter& counter) {
+    counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+
+    Queue* queue = m_queues[currentQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->tasks.push_back(Task{std::move(job), &counter});
+    }
+    m_queuedTasks.fetch_add(1, std::memory_order_release);
+
+    // Take the sleep lock so a worker about to wait cannot miss the wakeup
+    { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+    m_wakeCondition.notify_one();
+}
+
+void JobSystem::wait(Counter& counter) {
+    int queue = currentQueue();
+    while (!counter.isDone()) {
+        if (!runOneTask(queue)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+int JobSystem::chunkCount(int count, int chunkSize) {
+    if (count <= 0) {
+        return 0;
+    }
+    chunkSize = qMax(1, chunkSize);
+    return (count + chunkSize - 1) / chunkSize;
+}
+
+void JobSystem::parallelFor(int count, int chunkSize, const std::function<void(int begin, int end)>& fn) {
+    chunkSize = qMax(1, chunkSize);
+    int chunks = chunkCount(count, chunkSize);
+    if (chunks == 0) {
+        return;
+    }
+    if (chunks == 1 || m_threads.empty()) {
+        for (int begin = 0; begin < count; begin += chunkSize) {
+            fn(begin, qMin(begin + chunkSize, count));
+        }
+        return;
+    }
+
+    // Queue all but the first chunk and run that one on this thread
+    Counter counter;
+    for (int chunk = 1; chunk < chunks; ++chunk) {
+        int begin = chunk * chunkSize;
+        int end = qMin(begin + chunkSize, count);
+        run([&fn, begin, end]() { fn(begin, end); }, counter);
+    }
+    fn(0, qMin(chunkSize, count));
+    wait(counter);
+}
+
+void JobSystem::workerLoop(int index) {
+    t_owner = this;
+    t_queueIndex = index;
+
+    while (true) {
+        if (runOneTask(index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wakeCondition.wait(lock, [this]() {
+            return m_stopping || m_queuedTasks.load(std::memory_order_acquire) > 0;
+        });
+        if (m_stopping && m_queuedTasks.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+int JobSystem::currentQueue() const {
+    return t_owner == this ? t_queueIndex : static_cast<int>(m_queues.size()) - 1;
+}
+
+bool JobSystem::popTask(int queue, Task& task) {
+    Queue* q = m_queues[queue];
+    std::lock_guard<std::mutex> lock(q->mutex);
+    if (q->tasks.empty()) {
+        return false;
+    }
+    task = std::move(q->tasks.back());
+    q->tasks.pop_back();
+    return true;
+}
+
+bool JobSystem::stealTask(int thief, Task& task) {
+    int count = static_cast<int>(m_queues.size());
+    for (int offset = 1; offset < count; ++offset) {
+        Queue* q = m_queues[(thief + offset) % count];
+        std::lock_guard<std::mutex> lock(q->mutex);
+        if (!q->tasks.empty()) {
+            task = std::move(q->tasks.front());
+            q->tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::runOneTask(int queue) {
+    if (m_queuedTasks.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+
+    Task task;
+    if (!popTask(queue, task) && !stealTask(queue, task)) {
+        return false;
+    }
+    m_queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+
+    task.job();
+    task.counter->m_pending.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+// SystemScheduler implementation
+SystemScheduler::SystemScheduler(JobSystem& jobs)
+    : m_jobs(jobs)
+{
+}
+
+void SystemScheduler::addSystem(Ref<System> system) {
+    if (!system) {
+        return;
+    }
+    if (getSystem(system->getName())) {
+        qWarning() << "SystemScheduler: System already registered:" << system->getName();
+        return;
+    }
+    m_systems.append(system);
+    m_stagesDirty = true;
+}
+
+void SystemScheduler::removeSystem(const QString& name) {
+    for (int i = 0; i < m_systems.size(); ++i) {
+        if (m_systems[i]->getName() == name) {
+            m_systems.removeAt(i);
+            m_stagesDirty = true;
+            return;
+        }
+    }
+}
+
+System* SystemScheduler::getSystem(const QString& name) const {
+    for (const Ref<System>& system : m_systems) {
+        if (system->getName() == name) {
+            return system.get();
+        }
+    }
+    return nullptr;
+}
+
+int SystemScheduler::getSystemCount() const {
+    return m_systems.size();
+}
+
+int SystemScheduler::getStageCount() const {
+    buildStages();
+    return m_stages.size();
+}
+
+void SystemScheduler::run() {
+    buildStages();
+    m_timings.fill(0.0, m_systems.size());
+
+    for (const QVector<int>& stage : m_stages) {
+        for (int index : stage) {
+            m_systems[index]->prepare();
+        }
+
+        if (stage.size() == 1) {
+            QElapsedTimer timer;
+            timer.start();
+            m_systems[stage.first()]->execute(m_jobs);
+            m_timings[stage.first()] = timer.nsecsElapsed() / 1.0e6;
+        } else {
+            JobSystem::Counter counter;
+            for (int index : stage) {
+                System* system = m_systems[index].get();
+                double* timing = &m_timings[index];
+                m_jobs.run([this, system, timing]() {
+                    QElapsedTimer timer;
+                    timer.start();
+                    system->execute(m_jobs);
+                    *timing = timer.nsecsElapsed() / 1.0e6;
+                }, counter);
+            }
+            m_jobs.wait(counter);
+        }
+
+        // Apply results in registration order so the outcome is deterministic
+        for (int index : stage) {
+            m_systems[index]->finish();
+        }
+    }
+}
+
+QVector<double> SystemScheduler::getLastTimings() const {
+    return m_timings;
+}
+
+bool SystemScheduler::conflicts(const System& a, const System& b) {
+    ComponentMask aTouched = a.getReadMask() | a.getWriteMask();
+    ComponentMask bTouched = b.getReadMask() | b.getWriteMask();
+    return (a.getWriteMask() & bTouched) != 0 || (b.getWriteMask() & aTouched) != 0;
+}
+
+void SystemScheduler::buildStages() const {
+    if (!m_stagesDirty) {
+        return;
+    }
+
+    // A system goes one stage after the latest earlier system it conflicts
+    // with, which keeps conflicting systems in registration order.
+    m_stages.clear();
+    QVector<int> stageOf(m_systems.size(), 0);
+    for (int i = 0; i < m_systems.size(); ++i) {
+        int stage = 0;
+        for (int j = 0; j < i; ++j) {
+            if (conflicts(*m_systems[i], *m_systems[j])) {
+                stage = qMax(stage, stageOf[j] + 1);
+            }
+        }
+        stageOf[i] = stage;
+        if (stage >= m_stages.size()) {
+            m_stages.resize(stage + 1);
+        }
+        m_stages[stage].append(i);
+    }
+
+    m_stagesDirty = false;
+}
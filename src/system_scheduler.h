@@ -0,0 +1,146 @@
+#ifndef SYSTEM_SCHEDULER_H
+#define SYSTEM_SCHEDULER_H
+
+#include "types.h"
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Bitmask over ComponentType, used to declare what a system touches
+using ComponentMask = quint32;
+
+constexpr ComponentMask componentBit(ComponentType type) {
+    return ComponentMask(1) << static_cast<int>(type);
+}
+
+// Derived scene state that is not a component but is shared between
+// systems, declared in the same masks. Bits sit above the component types.
+enum class SceneResource {
+    Bounds,       // World mesh bounds cache
+    SpatialIndex  // BVH, streaming grid and LOD table
+};
+
+constexpr ComponentMask resourceBit(SceneResource resource) {
+    return ComponentMask(1) << (16 + static_cast<int>(resource));
+}
+
+// Fixed-size worker pool with one deque per worker. Workers pop their own
+// jobs LIFO and steal from the front of other queues when idle. A thread
+// waiting on a batch keeps executing queued jobs, so jobs may themselves
+// spawn and wait on nested batches.
+class JobSystem {
+public:
+    using Job = std::function<void()>;
+
+    // Tracks completion of a batch of jobs
+    class Counter {
+    public:
+        bool isDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class JobSystem;
+        std::atomic<int> m_pending{0};
+    };
+
+    static JobSystem& instance();
+
+    // workerCount 0 picks one worker per hardware thread minus the caller
+    explicit JobSystem(int workerCount = 0);
+    ~JobSystem();
+
+    int getWorkerCount() const;
+    int getConcurrency() const; // Workers plus the calling thread
+
+    void run(Job job, Counter& counter);
+    void wait(Counter& counter);
+
+    // Calls fn(begin, end) for consecutive chunks of [0, count). Chunk
+    // boundaries only depend on count and chunkSize, never on the number of
+    // threads, so per-chunk outputs (indexed by begin / chunkSize) merged in
+    // order give the same result on any machine. Blocks until done.
+    void parallelFor(int count, int chunkSize, const std::function<void(int begin, int end)>& fn);
+    static int chunkCount(int count, int chunkSize);
+
+private:
+    Q_DISABLE_COPY(JobSystem)
+
+    struct Task {
+        Job job;
+        Counter* counter = nullptr;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(int index);
+    int currentQueue() const;
+    bool popTask(int queue, Task& task);
+    bool stealTask(int thief, Task& task);
+    bool runOneTask(int queue);
+
+    std::vector<std::thread> m_threads;
+    std::vector<Queue*> m_queues; // One per worker, the last one is shared by outside threads
+    std::atomic<int> m_queuedTasks{0};
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeCondition;
+    bool m_stopping = false;
+};
+
+// A unit of per-frame work over the entity store. prepare() and finish()
+// run on the GUI thread; execute() runs on a worker and may split its work
+// with jobs.parallelFor(), but must not touch QObjects or emit signals.
+// Results are written to system-owned buffers and applied in finish().
+class System {
+public:
+    virtual ~System() = default;
+
+    virtual QString getName() const = 0;
+    virtual ComponentMask getReadMask() const = 0;
+    virtual ComponentMask getWriteMask() const = 0;
+
+    virtual void prepare() {}
+    virtual void execute(JobSystem& jobs) = 0;
+    virtual void finish() {}
+};
+
+// Runs registered systems once per frame. Systems are grouped into stages
+// of mutually compatible access (no system writes what another one in the
+// same stage reads or writes), keeping registration order between
+// conflicting systems. Systems inside a stage execute concurrently.
+class SystemScheduler {
+public:
+    explicit SystemScheduler(JobSystem& jobs = JobSystem::instance());
+
+    void addSystem(Ref<System> system);
+    void removeSystem(const QString& name);
+    System* getSystem(const QString& name) const;
+    int getSystemCount() const;
+    int getStageCount() const;
+
+    void run();
+
+    // Wall time of each system's execute() in the last run, in registration order
+    QVector<double> getLastTimings() const;
+
+private:
+    static bool conflicts(const System& a, const System& b);
+    void buildStages() const;
+
+    JobSystem& m_jobs;
+    QVector<Ref<System>> m_systems;
+    QVector<double> m_timings;
+    
+    // Rebuilt lazily after systems are added or removed
+    mutable QVector<QVector<int>> m_stages;
+    mutable bool m_stagesDirty = true;
+};
+
+#endif // SYSTEM_SCHEDULER_H
@@ -0,0 +1,30 @@
+#include "texture_library.h"
+
+void TextureLibrary::add(const QString& name, const QVector<TXDParser::GTATexture>& textures) {
+    m_dictionaries.insert(name.toLower(), textures);
+    ++m_revision;
+}
+
+void TextureLibrary::remove(const QString& name) {
+    if (m_dictionaries.remove(name.toLower()) > 0) {
+        ++m_revision;
+    }
+}
+
+void TextureLibrary::clear() {
+    m_dictionaries.clear();
+    ++m_revision;
+}
+
+bool TextureLibrary::contains(const QString& name) const {
+    return m_dictionaries.contains(name.toLower());
+}
+
+int TextureLibrary::size() const {
+    return m_dictionaries.size();
+}
+
+const QVector<TXDParser::GTATexture>* TextureLibrary::find(const QString& name) const {
+    auto it = m_dictionaries.constFind(name.toLower());
+    return it != m_dictionaries.constEnd() ? &it.value() : nullptr;
+}
@@ -0,0 +1,31 @@
+#ifndef TEXTURE_LIBRARY_H
+#define TEXTURE_LIBRARY_H
+
+#include "txd_parser.h"
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Decoded texture dictionaries by name, the same name MeshComponent::
+// materialPath refers to. GTA matches TXD and texture names without regard
+// to case, so names are stored lower-case. The revision changes whenever a
+// dictionary is added or removed, so renderers can tell when to look again
+// for one they did not find.
+class TextureLibrary {
+public:
+    void add(const QString& name, const QVector<TXDParser::GTATexture>& textures);
+    void remove(const QString& name);
+    void clear();
+
+    bool contains(const QString& name) const;
+    int size() const;
+    const QVector<TXDParser::GTATexture>* find(const QString& name) const;
+
+    quint64 getRevision() const { return m_revision; }
+
+private:
+    QHash<QString, QVector<TXDParser::GTATexture>> m_dictionaries;
+    quint64 m_revision = 0;
+};
+
+#endif // TEXTURE_LIBRARY_H
@@ -0,0 +1,237 @@
+// Spatial index benchmark.
+//
+// Times DynamicBVH on synthetic scenes of 10k, 100k and 1M entities (or the
+// sizes given): the bulk build, refits for small moves that stay inside the
+// fattened leaves, reinserts for large moves, frustum walks from editor-like
+// cameras and closest-hit raycasts. Entities are boxes scattered over a
+// square map at a fixed density, so larger scenes are larger maps rather
+// than denser ones, as with GTA cities. The seed is fixed, so runs on one
+// machine are comparable. Reports JSON.
+//
+//   bvh_bench
+//   bvh_bench --sizes 100000 --queries 1000 --report bvh.json
+
+#include "dynamic_bvh.h"
+#include "frustum.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMatrix4x4>
+#include <QtMath>
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <random>
+
+namespace {
+const float kEntitiesPerSquareUnit = 1.0f / 400.0f; // One entity per 20x20 units
+const float kFarPlane = 1000.0f;
+
+struct Scene {
+    QVector<EntityId> ids;
+    QVector<BoundingBox> boxes;
+    float mapSize = 0.0f;
+};
+
+BoundingBox makeBox(const QVector3D& center, const QVector3D& halfSize) {
+    return BoundingBox(center - halfSize, center + halfSize);
+}
+
+// Z is up, as in GTA data
+Scene makeScene(int count, std::mt19937& random) {
+    Scene scene;
+    scene.mapSize = qSqrt(count / kEntitiesPerSquareUnit);
+    std::uniform_real_distribution<float> position(-scene.mapSize * 0.5f, scene.mapSize * 0.5f);
+    std::uniform_real_distribution<float> height(0.0f, 30.0f);
+    std::lognormal_distribution<float> extent(0.5f, 0.8f); // Mostly props, some buildings
+    scene.ids.reserve(count);
+    scene.boxes.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const QVector3D halfSize(qMin(extent(random), 60.0f), qMin(extent(random), 60.0f),
+                                 qMin(extent(random), 40.0f));
+        scene.ids.append(EntityId(i + 1));
+        scene.boxes.append(makeBox(QVector3D(position(random), position(random), height(random)), halfSize));
+    }
+    return scene;
+}
+
+// Slab test, standing in for the exact per-entity test of a real pick
+bool rayHitsBox(const QVector3D& origin, const QVector3D& direction, const BoundingBox& box, float& distance) {
+    float entry = 0.0f;
+    float exit = std::numeric_limits<float>::infinity();
+    for (int axis = 0; axis < 3; ++axis) {
+        if (qFuzzyIsNull(direction[axis])) {
+            if (origin[axis] < box.min[axis] || origin[axis] > box.max[axis]) {
+                return false;
+            }
+            continue;
+        }
+        float t0 = (box.min[axis] - origin[axis]) / direction[axis];
+        float t1 = (box.max[axis] - origin[axis]) / direction[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        entry = qMax(entry, t0);
+        exit = qMin(exit, t1);
+        if (entry > exit) {
+            return false;
+        }
+    }
+    distance = entry;
+    return true;
+}
+
+double elapsedMs(const QElapsedTimer& timer) {
+    return timer.nsecsElapsed() / 1e6;
+}
+
+QJsonObject benchmark(int count, int queries, std::mt19937& random) {
+    const Scene scene = makeScene(count, random);
+    std::uniform_real_distribution<float> position(-scene.mapSize * 0.5f, scene.mapSize * 0.5f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> pick(0, count - 1);
+    QJsonObject result;
+    result["entities"] = count;
+    result["mapSize"] = scene.mapSize;
+
+    DynamicBVH bvh;
+    QElapsedTimer timer;
+    timer.start();
+    bvh.build(scene.ids, scene.boxes);
+    result["buildMs"] = elapsedMs(timer);
+    result["height"] = bvh.getHeight();
+    result["sahCost"] = bvh.getSAHCost();
+
+    // A tenth of the scene nudged by less than the leaf margin, as when a
+    // selection is dragged a little; then a hundredth moved far away
+    const int refits = qMax(1, count / 10);
+    QVector<BoundingBox> boxes = scene.boxes;
+    int changed = 0;
+    timer.start();
+    for (int i = 0; i < refits; ++i) {
+        const int index = pick(random);
+        const QVector3D offset(unit(random) * 0.2f, unit(random) * 0.2f, 0.0f);
+        boxes[index] = BoundingBox(boxes[index].min + offset, boxes[index].max + offset);
+        changed += bvh.update(scene.ids[index], boxes[index]) ? 1 : 0;
+    }
+    const double refitMs = elapsedMs(timer);
+    result["refits"] = refits;
+    result["refitMs"] = refitMs;
+    result["refitUs"] = refitMs * 1000.0 / refits;
+    result["refitsChangingTree"] = changed;
+
+    const int reinserts = qMax(1, count / 100);
+    timer.start();
+    for (int i = 0; i < reinserts; ++i) {
+        const int index = pick(random);
+        const QVector3D halfSize = boxes[index].size() * 0.5f;
+        boxes[index] = makeBox(QVector3D(position(random), position(random), boxes[index].center().z()), halfSize);
+        bvh.update(scene.ids[index], boxes[index]);
+    }
+    const double reinsertMs = elapsedMs(timer);
+    result["reinserts"] = reinserts;
+    result["reinsertMs"] = reinsertMs;
+    result["reinsertUs"] = reinsertMs * 1000.0 / reinserts;
+    result["sahCostAfterMoves"] = bvh.getSAHCost();
+
+    // Street-level cameras looking along the ground, with the renderer's
+    // default far plane
+    QMatrix4x4 projection;
+    projection.perspective(60.0f, 16.0f / 9.0f, 0.1f, kFarPlane);
+    QVector<EntityId> visible;
+    double frustumMs = 0.0;
+    qint64 found = 0;
+    qint64 visited = 0;
+    for (int i = 0; i < queries; ++i) {
+        const QVector3D eye(position(random), position(random), 10.0f + (unit(random) + 1.0f) * 40.0f);
+        const float angle = float(M_PI) * unit(random);
+        QMatrix4x4 view;
+        view.lookAt(eye, eye + QVector3D(qCos(angle), qSin(angle), -0.2f), QVector3D(0.0f, 0.0f, 1.0f));
+        const Frustum frustum(projection * view);
+        visible.clear();
+        timer.start();
+        visited += bvh.queryFrustum(frustum, visible, eye, 1.0f);
+        frustumMs += elapsedMs(timer);
+        found += visible.size();
+    }
+    result["frustumQueries"] = queries;
+    result["frustumUs"] = frustumMs * 1000.0 / queries;
+    result["frustumResults"] = double(found) / queries;
+    result["frustumNodesVisited"] = double(visited) / queries;
+
+    // Picks: rays down from above the map at a shallow random tilt
+    double raycastMs = 0.0;
+    int hits = 0;
+    for (int i = 0; i < queries; ++i) {
+        const QVector3D origin(position(random), position(random), 500.0f);
+        const QVector3D direction = QVector3D(unit(random) * 0.3f, unit(random) * 0.3f, -1.0f).normalized();
+        timer.start();
+        EntityId hit = bvh.raycast(origin, direction, 2000.0f, [&](EntityId id, float& distance) {
+            return rayHitsBox(origin, direction, boxes[int(id) - 1], distance);
+        });
+        raycastMs += elapsedMs(timer);
+        hits += hit != 0 ? 1 : 0;
+    }
+    result["raycasts"] = queries;
+    result["raycastUs"] = raycastMs * 1000.0 / queries;
+    result["raycastHits"] = hits;
+    return result;
+}
+
+bool writeJson(const QJsonObject& object, const QString& path) {
+    const QByteArray json = QJsonDocument(object).toJson();
+    if (path.isEmpty() || path == "-") {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+        return true;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "bvh_bench: Failed to write" << path;
+        return false;
+    }
+    file.write(json);
+    return true;
+}
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("bvh_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times DynamicBVH build, refit, frustum and raycast queries on synthetic scenes.");
+    parser.addHelpOption();
+    QCommandLineOption sizesOption("sizes", "Comma-separated entity counts.", "list", "10000,100000,1000000");
+    QCommandLineOption queriesOption("queries", "Frustum walks and raycasts per size.", "count", "256");
+    QCommandLineOption seedOption("seed", "Random seed for the scenes and queries.", "value", "1");
+    QCommandLineOption reportOption("report", "Where to write the JSON report; - for stdout.", "file", "-");
+    parser.addOptions({sizesOption, queriesOption, seedOption, reportOption});
+    parser.process(app);
+
+    const int queries = parser.value(queriesOption).toInt();
+    if (queries <= 0) {
+        qCritical() << "bvh_bench: Bad --queries";
+        return 1;
+    }
+
+    QJsonArray results;
+    std::mt19937 random(parser.value(seedOption).toUInt());
+    for (const QString& size : parser.value(sizesOption).split(',')) {
+        const int count = size.trimmed().toInt();
+        if (count <= 0) {
+            qCritical() << "bvh_bench: Bad size in --sizes:" << size;
+            return 1;
+        }
+        results.append(benchmark(count, queries, random));
+    }
+
+    QJsonObject report;
+    report["queries"] = queries;
+    report["results"] = results;
+    return writeJson(report, parser.value(reportOption)) ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+// Component lookup benchmark.
+//
+// Times Entity::getComponent<T>() over a scene's worth of entities against
+// a hand-written baseline that keeps a raw pointer per component, so any
+// cost the registry adds shows up as the difference. The runtime-typed
+// getComponent(ComponentType) and the type_index hash map the registry
+// replaced are timed alongside for reference. Half the entities carry a
+// mesh, so lookups that miss are included. Each variant is run several
+// times and the fastest round is kept. Reports JSON.
+//
+//   component_bench
+//   component_bench --entities 1000000 --rounds 20 --report components.json
+
+#include "entity_system.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <typeindex>
+#include <unordered_map>
+
+namespace {
+// What the registry competes with: the component pointers as plain
+// members, one allocation away like an Entity
+struct DirectEntity {
+    TransformComponent* transform = nullptr;
+    MeshComponent* mesh = nullptr;
+};
+
+// The lookup Entity used before the registry
+using TypeIndexMap = std::unordered_map<std::type_index, Ref<Component>>;
+
+// Nanoseconds per entity of the fastest round; visit returns a value
+// folded into sink so the loads cannot be optimised away
+double timeRounds(int rounds, int count, const std::function<float()>& visit, double& sink) {
+    double best = std::numeric_limits<double>::infinity();
+    QElapsedTimer timer;
+    for (int round = 0; round < rounds; ++round) {
+        timer.start();
+        sink += visit();
+        best = qMin(best, double(timer.nsecsElapsed()));
+    }
+    return best / count;
+}
+
+bool writeJson(const QJsonObject& object, const QString& path) {
+    const QByteArray json = QJsonDocument(object).toJson();
+    if (path.isEmpty() || path == "-") {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+        return true;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "component_bench: Failed to write" << path;
+        return false;
+    }
+    file.write(json);
+    return true;
+}
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("component_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times Entity::getComponent against raw pointers and the old type_index map.");
+    parser.addHelpOption();
+    QCommandLineOption entitiesOption("entities", "Entities to look components up on.", "count", "100000");
+    QCommandLineOption roundsOption("rounds", "Passes per variant; the fastest is kept.", "count", "30");
+    QCommandLineOption reportOption("report", "Where to write the JSON report; - for stdout.", "file", "-");
+    parser.addOptions({entitiesOption, roundsOption, reportOption});
+    parser.process(app);
+
+    const int count = parser.value(entitiesOption).toInt();
+    const int rounds = parser.value(roundsOption).toInt();
+    if (count <= 0 || rounds <= 0) {
+        qCritical() << "component_bench: Bad --entities or --rounds";
+        return 1;
+    }
+
+    // The same components reached three ways
+    QVector<Entity*> entities;
+    QVector<DirectEntity*> direct;
+    QVector<TypeIndexMap*> maps;
+    entities.reserve(count);
+    direct.reserve(count);
+    maps.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        Entity* entity = new Entity(EntityId(i + 1));
+        entity->setPosition(QVector3D(float(i), 0.0f, 0.0f));
+        if (i % 2 == 0) {
+            entity->addComponent<MeshComponent>()->drawDistance = float(i % 300);
+        }
+        entities.append(entity);
+
+        DirectEntity* plain = new DirectEntity;
+        plain->transform = entity->getComponent<TransformComponent>();
+        plain->mesh = entity->getComponent<MeshComponent>();
+        direct.append(plain);
+
+        TypeIndexMap* map = new TypeIndexMap;
+        for (Component* component : entity->getAllComponents()) {
+            // Non-owning; the entity keeps the component alive
+            (*map)[std::type_index(typeid(*component))] = Ref<Component>(component, [](Component*) {});
+        }
+        maps.append(map);
+    }
+
+    double sink = 0.0;
+    const double directNs = timeRounds(rounds, count, [&]() {
+        float sum = 0.0f;
+        for (const DirectEntity* entity : direct) {
+            sum += entity->transform->transform.position.x();
+            if (entity->mesh) {
+                sum += entity->mesh->drawDistance;
+            }
+        }
+        return sum;
+    }, sink);
+    const double registryNs = timeRounds(rounds, count, [&]() {
+        float sum = 0.0f;
+        for (const Entity* entity : entities) {
+            sum += entity->getComponent<TransformComponent>()->transform.position.x();
+            if (const MeshComponent* mesh = entity->getComponent<MeshComponent>()) {
+                sum += mesh->drawDistance;
+            }
+        }
+        return sum;
+    }, sink);
+    const double runtimeNs = timeRounds(rounds, count, [&]() {
+        float sum = 0.0f;
+        for (const Entity* entity : entities) {
+            sum += static_cast<TransformComponent*>(entity->getComponent(ComponentType::Transform))
+                       ->transform.position.x();
+            if (Component* mesh = entity->getComponent(ComponentType::Mesh)) {
+                sum += static_cast<MeshComponent*>(mesh)->drawDistance;
+            }
+        }
+        return sum;
+    }, sink);
+    const double typeIndexNs = timeRounds(rounds, count, [&]() {
+        float sum = 0.0f;
+        for (const TypeIndexMap* map : maps) {
+            auto transform = map->find(std::type_index(typeid(TransformComponent)));
+            sum += static_cast<TransformComponent*>(transform->second.get())->transform.position.x();
+            auto mesh = map->find(std::type_index(typeid(MeshComponent)));
+            if (mesh != map->end()) {
+                sum += static_cast<MeshComponent*>(mesh->second.get())->drawDistance;
+            }
+        }
+        return sum;
+    }, sink);
+
+    QJsonObject report;
+    report["entities"] = count;
+    report["rounds"] = rounds;
+    report["directNs"] = directNs;
+    report["registryNs"] = registryNs;
+    report["runtimeTypeNs"] = runtimeNs;
+    report["typeIndexMapNs"] = typeIndexNs;
+    report["registryOverheadPercent"] = (registryNs / directNs - 1.0) * 100.0;
+    report["checksum"] = sink;
+
+    qDeleteAll(maps);
+    qDeleteAll(direct);
+    qDeleteAll(entities);
+    return writeJson(report, parser.value(reportOption)) ? 0 : 1;
+}
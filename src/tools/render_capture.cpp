@@ -0,0 +1,464 @@
+// Headless render benchmark and image regression check.
+//
+// Loads a scene, flies a camera along a scripted path and draws every frame
+// with SceneRenderer into an offscreen framebuffer, no window involved.
+// Reports frame time percentiles and a SHA-256 of the image at capture
+// frames, as JSON; given a reference report, exits non-zero when any
+// captured image differs.
+//
+//   render_capture --scene level.json --frames 300 --report out.json
+//   render_capture --ipl map.ipl --ide map.ide --reference ref.json
+//   render_capture --synthetic 4096 --frames 60
+//
+// The camera orbits the scene bounds unless --camera-path names a file of
+// keyframes, one per line: "frame eyeX eyeY eyeZ targetX targetY targetZ",
+// with # comments, in scene coordinates (Z up). The camera moves linearly
+// between keyframes.
+//
+// Any Qt platform plugin that can create an OpenGL 3.3 core context works.
+// On CI without a GPU, Mesa's llvmpipe gives reproducible images:
+//
+//   LIBGL_ALWAYS_SOFTWARE=1 QT_QPA_PLATFORM=offscreen render_capture ...
+//
+// (or under xvfb-run where the offscreen plugin was built without GL).
+// Hashes are only comparable between runs on the same Mesa version, so
+// references are regenerated with --write-reference when it changes.
+
+#include "scene_manager.h"
+#include "scene_renderer.h"
+#include "entity_system.h"
+#include "math_utils.h"
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QSurfaceFormat>
+#include <QTextStream>
+#include <QtMath>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+const int kMaxSettleFrames = 64;
+
+struct Keyframe {
+    int frame;
+    QVector3D eye;
+    QVector3D target;
+};
+
+struct FrameTimes {
+    QVector<double> cpuMs;   // render() returning
+    QVector<double> totalMs; // Until glFinish() returns, so GPU work included
+};
+
+bool loadCameraPath(const QString& path, QVector<Keyframe>& keys) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "render_capture: Failed to open camera path:" << path;
+        return false;
+    }
+    QTextStream stream(&file);
+    int lineNumber = 0;
+    while (!stream.atEnd()) {
+        const QString line = stream.readLine().section('#', 0, 0).trimmed();
+        ++lineNumber;
+        if (line.isEmpty()) {
+            continue;
+        }
+        const QStringList fields = line.simplified().split(' ');
+        bool ok = fields.size() == 7;
+        float values[6] = {};
+        int frame = ok ? fields[0].toInt(&ok) : 0;
+        for (int i = 0; ok && i < 6; ++i) {
+            values[i] = fields[i + 1].toFloat(&ok);
+        }
+        if (!ok) {
+            qWarning() << "render_capture: Bad keyframe at" << path << "line" << lineNumber;
+            return false;
+        }
+        keys.append(Keyframe{frame, QVector3D(values[0], values[1], values[2]),
+                             QVector3D(values[3], values[4], values[5])});
+    }
+    std::sort(keys.begin(), keys.end(), [](const Keyframe& a, const Keyframe& b) {
+        return a.frame < b.frame;
+    });
+    return !keys.isEmpty();
+}
+
+BoundingBox getSceneBounds(const SceneManager& scene) {
+    bool any = false;
+    BoundingBox bounds;
+    for (Entity* entity : scene.getAllEntities()) {
+        if (!entity) {
+            continue;
+        }
+        BoundingBox box;
+        if (!scene.getWorldBounds(entity->getId(), box)) {
+            const QVector3D position = scene.getWorldMatrix(entity->getId()).column(3).toVector3D();
+            box = BoundingBox(position, position);
+        }
+        if (!any) {
+            bounds = box;
+            any = true;
+        } else {
+            bounds = BoundingBox(QVector3D(qMin(bounds.min.x(), box.min.x()), qMin(bounds.min.y(), box.min.y()),
+                                           qMin(bounds.min.z(), box.min.z())),
+                                 QVector3D(qMax(bounds.max.x(), box.max.x()), qMax(bounds.max.y(), box.max.y()),
+                                           qMax(bounds.max.z(), box.max.z())));
+        }
+    }
+    return bounds;
+}
+
+// A square grid of boxes on the XY ground plane whose model is never
+// loaded, so each draws as the placeholder cube: a scene for CI that needs
+// no game data
+void addSyntheticScene(SceneManager& scene, int count) {
+    const int side = qMax(1, qCeil(qSqrt(double(count))));
+    const float spacing = 4.0f;
+    for (int i = 0; i < count; ++i) {
+        Entity* entity = scene.createEntity(QString("Synthetic_%1").arg(i));
+        if (!entity) {
+            continue;
+        }
+        const float height = float((i * 7) % 5);
+        entity->setPosition(QVector3D((i % side - side / 2) * spacing, (i / side - side / 2) * spacing, height));
+        MeshComponent* meshComp = entity->addComponent<MeshComponent>();
+        meshComp->meshPath = "synthetic_box";
+        meshComp->boundingBox = BoundingBox(QVector3D(-1.0f, -1.0f, -1.0f), QVector3D(1.0f, 1.0f, 1.0f));
+    }
+}
+
+// One turn around the bounds, looking at their centre from above
+QVector<Keyframe> makeOrbit(const BoundingBox& bounds, int frames) {
+    const QVector3D center = bounds.center();
+    const float radius = qMax(10.0f, bounds.size().length() * 0.6f);
+    const int steps = 16;
+    QVector<Keyframe> keys;
+    for (int i = 0; i <= steps; ++i) {
+        const float angle = 2.0f * float(M_PI) * i / steps;
+        const QVector3D eye = center + QVector3D(qCos(angle) * radius, qSin(angle) * radius, radius * 0.35f);
+        keys.append(Keyframe{(frames - 1) * i / steps, eye, center});
+    }
+    return keys;
+}
+
+SceneRenderer::View getView(const QVector<Keyframe>& keys, int frame, float aspectRatio, float farPlane) {
+    // Hold the ends, interpolate between
+    auto next = std::lower_bound(keys.begin(), keys.end(), frame, [](const Keyframe& key, int f) {
+        return key.frame < f;
+    });
+    QVector3D eye, target;
+    if (next == keys.begin()) {
+        eye = next->eye;
+        target = next->target;
+    } else if (next == keys.end()) {
+        eye = keys.last().eye;
+        target = keys.last().target;
+    } else {
+        const Keyframe& previous = *(next - 1);
+        const float t = float(frame - previous.frame) / float(qMax(1, next->frame - previous.frame));
+        eye = previous.eye + (next->eye - previous.eye) * t;
+        target = previous.target + (next->target - previous.target) * t;
+    }
+
+    SceneRenderer::View view;
+    view.aspectRatio = aspectRatio;
+    view.farPlane = farPlane;
+    view.eye = eye;
+    view.view = MathUtils::lookAt(eye, target, WorldUp);
+    view.projection = MathUtils::perspective(view.fieldOfView, aspectRatio, view.nearPlane, farPlane);
+    return view;
+}
+
+// Nearest rank on sorted samples
+double percentile(const QVector<double>& sorted, double p) {
+    if (sorted.isEmpty()) {
+        return 0.0;
+    }
+    const int rank = qBound(0, int(std::ceil(p / 100.0 * sorted.size())) - 1, sorted.size() - 1);
+    return sorted[rank];
+}
+
+QJsonObject summarize(QVector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    double total = 0.0;
+    for (double sample : samples) {
+        total += sample;
+    }
+    QJsonObject summary;
+    summary["mean"] = samples.isEmpty() ? 0.0 : total / samples.size();
+    summary["p50"] = percentile(samples, 50.0);
+    summary["p90"] = percentile(samples, 90.0);
+    summary["p99"] = percentile(samples, 99.0);
+    summary["max"] = samples.isEmpty() ? 0.0 : samples.last();
+    return summary;
+}
+
+// Over the pixels only, row by row, so padding never enters the hash
+QString hashImage(const QImage& image) {
+    const QImage pixels = image.convertToFormat(QImage::Format_RGBA8888);
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    const int rowBytes = pixels.width() * 4;
+    for (int y = 0; y < pixels.height(); ++y) {
+        hash.addData(QByteArrayView(reinterpret_cast<const char*>(pixels.constScanLine(y)), rowBytes));
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+// Captures whose hash differs from, or is missing in, the reference
+int compareWithReference(const QJsonArray& captures, const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "render_capture: Failed to open reference:" << path;
+        return -1;
+    }
+    const QJsonArray expected = QJsonDocument::fromJson(file.readAll()).object().value("captures").toArray();
+    QHash<int, QString> expectedHashes;
+    for (const QJsonValue& capture : expected) {
+        expectedHashes.insert(capture["frame"].toInt(), capture["sha256"].toString());
+    }
+
+    int mismatches = 0;
+    for (const QJsonValue& capture : captures) {
+        const int frame = capture["frame"].toInt();
+        const QString actual = capture["sha256"].toString();
+        const QString wanted = expectedHashes.value(frame);
+        if (wanted != actual) {
+            std::fprintf(stderr, "frame %d: expected %s, got %s\n", frame,
+                         wanted.isEmpty() ? "(none)" : qPrintable(wanted), qPrintable(actual));
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+bool writeJson(const QJsonObject& object, const QString& path) {
+    const QByteArray json = QJsonDocument(object).toJson();
+    if (path.isEmpty() || path == "-") {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+        return true;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "render_capture: Failed to write" << path;
+        return false;
+    }
+    file.write(json);
+    return true;
+}
+}
+
+int main(int argc, char* argv[]) {
+    QGuiApplication app(argc, argv);
+    app.setApplicationName("render_capture");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders a scene offscreen along a camera path, timing frames and hashing images.");
+    parser.addHelpOption();
+    QCommandLineOption sceneOption("scene", "Editor scene (JSON) to load.", "file");
+    QCommandLineOption iplOption("ipl", "IPL placements to load, with --ide.", "file");
+    QCommandLineOption ideOption("ide", "IDE definitions for --ipl.", "file");
+    QCommandLineOption txdOption("txd", "Texture dictionary to load; repeatable.", "file");
+    QCommandLineOption pathsOption("paths", "Path node DAT file to load; repeatable.", "file");
+    QCommandLineOption syntheticOption("synthetic", "Add a grid of this many placeholder boxes.", "count");
+    QCommandLineOption cameraPathOption("camera-path", "Keyframe file; default orbits the scene.", "file");
+    QCommandLineOption sizeOption("size", "Framebuffer size.", "WxH", "1280x720");
+    QCommandLineOption framesOption("frames", "Frames to time.", "count", "300");
+    QCommandLineOption warmupOption("warmup", "Untimed frames drawn first.", "count", "10");
+    QCommandLineOption captureOption("capture-every", "Hash every Nth frame, and the last.", "count", "60");
+    QCommandLineOption reportOption("report", "Where to write the JSON report; - for stdout.", "file", "-");
+    QCommandLineOption referenceOption("reference", "Report to compare image hashes against.", "file");
+    QCommandLineOption writeReferenceOption("write-reference", "Also write the report here, as a new reference.", "file");
+    QCommandLineOption imagesOption("save-images", "Directory to save captured frames to.", "dir");
+    QCommandLineOption noGridOption("no-grid", "Do not draw the ground grid.");
+    QCommandLineOption noOcclusionOption("no-occlusion", "Disable occlusion culling.");
+    QCommandLineOption wireframeOption("wireframe", "Draw in wireframe.");
+    parser.addOptions({sceneOption, iplOption, ideOption, txdOption, pathsOption, syntheticOption, cameraPathOption,
+                       sizeOption, framesOption, warmupOption, captureOption, reportOption, referenceOption,
+                       writeReferenceOption, imagesOption, noGridOption, noOcclusionOption, wireframeOption});
+    parser.process(app);
+
+    const QStringList size = parser.value(sizeOption).split('x');
+    const int width = size.size() == 2 ? size[0].toInt() : 0;
+    const int height = size.size() == 2 ? size[1].toInt() : 0;
+    const int frames = parser.value(framesOption).toInt();
+    const int warmup = qMax(0, parser.value(warmupOption).toInt());
+    const int captureEvery = parser.value(captureOption).toInt();
+    if (width <= 0 || height <= 0 || frames <= 0) {
+        qCritical() << "render_capture: Bad --size or --frames";
+        return 1;
+    }
+
+    // Scene
+    SceneManager& scene = SceneManager::instance();
+    scene.newScene();
+    bool loaded = true;
+    if (parser.isSet(sceneOption)) {
+        loaded &= scene.loadScene(parser.value(sceneOption));
+    }
+    if (parser.isSet(iplOption) || parser.isSet(ideOption)) {
+        loaded &= scene.loadGTAMap(parser.value(iplOption), parser.value(ideOption));
+    }
+    for (const QString& txd : parser.values(txdOption)) {
+        loaded &= scene.loadTextureDictionary(txd);
+    }
+    for (const QString& paths : parser.values(pathsOption)) {
+        loaded &= scene.loadPathFile(paths);
+    }
+    if (parser.isSet(syntheticOption)) {
+        addSyntheticScene(scene, parser.value(syntheticOption).toInt());
+    }
+    if (!loaded) {
+        qCritical() << "render_capture: Failed to load the scene";
+        return 1;
+    }
+
+    const BoundingBox bounds = getSceneBounds(scene);
+    QVector<Keyframe> keys;
+    if (parser.isSet(cameraPathOption)) {
+        if (!loadCameraPath(parser.value(cameraPathOption), keys)) {
+            return 1;
+        }
+    } else {
+        keys = makeOrbit(bounds, frames);
+    }
+    const float farPlane = qMax(1000.0f, bounds.size().length() * 2.0f);
+    const float aspectRatio = float(width) / float(height);
+
+    // Context on an offscreen surface, drawing into a single-sampled FBO
+    // so images do not depend on the driver's resolve
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setDepthBufferSize(24);
+    QOpenGLContext context;
+    context.setFormat(format);
+    if (!context.create()) {
+        qCritical() << "render_capture: Failed to create an OpenGL 3.3 core context";
+        return 1;
+    }
+    QOffscreenSurface surface;
+    surface.setFormat(context.format());
+    surface.create();
+    if (!surface.isValid() || !context.makeCurrent(&surface)) {
+        qCritical() << "render_capture: Failed to make the offscreen surface current";
+        return 1;
+    }
+    QOpenGLExtraFunctions* gl = context.extraFunctions();
+    const QString rendererName = reinterpret_cast<const char*>(gl->glGetString(GL_RENDERER));
+    qDebug() << "render_capture: Rendering on" << rendererName;
+
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    fboFormat.setInternalTextureFormat(GL_RGBA8);
+    QOpenGLFramebufferObject fbo(width, height, fboFormat);
+    if (!fbo.isValid()) {
+        qCritical() << "render_capture: Failed to create the framebuffer";
+        return 1;
+    }
+
+    SceneRenderer renderer(scene);
+    renderer.setShowGrid(!parser.isSet(noGridOption));
+    renderer.setOcclusionCullingEnabled(!parser.isSet(noOcclusionOption));
+    renderer.setWireframe(parser.isSet(wireframeOption));
+    renderer.initialize();
+    renderer.setTarget(fbo.handle(), width, height);
+
+    for (int i = 0; i < warmup; ++i) {
+        renderer.render(getView(keys, 0, aspectRatio, farPlane));
+        scene.advanceFrame();
+    }
+    gl->glFinish();
+
+    const QString imageDir = parser.value(imagesOption);
+    if (!imageDir.isEmpty()) {
+        QDir().mkpath(imageDir);
+    }
+
+    FrameTimes times;
+    times.cpuMs.reserve(frames);
+    times.totalMs.reserve(frames);
+    QJsonArray captures;
+    QElapsedTimer clock;
+    for (int frame = 0; frame < frames; ++frame) {
+        const SceneRenderer::View view = getView(keys, frame, aspectRatio, farPlane);
+        clock.start();
+        renderer.render(view);
+        times.cpuMs.append(clock.nsecsElapsed() / 1e6);
+        gl->glFinish();
+        times.totalMs.append(clock.nsecsElapsed() / 1e6);
+        scene.advanceFrame();
+
+        const bool capture = frame == frames - 1 || (captureEvery > 0 && frame % captureEvery == 0);
+        if (!capture) {
+            continue;
+        }
+
+        // Untimed: draw again until streaming and the frame-ahead culling
+        // have caught up, so the image does not depend on upload timing
+        for (int settle = 0; renderer.needsAnotherFrame() && settle < kMaxSettleFrames; ++settle) {
+            renderer.render(view);
+            scene.advanceFrame();
+        }
+        const QImage image = fbo.toImage();
+        QJsonObject entry;
+        entry["frame"] = frame;
+        entry["sha256"] = hashImage(image);
+        captures.append(entry);
+        if (!imageDir.isEmpty()) {
+            image.save(QDir(imageDir).filePath(QString("frame_%1.png").arg(frame, 4, 10, QChar('0'))));
+        }
+    }
+
+    const SceneRenderer::FrameStats& stats = renderer.getFrameStats();
+    QJsonObject lastFrame;
+    lastFrame["totalObjects"] = stats.totalObjects;
+    lastFrame["visibleObjects"] = stats.visibleObjects;
+    lastFrame["drawCalls"] = stats.drawCalls;
+    lastFrame["residentMeshes"] = stats.residentMeshes;
+
+    QJsonObject report;
+    report["renderer"] = rendererName;
+    report["width"] = width;
+    report["height"] = height;
+    report["frames"] = frames;
+    report["entities"] = scene.getAllEntities().size();
+    report["cpuMs"] = summarize(times.cpuMs);
+    report["frameMs"] = summarize(times.totalMs);
+    report["lastFrame"] = lastFrame;
+    report["captures"] = captures;
+
+    renderer.destroy();
+    context.doneCurrent();
+
+    if (!writeJson(report, parser.value(reportOption))) {
+        return 1;
+    }
+    if (parser.isSet(writeReferenceOption) && !writeJson(report, parser.value(writeReferenceOption))) {
+        return 1;
+    }
+    if (parser.isSet(referenceOption)) {
+        const int mismatches = compareWithReference(captures, parser.value(referenceOption));
+        if (mismatches < 0) {
+            return 1;
+        }
+        if (mismatches > 0) {
+            std::fprintf(stderr, "render_capture: %d captured frame(s) differ from the reference\n", mismatches);
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,357 @@
+#include "transform_hierarchy.h"
+#include "system_scheduler.h"
+#include <algorithm>
+
+namespace {
+const QMatrix4x4 kIdentityMatrix;
+}
+
+void TransformHierarchy::addNode(EntityId id, const Transform& local) {
+    if (m_slots.contains(id)) {
+        setLocalTransform(id, local);
+        return;
+    }
+
+    int slot = m_ids.size();
+    m_slots.insert(id, slot);
+    m_ids.append(id);
+    m_parents.append(-1);
+    m_children.append(QVector<int>());
+    m_depths.append(0);
+    m_localTransforms.append(local);
+    m_localMatrices.append(QMatrix4x4());
+    m_worldMatrices.append(QMatrix4x4());
+    m_dirty.append(0);
+
+    markSlotDirty(slot);
+}
+
+void TransformHierarchy::removeNode(EntityId id) {
+    int slot = slotOf(id);
+    if (slot < 0) {
+        return;
+    }
+
+    // Children are handed over to the removed node's parent
+    int parent = m_parents[slot];
+    const QVector<int> children = m_children[slot];
+    for (int child : children) {
+        m_parents[child] = parent;
+        if (parent >= 0) {
+            m_children[parent].append(child);
+        }
+        updateDepths(child);
+        markSlotDirty(child);
+    }
+    m_children[slot].clear();
+    detachFromParent(slot);
+
+    if (m_dirty[slot]) {
+        m_dirtyRoots.removeAll(slot);
+    }
+
+    // Swap the last node into the freed slot to keep the arrays dense
+    int last = m_ids.size() - 1;
+    if (slot != last) {
+        m_ids[slot] = m_ids[last];
+        m_parents[slot] = m_parents[last];
+        m_children[slot] = m_children[last];
+        m_depths[slot] = m_depths[last];
+        m_localTransforms[slot] = m_localTransforms[last];
+        m_localMatrices[slot] = m_localMatrices[last];
+        m_worldMatrices[slot] = m_worldMatrices[last];
+        m_dirty[slot] = m_dirty[last];
+
+        m_slots[m_ids[slot]] = slot;
+        if (m_parents[slot] >= 0) {
+            QVector<int>& siblings = m_children[m_parents[slot]];
+            siblings[siblings.indexOf(last)] = slot;
+        }
+        for (int child : m_children[slot]) {
+            m_parents[child] = slot;
+        }
+        if (m_dirty[slot]) {
+            m_dirtyRoots[m_dirtyRoots.indexOf(last)] = slot;
+        }
+    }
+
+    m_ids.removeLast();
+    m_parents.removeLast();
+    m_children.removeLast();
+    m_depths.removeLast();
+    m_localTransforms.removeLast();
+    m_localMatrices.removeLast();
+    m_worldMatrices.removeLast();
+    m_dirty.removeLast();
+    m_slots.remove(id);
+}
+
+void TransformHierarchy::clear() {
+    m_slots.clear();
+    m_ids.clear();
+    m_parents.clear();
+    m_children.clear();
+    m_depths.clear();
+    m_localTransforms.clear();
+    m_localMatrices.clear();
+    m_worldMatrices.clear();
+    m_dirty.clear();
+    m_dirtyRoots.clear();
+    m_lastUpdated.clear();
+}
+
+bool TransformHierarchy::contains(EntityId id) const {
+    return m_slots.contains(id);
+}
+
+int TransformHierarchy::size() const {
+    return m_ids.size();
+}
+
+bool TransformHierarchy::setParent(EntityId id, EntityId parentId) {
+    int slot = slotOf(id);
+    if (slot < 0) {
+        return false;
+    }
+
+    int parent = -1;
+    if (parentId != 0) {
+        parent = slotOf(parentId);
+        if (parent < 0 || parent == slot) {
+            return false;
+        }
+        // Reject cycles: the new parent must not live in this node's subtree
+        for (int p = parent; p >= 0; p = m_parents[p]) {
+            if (p == slot) {
+                return false;
+            }
+        }
+    }
+
+    if (m_parents[slot] == parent) {
+        return true;
+    }
+
+    detachFromParent(slot);
+    m_parents[slot] = parent;
+    if (parent >= 0) {
+        m_children[parent].append(slot);
+    }
+    updateDepths(slot);
+    markSlotDirty(slot);
+    return true;
+}
+
+EntityId TransformHierarchy::getParent(EntityId id) const {
+    int slot = slotOf(id);
+    if (slot < 0 || m_parents[slot] < 0) {
+        return 0;
+    }
+    return m_ids[m_parents[slot]];
+}
+
+QVector<EntityId> TransformHierarchy::getChildren(EntityId id) const {
+    QVector<EntityId> result;
+    int slot = slotOf(id);
+    if (slot >= 0) {
+        result.reserve(m_children[slot].size());
+        for (int child : m_children[slot]) {
+            result.append(m_ids[child]);
+        }
+    }
+    return result;
+}
+
+bool TransformHierarchy::isAncestor(EntityId ancestorId, EntityId id) const {
+    int ancestor = slotOf(ancestorId);
+    int slot = slotOf(id);
+    if (ancestor < 0 || slot < 0) {
+        return false;
+    }
+    for (int p = m_parents[slot]; p >= 0; p = m_parents[p]) {
+        if (p == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransformHierarchy::setLocalTransform(EntityId id, const Transform& local) {
+    int slot = slotOf(id);
+    if (slot >= 0) {
+        m_localTransforms[slot] = local;
+        markSlotDirty(slot);
+    }
+}
+
+void TransformHierarchy::markDirty(EntityId id) {
+    int slot = slotOf(id);
+    if (slot >= 0) {
+        markSlotDirty(slot);
+    }
+}
+
+bool TransformHierarchy::hasPendingUpdates() const {
+    return !m_dirtyRoots.isEmpty();
+}
+
+int TransformHierarchy::update(JobSystem* jobs) {
+    m_lastUpdated.clear();
+    if (m_dirtyRoots.isEmpty()) {
+        return 0;
+    }
+    
+    collectDirtySubtrees();
+    
+    if (jobs && jobs->getWorkerCount() > 0 && m_queue.size() >= ParallelThreshold) {
+        refreshLevels(*jobs);
+    } else {
+        // Breadth-first order already puts parents before their children
+        for (int slot : m_queue) {
+            refreshSlot(slot);
+        }
+    }
+    
+    m_lastUpdated.reserve(m_queue.size());
+    for (int slot : m_queue) {
+        m_lastUpdated.append(m_ids[slot]);
+    }
+    
+    m_dirtyRoots.clear();
+    return m_lastUpdated.size();
+}
+
+void TransformHierarchy::collectDirtySubtrees() {
+    // Shallow nodes first, so a dirty node below another dirty node is
+    // gathered as part of its ancestor's subtree and then skipped.
+    std::sort(m_dirtyRoots.begin(), m_dirtyRoots.end(), [this](int a, int b) {
+        return m_depths[a] < m_depths[b];
+    });
+    
+    // Dirty flag 1 = local changed, 2 = local changed and already gathered
+    m_queue.clear();
+    for (int root : m_dirtyRoots) {
+        if (m_dirty[root] != 1) {
+            continue;
+        }
+        
+        int start = m_queue.size();
+        m_queue.append(root);
+        for (int i = start; i < m_queue.size(); ++i) {
+            int slot = m_queue[i];
+            if (m_dirty[slot]) {
+                m_dirty[slot] = 2;
+            }
+            for (int child : m_children[slot]) {
+                m_queue.append(child);
+            }
+        }
+    }
+}
+
+void TransformHierarchy::refreshSlot(int slot) {
+    if (m_dirty[slot]) {
+        m_localMatrices[slot] = m_localTransforms[slot].getMatrix();
+        m_dirty[slot] = 0;
+    }
+    
+    int parent = m_parents[slot];
+    m_worldMatrices[slot] = parent >= 0
+        ? m_worldMatrices[parent] * m_localMatrices[slot]
+        : m_localMatrices[slot];
+}
+
+void TransformHierarchy::refreshLevels(JobSystem& jobs) {
+    // Bucket the gathered slots by depth (counting sort); every node of a
+    // level only reads its parent's world matrix from the previous level.
+    int maxDepth = 0;
+    for (int slot : m_queue) {
+        maxDepth = qMax(maxDepth, m_depths[slot]);
+    }
+    
+    m_levelStarts.fill(0, maxDepth + 2);
+    for (int slot : m_queue) {
+        ++m_levelStarts[m_depths[slot] + 1];
+    }
+    for (int depth = 1; depth < m_levelStarts.size(); ++depth) {
+        m_levelStarts[depth] += m_levelStarts[depth - 1];
+    }
+    
+    m_levelSlots.resize(m_queue.size());
+    QVector<int> cursor = m_levelStarts;
+    for (int slot : m_queue) {
+        m_levelSlots[cursor[m_depths[slot]]++] = slot;
+    }
+    
+    // Raw pointers so worker threads never trigger a container detach
+    const int* levelSlots = m_levelSlots.constData();
+    const int* parents = m_parents.constData();
+    const Transform* locals = m_localTransforms.constData();
+    quint8* dirty = m_dirty.data();
+    QMatrix4x4* localMatrices = m_localMatrices.data();
+    QMatrix4x4* worldMatrices = m_worldMatrices.data();
+    
+    for (int depth = 0; depth <= maxDepth; ++depth) {
+        int levelBegin = m_levelStarts[depth];
+        int levelSize = m_levelStarts[depth + 1] - levelBegin;
+        jobs.parallelFor(levelSize, ParallelChunkSize, [=](int begin, int end) {
+            for (int i = levelBegin + begin; i < levelBegin + end; ++i) {
+                int slot = levelSlots[i];
+                if (dirty[slot]) {
+                    localMatrices[slot] = locals[slot].getMatrix();
+                    dirty[slot] = 0;
+                }
+                int parent = parents[slot];
+                worldMatrices[slot] = parent >= 0
+                    ? worldMatrices[parent] * localMatrices[slot]
+                    : localMatrices[slot];
+            }
+        });
+    }
+}
+
+const QVector<EntityId>& TransformHierarchy::getLastUpdated() const {
+    return m_lastUpdated;
+}
+
+const QMatrix4x4& TransformHierarchy::getLocalMatrix(EntityId id) const {
+    int slot = slotOf(id);
+    return slot >= 0 ? m_localMatrices[slot] : kIdentityMatrix;
+}
+
+const QMatrix4x4& TransformHierarchy::getWorldMatrix(EntityId id) const {
+    int slot = slotOf(id);
+    return slot >= 0 ? m_worldMatrices[slot] : kIdentityMatrix;
+}
+
+int TransformHierarchy::slotOf(EntityId id) const {
+    return m_slots.value(id, -1);
+}
+
+void TransformHierarchy::markSlotDirty(int slot) {
+    if (!m_dirty[slot]) {
+        m_dirty[slot] = 1;
+        m_dirtyRoots.append(slot);
+    }
+}
+
+void TransformHierarchy::updateDepths(int slot) {
+    m_queue.clear();
+    m_queue.append(slot);
+    for (int i = 0; i < m_queue.size(); ++i) {
+        int current = m_queue[i];
+        int parent = m_parents[current];
+        m_depths[current] = parent >= 0 ? m_depths[parent] + 1 : 0;
+        for (int child : m_children[current]) {
+            m_queue.append(child);
+        }
+    }
+}
+
+void TransformHierarchy::detachFromParent(int slot) {
+    int parent = m_parents[slot];
+    if (parent >= 0) {
+        m_children[parent].removeOne(slot);
+    }
+    m_parents[slot] = -1;
+}
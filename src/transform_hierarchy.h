@@ -0,0 +1,79 @@
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include "types.h"
+#include <QHash>
+#include <QVector>
+#include <QMatrix4x4>
+
+class JobSystem;
+
+// Parent/child transform graph with cached local and world matrices.
+// Nodes are stored in dense, parallel arrays indexed by slot; the EntityId to
+// slot mapping is kept in m_slots. Changing a node only flags it dirty, and
+// update() recomputes the world matrices of dirty subtrees breadth-first.
+class TransformHierarchy {
+public:
+    TransformHierarchy() = default;
+
+    // Node management
+    void addNode(EntityId id, const Transform& local);
+    void removeNode(EntityId id);
+    void clear();
+    bool contains(EntityId id) const;
+    int size() const;
+
+    // Parenting (parent 0 means root). Fails if it would create a cycle.
+    bool setParent(EntityId id, EntityId parentId);
+    EntityId getParent(EntityId id) const;
+    QVector<EntityId> getChildren(EntityId id) const;
+    bool isAncestor(EntityId ancestorId, EntityId id) const;
+
+    // Local transform changes
+    void setLocalTransform(EntityId id, const Transform& local);
+    void markDirty(EntityId id);
+    bool hasPendingUpdates() const;
+
+    // Recompute world matrices of all dirty subtrees. Returns the number of
+    // nodes whose world matrix was rebuilt. With a job system, large updates
+    // are processed one depth level at a time, each level in parallel.
+    int update(JobSystem* jobs = nullptr);
+    const QVector<EntityId>& getLastUpdated() const;
+
+    // Cached matrices (identity for unknown ids)
+    const QMatrix4x4& getLocalMatrix(EntityId id) const;
+    const QMatrix4x4& getWorldMatrix(EntityId id) const;
+
+private:
+    int slotOf(EntityId id) const;
+    void markSlotDirty(int slot);
+    void updateDepths(int slot);
+    void detachFromParent(int slot);
+    void collectDirtySubtrees();
+    void refreshSlot(int slot);
+    void refreshLevels(JobSystem& jobs);
+
+    // Dense node storage
+    QHash<EntityId, int> m_slots;
+    QVector<EntityId> m_ids;
+    QVector<int> m_parents;          // Parent slot, -1 for roots
+    QVector<QVector<int>> m_children;
+    QVector<int> m_depths;
+    QVector<Transform> m_localTransforms;
+    QVector<QMatrix4x4> m_localMatrices;
+    QVector<QMatrix4x4> m_worldMatrices;
+    QVector<quint8> m_dirty;
+
+    // Slots flagged since the last update
+    QVector<int> m_dirtyRoots;
+    QVector<EntityId> m_lastUpdated;
+    QVector<int> m_queue;
+    QVector<int> m_levelStarts;
+    QVector<int> m_levelSlots;
+    
+    // Below this many nodes the parallel path costs more than it saves
+    static const int ParallelThreshold = 4096;
+    static const int ParallelChunkSize = 512;
+};
+
+#endif // TRANSFORM_HIERARCHY_H
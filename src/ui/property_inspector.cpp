@@ -98,14 +98,12 @@ void PropertyInspector::refreshProperties() {
     m_updatingProperties = false;
 }
 
-void PropertyInspector::onSelectionChanged(const QVector<EntityId>& selectedIds) {
-    if (selectedIds.isEmpty()) {
-        setSelectedEntity(nullptr);
-    } else {
-        // Show properties for the first selected entity
-        Entity* entity = m_sceneManager->getEntity(selectedIds.first());
-        setSelectedEntity(entity);
-    }
+void PropertyInspector::onSelectionChanged(const QVector<EntityId>& added, const QVector<EntityId>& removed) {
+    // Only the primary selection is shown, so the panel is rebuilt only
+    // when that changes rather than on every delta
+    Q_UNUSED(added)
+    Q_UNUSED(removed)
+    setSelectedEntity(m_sceneManager->getPrimarySelection());
 }
 
 void PropertyInspector::onEntityPropertyChanged() {
@@ -120,11 +118,13 @@ void PropertyInspector::onEntityPropertyChanged() {
     }
 }
 
-void PropertyInspector::onComponentPropertyChanged() {
+void PropertyInspector::onComponentPropertyChanged(ComponentType type) {
     if (m_updatingProperties || !m_currentEntity) {
         return;
     }
     
+    m_currentEntity->markComponentChanged(type);
+    
     // Property changes are handled by individual component widgets
     // This is called when any component property changes
     emit propertyChanged(m_currentEntity->getId(), "component", QVariant());
@@ -143,25 +143,8 @@ void PropertyInspector::onAddComponentClicked() {
     ComponentType type = static_cast<ComponentType>(m_componentTypeCombo->currentData().toInt());
     
     // Check if component already exists
-    switch (type) {
-        case ComponentType::Transform:
-            if (m_currentEntity->hasComponent<TransformComponent>()) return;
-            m_currentEntity->addComponent<TransformComponent>();
-            break;
-        case ComponentType::Mesh:
-            if (m_currentEntity->hasComponent<MeshComponent>()) return;
-            m_currentEntity->addComponent<MeshComponent>();
-            break;
-        case ComponentType::Light:
-            if (m_currentEntity->hasComponent<LightComponent>()) return;
-            m_currentEntity->addComponent<LightComponent>();
-            break;
-        case ComponentType::Script:
-            if (m_currentEntity->hasComponent<ScriptComponent>()) return;
-            m_currentEntity->addComponent<ScriptComponent>();
-            break;
-        default:
-            return;
+    if (m_currentEntity->hasComponent(type) || !m_currentEntity->addComponent(type)) {
+        return;
     }
     
     emit componentAdded(m_currentEntity->getId(), type);
@@ -181,19 +164,10 @@ void PropertyInspector::onRemoveComponentClicked() {
         return;
     }
     
-    switch (type) {
-        case ComponentType::Mesh:
-            m_currentEntity->removeComponent<MeshComponent>();
-            break;
-        case ComponentType::Light:
-            m_currentEntity->removeComponent<LightComponent>();
-            break;
-        case ComponentType::Script:
-            m_currentEntity->removeComponent<ScriptComponent>();
-            break;
-        default:
-            return;
+    if (!m_currentEntity->hasComponent(type)) {
+        return;
     }
+    m_currentEntity->removeComponent(type);
     
     emit componentRemoved(m_currentEntity->getId(), type);
     refreshProperties();
@@ -322,9 +296,12 @@ void PropertyInspector::createAddComponentSection() {
     QHBoxLayout* addLayout = new QHBoxLayout(m_addComponentGroup);
     
     m_componentTypeCombo = new QComboBox();
-    m_componentTypeCombo->addItem("Mesh", static_cast<int>(ComponentType::Mesh));
-    m_componentTypeCombo->addItem("Light", static_cast<int>(ComponentType::Light));
-    m_componentTypeCombo->addItem("Script", static_cast<int>(ComponentType::Script));
+    for (int id = 0; id < Components::Count; ++id) {
+        // Every entity already has a transform
+        if (Components::typeOf(id) != ComponentType::Transform) {
+            m_componentTypeCombo->addItem(Components::nameOf(id), static_cast<int>(Components::typeOf(id)));
+        }
+    }
     
     m_addComponentButton = new QPushButton("Add");
     connect(m_addComponentButton, &QPushButton::clicked, this, &PropertyInspector::onAddComponentClicked);
@@ -344,7 +321,7 @@ QWidget* PropertyInspector::createTransformComponentUI(TransformComponent* compo
     QWidget* posWidget = createVector3DProperty("Position", component->transform.position,
         [this, component](const QVector3D& value) {
             component->transform.position = value;
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Transform);
         });
     layout->addWidget(posWidget);
     
@@ -352,7 +329,7 @@ QWidget* PropertyInspector::createTransformComponentUI(TransformComponent* compo
     QWidget* rotWidget = createQuaternionProperty("Rotation", component->transform.rotation,
         [this, component](const QQuaternion& value) {
             component->transform.rotation = value;
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Transform);
         });
     layout->addWidget(rotWidget);
     
@@ -360,7 +337,7 @@ QWidget* PropertyInspector::createTransformComponentUI(TransformComponent* compo
     QWidget* scaleWidget = createVector3DProperty("Scale", component->transform.scale,
         [this, component](const QVector3D& value) {
             component->transform.scale = value;
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Transform);
         });
     layout->addWidget(scaleWidget);
     
@@ -376,7 +353,7 @@ QWidget* PropertyInspector::createMeshComponentUI(MeshComponent* component) {
     QWidget* meshWidget = createFileProperty("Mesh", component->meshPath, "DFF Files (*.dff)",
         [this, component](const QString& value) {
             component->meshPath = value;
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Mesh);
         });
     layout->addWidget(meshWidget);
     
@@ -384,7 +361,7 @@ QWidget* PropertyInspector::createMeshComponentUI(MeshComponent* component) {
     QWidget* materialWidget = createFileProperty("Material", component->materialPath, "TXD Files (*.txd)",
         [this, component](const QString& value) {
             component->materialPath = value;
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Mesh);
         });
     layout->addWidget(materialWidget);
     
@@ -392,7 +369,7 @@ QWidget* PropertyInspector::createMeshComponentUI(MeshComponent* component) {
     QWidget* visibleWidget = createBoolProperty("Visible", component->isVisible,
         [this, component](bool value) {
             component->isVisible = value;
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Mesh);
         });
     layout->addWidget(visibleWidget);
     
@@ -409,7 +386,7 @@ QWidget* PropertyInspector::createLightComponentUI(LightComponent* component) {
     QWidget* typeWidget = createEnumProperty("Type", static_cast<int>(component->lightType), lightTypes,
         [this, component](int value) {
             component->lightType = static_cast<LightComponent::LightType>(value);
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Light);
         });
     layout->addWidget(typeWidget);
     
@@ -417,7 +394,7 @@ QWidget* PropertyInspector::createLightComponentUI(LightComponent* component) {
     QWidget* colorWidget = createColorProperty("Color", component->color,
         [this, component](const QVector3D& value) {
             component->color = value;
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Light);
         });
     layout->addWidget(colorWidget);
     
@@ -425,7 +402,7 @@ QWidget* PropertyInspector::createLightComponentUI(LightComponent* component) {
     QWidget* intensityWidget = createFloatProperty("Intensity", component->intensity, 0.0f, 10.0f,
         [this, component](float value) {
             component->intensity = value;
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Light);
         });
     layout->addWidget(intensityWidget);
     
@@ -433,7 +410,7 @@ QWidget* PropertyInspector::createLightComponentUI(LightComponent* component) {
     QWidget* rangeWidget = createFloatProperty("Range", component->range, 0.1f, 100.0f,
         [this, component](float value) {
             component->range = value;
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Light);
         });
     layout->addWidget(rangeWidget);
     
@@ -441,7 +418,7 @@ QWidget* PropertyInspector::createLightComponentUI(LightComponent* component) {
     QWidget* shadowsWidget = createBoolProperty("Cast Shadows", component->castShadows,
         [this, component](bool value) {
             component->castShadows = value;
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Light);
         });
     layout->addWidget(shadowsWidget);
     
@@ -457,7 +434,7 @@ QWidget* PropertyInspector::createScriptComponentUI(ScriptComponent* component)
     QWidget* scriptWidget = createFileProperty("Script", component->scriptPath, "Script Files (*.lua *.as)",
         [this, component](const QString& value) {
             component->scriptPath = value;
-            onComponentPropertyChanged();
+            onComponentPropertyChanged(ComponentType::Script);
         });
     layout->addWidget(scriptWidget);
     
@@ -934,5 +911,5 @@ void ColorWidget::updateSpinBoxes() {
     m_updating = false;
 }
 
-#include "property_inspector.moc"
+#include "moc_property_inspector.cpp"
 
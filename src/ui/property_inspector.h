@@ -41,9 +41,9 @@ signals:
     void componentRemoved(EntityId entityId, ComponentType type);
     
 private slots:
-    void onSelectionChanged(const QVector<EntityId>& selectedIds);
+    void onSelectionChanged(const QVector<EntityId>& added, const QVector<EntityId>& removed);
     void onEntityPropertyChanged();
-    void onComponentPropertyChanged();
+    void onComponentPropertyChanged(ComponentType type);
     void onAddComponentClicked();
     void onRemoveComponentClicked();
     
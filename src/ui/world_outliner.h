@@ -46,7 +46,7 @@ signals:
     
 private slots:
     void onSceneChanged();
-    void onSelectionChanged(const QVector<EntityId>& selectedIds);
+    void onSelectionChanged(const QVector<EntityId>& added, const QVector<EntityId>& removed);
     void onEntityCreated(Entity* entity);
     void onEntityDestroyed(EntityId id);
     void onLayerCreated(const QString& name);
@@ -1,19 +1,18 @@
 #include "camera_controller.h"
-#include <QTimer>
 #include <QDebug>
 #include <QtMath>
 
 CameraController::CameraController(QObject* parent)
     : QObject(parent)
     , m_mode(Orbit)
-    , m_position(0, 0, 10)
+    , m_position(0, -10, 0)
     , m_target(0, 0, 0)
-    , m_up(0, 1, 0)
-    , m_worldUp(0, 1, 0)
+    , m_up(WorldUp)
+    , m_worldUp(WorldUp)
     , m_distance(10.0f)
     , m_yaw(-90.0f)
     , m_pitch(0.0f)
-    , m_forward(0, 0, -1)
+    , m_forward(0, 1, 0)
     , m_right(1, 0, 0)
     , m_fieldOfView(45.0f)
     , m_aspectRatio(16.0f / 9.0f)
@@ -31,10 +30,6 @@ CameraController::CameraController(QObject* parent)
     , m_minPitch(-89.0f)
     , m_maxPitch(89.0f)
 {
-    m_animTimer = new QTimer(this);
-    m_animTimer->setInterval(16); // ~60 FPS
-    connect(m_animTimer, &QTimer::timeout, this, &CameraController::updateAnimation);
-    
     updateCameraVectors();
 }
 
@@ -298,7 +293,7 @@ void CameraController::handleKeyPress(Qt::Key key, Qt::KeyboardModifiers modifie
             if (m_mode == Fly) {
                 m_target = m_position + getForward();
             } else if (m_mode == Walk) {
-                m_target = m_position + QVector3D(getForward().x(), 0, getForward().z()).normalized();
+                m_target = m_position + QVector3D(getForward().x(), getForward().y(), 0).normalized();
             }
             emit cameraChanged();
         }
@@ -312,10 +307,10 @@ void CameraController::handleKeyRelease(Qt::Key key) {
 void CameraController::reset() {
     stopAnimation();
     
-    m_position = QVector3D(0, 0, 10);
+    m_position = QVector3D(0, -10, 0);
     m_target = QVector3D(0, 0, 0);
-    m_up = QVector3D(0, 1, 0);
-    m_worldUp = QVector3D(0, 1, 0);
+    m_up = WorldUp;
+    m_worldUp = WorldUp;
     m_distance = 10.0f;
     m_yaw = -90.0f;
     m_pitch = 0.0f;
@@ -335,8 +330,8 @@ void CameraController::lookAt(const QVector3D& position, const QVector3D& target
     if (m_mode == Orbit) {
         m_distance = MathUtils::distance(position, target);
         QVector3D direction = (position - target).normalized();
-        m_yaw = MathUtils::radiansToDegrees(qAtan2(direction.z(), direction.x()));
-        m_pitch = MathUtils::radiansToDegrees(qAsin(direction.y()));
+        m_yaw = MathUtils::radiansToDegrees(qAtan2(-direction.y(), direction.x()));
+        m_pitch = MathUtils::radiansToDegrees(qAsin(direction.z()));
     }
     
     updateCameraVectors();
@@ -363,9 +358,9 @@ void CameraController::focusOn(const BoundingBox& bounds) {
 
 void CameraController::focusOn(const QVector3D& point, float distance) {
     if (m_mode == Orbit) {
-        animateTo(point + QVector3D(0, 0, distance), point);
+        animateTo(point + QVector3D(0, -distance, 0), point);
     } else {
-        animateTo(point + QVector3D(0, 0, distance), point);
+        animateTo(point + QVector3D(0, -distance, 0), point);
     }
 }
 
@@ -446,14 +441,16 @@ void CameraController::animateTo(const QVector3D& targetPosition, const QVector3
     m_animDuration = duration;
     m_animProgress = 0.0f;
     m_isAnimating = true;
+    m_animClock.start();
     
-    m_animTimer->start();
+    // Nothing has moved yet, but the viewport needs a frame to start
+    // advancing the animation from
+    emit cameraChanged();
 }
 
 void CameraController::stopAnimation() {
     if (m_isAnimating) {
         m_isAnimating = false;
-        m_animTimer->stop();
     }
 }
 
@@ -461,17 +458,17 @@ bool CameraController::isAnimating() const {
     return m_isAnimating;
 }
 
-void CameraController::updateAnimation() {
+bool CameraController::updateAnimation() {
     if (!m_isAnimating) {
-        return;
+        return false;
     }
     
-    m_animProgress += m_animTimer->interval() / 1000.0f / m_animDuration;
+    // Progress follows wall time, so the pace does not depend on frame rate
+    m_animProgress = m_animDuration > 0.0f ? m_animClock.elapsed() / 1000.0f / m_animDuration : 1.0f;
     
     if (m_animProgress >= 1.0f) {
         m_animProgress = 1.0f;
         m_isAnimating = false;
-        m_animTimer->stop();
     }
     
     // Smooth interpolation using ease-in-out
@@ -483,6 +480,7 @@ void CameraController::updateAnimation() {
     
     updateCameraVectors();
     emit cameraChanged();
+    return m_isAnimating;
 }
 
 void CameraController::updateCameraVectors() {
@@ -504,14 +502,14 @@ void CameraController::constrainPitch() {
 }
 
 void CameraController::updateOrbitCamera() {
-    // Calculate position based on spherical coordinates
+    // Calculate position based on spherical coordinates, pitch about Z up
     float yawRad = MathUtils::degreesToRadians(m_yaw);
     float pitchRad = MathUtils::degreesToRadians(m_pitch);
     
     QVector3D direction;
     direction.setX(qCos(yawRad) * qCos(pitchRad));
-    direction.setY(qSin(pitchRad));
-    direction.setZ(qSin(yawRad) * qCos(pitchRad));
+    direction.setY(-qSin(yawRad) * qCos(pitchRad));
+    direction.setZ(qSin(pitchRad));
     
     m_position = m_target + direction * m_distance;
     m_forward = -direction;
@@ -525,8 +523,8 @@ void CameraController::updateFlyCamera() {
     float pitchRad = MathUtils::degreesToRadians(m_pitch);
     
     m_forward.setX(qCos(yawRad) * qCos(pitchRad));
-    m_forward.setY(qSin(pitchRad));
-    m_forward.setZ(qSin(yawRad) * qCos(pitchRad));
+    m_forward.setY(-qSin(yawRad) * qCos(pitchRad));
+    m_forward.setZ(qSin(pitchRad));
     m_forward = m_forward.normalized();
     
     m_right = QVector3D::crossProduct(m_forward, m_worldUp).normalized();
@@ -536,12 +534,12 @@ void CameraController::updateFlyCamera() {
 }
 
 void CameraController::updateWalkCamera() {
-    // Similar to fly camera but constrain Y movement
+    // Similar to fly camera but constrain Z movement
     float yawRad = MathUtils::degreesToRadians(m_yaw);
     
     m_forward.setX(qCos(yawRad));
-    m_forward.setY(0.0f); // No vertical movement in walk mode
-    m_forward.setZ(qSin(yawRad));
+    m_forward.setY(-qSin(yawRad));
+    m_forward.setZ(0.0f); // No vertical movement in walk mode
     m_forward = m_forward.normalized();
     
     m_right = QVector3D::crossProduct(m_forward, m_worldUp).normalized();
@@ -550,5 +548,5 @@ void CameraController::updateWalkCamera() {
     m_target = m_position + m_forward;
 }
 
-#include "camera_controller.moc"
+#include "moc_camera_controller.cpp"
 
@@ -7,8 +7,10 @@
 #include <QVector3D>
 #include <QMatrix4x4>
 #include <QPoint>
+#include <QElapsedTimer>
 
-// Camera controller for 3D viewport navigation
+// Camera controller for 3D viewport navigation. Yaw turns about WorldUp
+// (Z) and pitch tilts towards it.
 class CameraController : public QObject {
     Q_OBJECT
     
@@ -79,7 +81,7 @@ public:
     
     // Camera operations
     void reset();
-    void lookAt(const QVector3D& position, const QVector3D& target, const QVector3D& up = QVector3D(0, 1, 0));
+    void lookAt(const QVector3D& position, const QVector3D& target, const QVector3D& up = WorldUp);
     void orbitAround(const QVector3D& target, float distance);
     void focusOn(const BoundingBox& bounds);
     void focusOn(const QVector3D& point, float distance = 10.0f);
@@ -98,14 +100,16 @@ public:
     void stopAnimation();
     bool isAnimating() const;
     
+    // Moves an animation on to the current time; returns whether it is
+    // still running. Called by the viewport once per frame, so animations
+    // run at the display's pace and cost nothing when none is running.
+    bool updateAnimation();
+    
 signals:
     void cameraChanged();
     void positionChanged(const QVector3D& position);
     void targetChanged(const QVector3D& target);
     
-private slots:
-    void updateAnimation();
-    
 private:
     void updateCameraVectors();
     void constrainPitch();
@@ -153,7 +157,7 @@ private:
     QVector3D m_animEndTarget;
     float m_animProgress;
     float m_animDuration;
-    QTimer* m_animTimer;
+    QElapsedTimer m_animClock;
     
     // Constraints
     float m_minDistance;
@@ -3,29 +3,34 @@
 #include "entity_system.h"
 #include <QDebug>
 #include <QApplication>
-#include <QOpenGLShader>
+#include <QPainter>
+#include <QTimer>
 #include <QtMath>
+#include <algorithm>
 
 ViewportWidget::ViewportWidget(QWidget* parent)
     : QOpenGLWidget(parent)
     , m_cameraController(nullptr)
     , m_sceneManager(&SceneManager::instance())
+    , m_renderer(SceneManager::instance())
     , m_renderMode(Textured)
-    , m_showGrid(true)
-    , m_showBoundingBoxes(false)
+    , m_showStats(false)
     , m_showGizmos(true)
-    , m_gridSize(1.0f)
     , m_selectionMode(Single)
     , m_isSelecting(false)
+    , m_marqueeMode(MarqueeIntersect)
+    , m_marqueeVisibleOnly(false)
+    , m_gpuPicking(true)
+    , m_hoveredEntity(0)
+    , m_hoverPollScheduled(false)
     , m_gizmoMode(0)
     , m_isGizmoActive(false)
     , m_snapToGrid(false)
     , m_snapAngle(15.0f)
-    , m_basicShader(nullptr)
-    , m_gridShader(nullptr)
-    , m_gizmoShader(nullptr)
-    , m_updateTimer(nullptr)
-    , m_lastFrameTime(0)
+    , m_frameRequestedAt(-1)
+    , m_frameAnsweredRequest(-1)
+    , m_lastFrameTimeMs(0.0)
+    , m_lastInputLatencyMs(0.0)
     , m_viewportWidth(800)
     , m_viewportHeight(600)
     , m_isMousePressed(false)
@@ -36,32 +41,23 @@ ViewportWidget::ViewportWidget(QWidget* parent)
     
     // Create camera controller
     m_cameraController = new CameraController(this);
-    connect(m_cameraController, &CameraController::cameraChanged, this, &ViewportWidget::updateViewport);
+    connect(m_cameraController, &CameraController::cameraChanged, this, &ViewportWidget::requestFrame);
     
     // Connect to scene manager
     connect(m_sceneManager, &SceneManager::sceneChanged, this, &ViewportWidget::onSceneChanged);
     connect(m_sceneManager, &SceneManager::selectionChanged, this, &ViewportWidget::onSelectionChanged);
+    connect(m_sceneManager, &SceneManager::layerVisibilityChanged, this, &ViewportWidget::requestFrame);
     
-    // Setup update timer
-    m_updateTimer = new QTimer(this);
-    m_updateTimer->setInterval(16); // ~60 FPS
-    connect(m_updateTimer, &QTimer::timeout, this, &ViewportWidget::updateViewport);
-    m_updateTimer->start();
+    // Frames are drawn on request only; the clock times requests to swaps
+    m_frameClock.start();
+    connect(this, &QOpenGLWidget::frameSwapped, this, &ViewportWidget::onFrameSwapped);
 }
 
 ViewportWidget::~ViewportWidget() {
     makeCurrent();
     
     // Clean up OpenGL resources
-    for (auto& meshData : m_meshCache) {
-        meshData.vbo.destroy();
-        meshData.ebo.destroy();
-        meshData.vao.destroy();
-    }
-    
-    delete m_basicShader;
-    delete m_gridShader;
-    delete m_gizmoShader;
+    m_renderer.destroy();
     
     doneCurrent();
 }
@@ -69,7 +65,8 @@ ViewportWidget::~ViewportWidget() {
 void ViewportWidget::setRenderMode(RenderMode mode) {
     if (m_renderMode != mode) {
         m_renderMode = mode;
-        update();
+        m_renderer.setWireframe(mode == Wireframe);
+        requestFrame();
     }
 }
 
@@ -78,46 +75,133 @@ ViewportWidget::RenderMode ViewportWidget::getRenderMode() const {
 }
 
 void ViewportWidget::setShowGrid(bool show) {
-    if (m_showGrid != show) {
-        m_showGrid = show;
-        update();
+    if (m_renderer.isShowGrid() != show) {
+        m_renderer.setShowGrid(show);
+        requestFrame();
     }
 }
 
 bool ViewportWidget::isShowGrid() const {
-    return m_showGrid;
+    return m_renderer.isShowGrid();
+}
+
+void ViewportWidget::setOcclusionCullingEnabled(bool enabled) {
+    if (m_renderer.isOcclusionCullingEnabled() != enabled) {
+        m_renderer.setOcclusionCullingEnabled(enabled);
+        requestFrame();
+    }
+}
+
+bool ViewportWidget::isOcclusionCullingEnabled() const {
+    return m_renderer.isOcclusionCullingEnabled();
+}
+
+const OcclusionCuller& ViewportWidget::getOcclusionCuller() const {
+    return m_renderer.getOcclusionCuller();
+}
+
+const ViewportWidget::FrameStats& ViewportWidget::getFrameStats() const {
+    return m_frameStats;
+}
+
+void ViewportWidget::setShowStats(bool show) {
+    if (m_showStats != show) {
+        m_showStats = show;
+        requestFrame();
+    }
+}
+
+bool ViewportWidget::isShowStats() const {
+    return m_showStats;
 }
 
 void ViewportWidget::setShowBoundingBoxes(bool show) {
-    if (m_showBoundingBoxes != show) {
-        m_showBoundingBoxes = show;
-        update();
+    if (m_renderer.isShowBoundingBoxes() != show) {
+        m_renderer.setShowBoundingBoxes(show);
+        requestFrame();
     }
 }
 
 bool ViewportWidget::isShowBoundingBoxes() const {
-    return m_showBoundingBoxes;
+    return m_renderer.isShowBoundingBoxes();
+}
+
+void ViewportWidget::setShowTriggerZones(bool show) {
+    if (m_renderer.isShowTriggerZones() != show) {
+        m_renderer.setShowTriggerZones(show);
+        requestFrame();
+    }
+}
+
+bool ViewportWidget::isShowTriggerZones() const {
+    return m_renderer.isShowTriggerZones();
+}
+
+void ViewportWidget::setShowPaths(bool show) {
+    if (m_renderer.isShowPaths() != show) {
+        m_renderer.setShowPaths(show);
+        requestFrame();
+    }
+}
+
+bool ViewportWidget::isShowPaths() const {
+    return m_renderer.isShowPaths();
 }
 
 void ViewportWidget::setGridSize(float size) {
-    if (size > 0 && m_gridSize != size) {
-        m_gridSize = size;
-        update();
+    if (size > 0 && m_renderer.getGridSize() != size) {
+        m_renderer.setGridSize(size);
+        requestFrame();
     }
 }
 
 float ViewportWidget::getGridSize() const {
-    return m_gridSize;
+    return m_renderer.getGridSize();
 }
 
 void ViewportWidget::setSelectionMode(SelectionMode mode) {
     m_selectionMode = mode;
 }
 
+GpuMeshCache& ViewportWidget::getMeshCache() {
+    return m_renderer.getMeshCache();
+}
+
 ViewportWidget::SelectionMode ViewportWidget::getSelectionMode() const {
     return m_selectionMode;
 }
 
+void ViewportWidget::setMarqueeMode(MarqueeMode mode) {
+    m_marqueeMode = mode;
+}
+
+ViewportWidget::MarqueeMode ViewportWidget::getMarqueeMode() const {
+    return m_marqueeMode;
+}
+
+void ViewportWidget::setMarqueeVisibleOnly(bool visibleOnly) {
+    m_marqueeVisibleOnly = visibleOnly;
+}
+
+bool ViewportWidget::isMarqueeVisibleOnly() const {
+    return m_marqueeVisibleOnly;
+}
+
+void ViewportWidget::setGpuPickingEnabled(bool enabled) {
+    m_gpuPicking = enabled;
+    if (!enabled) {
+        setHoveredEntity(0);
+    }
+}
+
+bool ViewportWidget::isGpuPickingEnabled() const {
+    return m_gpuPicking;
+}
+
+EntityId ViewportWidget::getHoveredEntity() const {
+    return m_hoveredEntity;
+}
+
 CameraController* ViewportWidget::getCameraController() {
     return m_cameraController;
 }
@@ -127,26 +211,16 @@ void ViewportWidget::resetCamera() {
 }
 
 void ViewportWidget::focusOnSelection() {
-    QVector<EntityId> selected = m_sceneManager->getSelectedEntities();
+    const QVector<EntityId>& selected = m_sceneManager->getSelectedEntities();
     if (selected.isEmpty()) {
         return;
     }
     
     QVector<BoundingBox> bounds;
     for (EntityId id : selected) {
-        Entity* entity = m_sceneManager->getEntity(id);
-        if (entity) {
-            MeshComponent* meshComp = entity->getComponent<MeshComponent>();
-            if (meshComp) {
-                // Transform bounding box to world space
-                Transform* transform = entity->getTransform();
-                if (transform) {
-                    QMatrix4x4 worldMatrix = transform->getMatrix();
-                    QVector3D worldMin = worldMatrix * meshComp->boundingBox.min;
-                    QVector3D worldMax = worldMatrix * meshComp->boundingBox.max;
-                    bounds.append(BoundingBox(worldMin, worldMax));
-                }
-            }
+        BoundingBox worldBounds;
+        if (m_sceneManager->getWorldBounds(id, worldBounds)) {
+            bounds.append(worldBounds);
         }
     }
     
@@ -160,15 +234,9 @@ void ViewportWidget::focusOnEntity(Entity* entity) {
         return;
     }
     
-    MeshComponent* meshComp = entity->getComponent<MeshComponent>();
-    if (meshComp) {
-        Transform* transform = entity->getTransform();
-        if (transform) {
-            QMatrix4x4 worldMatrix = transform->getMatrix();
-            QVector3D worldMin = worldMatrix * meshComp->boundingBox.min;
-            QVector3D worldMax = worldMatrix * meshComp->boundingBox.max;
-            m_cameraController->focusOn(BoundingBox(worldMin, worldMax));
-        }
+    BoundingBox worldBounds;
+    if (m_sceneManager->getWorldBounds(entity->getId(), worldBounds)) {
+        m_cameraController->focusOn(worldBounds);
     } else {
         // Focus on entity position
         m_cameraController->focusOn(entity->getPosition());
@@ -178,7 +246,7 @@ void ViewportWidget::focusOnEntity(Entity* entity) {
 void ViewportWidget::setShowGizmos(bool show) {
     if (m_showGizmos != show) {
         m_showGizmos = show;
-        update();
+        requestFrame();
     }
 }
 
@@ -189,7 +257,7 @@ bool ViewportWidget::isShowGizmos() const {
 void ViewportWidget::setGizmoMode(int mode) {
     if (mode >= 0 && mode <= 2 && m_gizmoMode != mode) {
         m_gizmoMode = mode;
-        update();
+        requestFrame();
     }
 }
 
@@ -234,28 +302,14 @@ void ViewportWidget::initializeGL() {
     qDebug() << "OpenGL Vendor:" << reinterpret_cast<const char*>(glGetString(GL_VENDOR));
     qDebug() << "OpenGL Renderer:" << reinterpret_cast<const char*>(glGetString(GL_RENDERER));
     
-    // Set clear color
-    glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
-    
-    // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-    
-    // Enable blending for transparency
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    
-    // Initialize shaders and buffers
-    initializeShaders();
-    initializeBuffers();
-    setupLighting();
+    m_renderer.initialize();
+    updateRenderTarget();
 }
 
 void ViewportWidget::resizeGL(int w, int h) {
     m_viewportWidth = w;
     m_viewportHeight = h;
-    
-    glViewport(0, 0, w, h);
+    updateRenderTarget();
     
     if (m_cameraController) {
         m_cameraController->setAspectRatio(static_cast<float>(w) / static_cast<float>(h));
@@ -263,37 +317,53 @@ void ViewportWidget::resizeGL(int w, int h) {
 }
 
 void ViewportWidget::paintGL() {
-    // Clear buffers
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // This frame answers every request so far; requests made while it is
+    // drawn (animations, uploads still streaming) schedule the next one
+    const qint64 frameStart = m_frameClock.nsecsElapsed();
+    m_frameAnsweredRequest = m_frameRequestedAt >= 0 ? m_frameRequestedAt : frameStart;
+    m_frameRequestedAt = -1;
     
     if (!m_cameraController) {
         return;
     }
+    m_cameraController->updateAnimation();
     
-    // Set wireframe mode if needed
-    if (m_renderMode == Wireframe) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    } else {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    // Gizmos and selection go into the renderer's overlay lists, which it
+    // flushes with its own
+    if (m_showGizmos && !m_selection.isEmpty()) {
+        renderGizmos();
     }
     
-    // Render scene
-    renderScene();
+    renderSelectionOutline();
     
-    // Render UI elements
-    if (m_showGrid) {
-        renderGrid();
+    updateRenderTarget();
+    m_renderer.render(SceneRenderer::View::fromCamera(*m_cameraController));
+    if (m_renderer.needsAnotherFrame()) {
+        requestFrame();
     }
     
-    if (m_showBoundingBoxes) {
-        renderBoundingBoxes();
+    m_frameStats = m_renderer.getFrameStats();
+    m_frameStats.frameTimeMs = m_lastFrameTimeMs;
+    m_frameStats.inputLatencyMs = m_lastInputLatencyMs;
+    
+    if (m_isSelecting && m_selectionMode == Marquee) {
+        renderMarquee();
     }
     
-    if (m_showGizmos && !m_selectedEntities.isEmpty()) {
-        renderGizmos();
+    if (m_showStats) {
+        renderStatsOverlay();
     }
     
-    renderSelectionOutline();
+    // Everything recorded so far has been consumed by this frame
+    m_sceneManager->advanceFrame();
+    
+    m_lastFrameTimeMs = (m_frameClock.nsecsElapsed() - frameStart) / 1e6;
+}
+
+void ViewportWidget::updateRenderTarget() {
+    // The widget's framebuffer is recreated on resize, and is in device pixels
+    const qreal ratio = devicePixelRatioF();
+    m_renderer.setTarget(defaultFramebufferObject(), qRound(width() * ratio), qRound(height() * ratio));
 }
 
 void ViewportWidget::mousePressEvent(QMouseEvent* event) {
@@ -306,7 +376,7 @@ void ViewportWidget::mousePressEvent(QMouseEvent* event) {
     
     if (event->button() == Qt::LeftButton) {
         // Check if clicking on gizmo
-        if (m_showGizmos && !m_selectedEntities.isEmpty() && isGizmoHovered(event->pos())) {
+        if (m_showGizmos && !m_selection.isEmpty() && isGizmoHovered(event->pos())) {
             startGizmoInteraction(event->pos());
             return;
         }
@@ -333,13 +403,15 @@ void ViewportWidget::mouseMoveEvent(QMouseEvent* event) {
     
     if (m_isSelecting && m_selectionMode == Marquee) {
         m_marqueeRect = QRect(m_selectionStart, event->pos()).normalized();
-        update();
+        requestFrame();
         return;
     }
     
     if (m_isMousePressed) {
         // Handle camera movement
         m_cameraController->handleMouseMove(delta, m_pressedButton, m_keyModifiers);
+    } else {
+        updateHover(event->pos());
     }
 }
 
@@ -351,13 +423,18 @@ void ViewportWidget::mouseReleaseEvent(QMouseEvent* event) {
     if (m_isSelecting && m_selectionMode == Marquee) {
         performMarqueeSelection(m_marqueeRect);
         m_isSelecting = false;
-        update();
+        requestFrame();
     }
     
     m_isMousePressed = false;
     m_pressedButton = Qt::NoButton;
 }
 
+void ViewportWidget::leaveEvent(QEvent* event) {
+    setHoveredEntity(0);
+    QOpenGLWidget::leaveEvent(event);
+}
+
 void ViewportWidget::wheelEvent(QWheelEvent* event) {
     m_cameraController->handleMouseWheel(event->angleDelta().y(), event->modifiers());
 }
@@ -380,8 +457,9 @@ void ViewportWidget::keyPressEvent(QKeyEvent* event) {
             setGizmoMode(2); // Scale
             break;
         case Qt::Key_Delete:
-            // Delete selected entities
-            for (EntityId id : m_selectedEntities) {
+            // Delete selected entities; destroying shrinks the selection, so
+            // iterate over a copy
+            for (EntityId id : QVector<EntityId>(m_selection.getIds())) {
                 m_sceneManager->destroyEntity(id);
             }
             break;
@@ -393,318 +471,437 @@ void ViewportWidget::keyReleaseEvent(QKeyEvent* event) {
 }
 
 void ViewportWidget::onSceneChanged() {
-    update();
+    requestFrame();
 }
 
-void ViewportWidget::onSelectionChanged(const QVector<EntityId>& selectedIds) {
-    m_selectedEntities = selectedIds;
-    update();
+void ViewportWidget::onSelectionChanged(const QVector<EntityId>& added, const QVector<EntityId>& removed) {
+    for (EntityId id : removed) {
+        m_selection.remove(id);
+    }
+    for (EntityId id : added) {
+        m_selection.insert(id);
+    }
+    requestFrame();
 }
 
 void ViewportWidget::onEntityTransformed() {
-    update();
+    requestFrame();
 }
 
-void ViewportWidget::updateViewport() {
-    update();
+void ViewportWidget::requestFrame() {
+    // Requests coalesce until the frame is drawn; the first one starts the
+    // latency measurement
+    if (m_frameRequestedAt < 0) {
+        m_frameRequestedAt = m_frameClock.nsecsElapsed();
+        update();
+    }
 }
 
-void ViewportWidget::initializeShaders() {
-    // Basic shader for rendering meshes
-    m_basicShader = new QOpenGLShaderProgram(this);
-    
-    // Vertex shader
-    const char* vertexShaderSource = R"(
-        #version 330 core
-        layout (location = 0) in vec3 aPos;
-        layout (location = 1) in vec3 aNormal;
-        layout (location = 2) in vec2 aTexCoord;
-        
-        uniform mat4 model;
-        uniform mat4 view;
-        uniform mat4 projection;
-        uniform mat3 normalMatrix;
-        
-        out vec3 FragPos;
-        out vec3 Normal;
-        out vec2 TexCoord;
-        
-        void main() {
-            FragPos = vec3(model * vec4(aPos, 1.0));
-            Normal = normalMatrix * aNormal;
-            TexCoord = aTexCoord;
-            
-            gl_Position = projection * view * vec4(FragPos, 1.0);
+void ViewportWidget::onFrameSwapped() {
+    if (m_frameAnsweredRequest >= 0) {
+        m_lastInputLatencyMs = (m_frameClock.nsecsElapsed() - m_frameAnsweredRequest) / 1e6;
+        m_frameAnsweredRequest = -1;
+    }
+}
+
+void ViewportWidget::renderGizmos() {
+    // At the centre of the selection, sized to stay the same on screen
+    QVector3D pivot;
+    for (EntityId id : m_selection.getIds()) {
+        pivot += m_sceneManager->getWorldMatrix(id).column(3).toVector3D();
+    }
+    pivot /= float(m_selection.size());
+    const float size = qMax(0.01f, (pivot - m_cameraController->getPosition()).length() * 0.15f);
+    
+    DebugDrawList& lines = m_renderer.getDebugDraw().get(DebugDraw::Overlay);
+    const QVector3D axes[3] = {QVector3D(1, 0, 0), QVector3D(0, 1, 0), QVector3D(0, 0, 1)};
+    const QColor colors[3] = {QColor(230, 60, 60), QColor(60, 210, 60), QColor(70, 110, 240)};
+    for (int axis = 0; axis < 3; ++axis) {
+        const QVector3D tip = pivot + axes[axis] * size;
+        switch (m_gizmoMode) {
+        case 0:
+            lines.arrow(pivot, tip, colors[axis], size * 0.2f);
+            break;
+        case 1:
+            lines.circle(pivot, axes[axis], size, colors[axis], 48);
+            break;
+        case 2: {
+            lines.line(pivot, tip, colors[axis]);
+            QMatrix4x4 handle;
+            handle.translate(tip);
+            handle.scale(size * 0.05f);
+            lines.box(handle, colors[axis]);
+            break;
         }
-    )";
-    
-    // Fragment shader
-    const char* fragmentShaderSource = R"(
-        #version 330 core
-        out vec4 FragColor;
-        
-        in vec3 FragPos;
-        in vec3 Normal;
-        in vec2 TexCoord;
-        
-        uniform vec3 lightPos;
-        uniform vec3 lightColor;
-        uniform vec3 viewPos;
-        uniform vec3 objectColor;
-        uniform bool useTexture;
-        uniform sampler2D texture1;
-        
-        void main() {
-            vec3 color = objectColor;
-            if (useTexture) {
-                color = texture(texture1, TexCoord).rgb;
-            }
-            
-            // Ambient
-            float ambientStrength = 0.3;
-            vec3 ambient = ambientStrength * lightColor;
-            
-            // Diffuse
-            vec3 norm = normalize(Normal);
-            vec3 lightDir = normalize(lightPos - FragPos);
-            float diff = max(dot(norm, lightDir), 0.0);
-            vec3 diffuse = diff * lightColor;
-            
-            // Specular
-            float specularStrength = 0.5;
-            vec3 viewDir = normalize(viewPos - FragPos);
-            vec3 reflectDir = reflect(-lightDir, norm);
-            float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-            vec3 specular = specularStrength * spec * lightColor;
-            
-            vec3 result = (ambient + diffuse + specular) * color;
-            FragColor = vec4(result, 1.0);
         }
-    )";
-    
-    m_basicShader->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShaderSource);
-    m_basicShader->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShaderSource);
-    m_basicShader->link();
-    
-    // Grid shader
-    m_gridShader = new QOpenGLShaderProgram(this);
-    
-    const char* gridVertexShader = R"(
-        #version 330 core
-        layout (location = 0) in vec3 aPos;
-        
-        uniform mat4 mvp;
-        
-        void main() {
-            gl_Position = mvp * vec4(aPos, 1.0);
-        }
-    )";
-    
-    const char* gridFragmentShader = R"(
-        #version 330 core
-        out vec4 FragColor;
-        
-        uniform vec3 color;
-        
-        void main() {
-            FragColor = vec4(color, 1.0);
+    }
+}
+
+void ViewportWidget::renderSelectionOutline() {
+    DebugDrawList& lines = m_renderer.getDebugDraw().get(DebugDraw::Overlay);
+    const QColor color(255, 170, 40);
+    BoundingBox box;
+    if (m_hoveredEntity && !m_selection.contains(m_hoveredEntity)
+        && m_sceneManager->getWorldBounds(m_hoveredEntity, box)) {
+        lines.box(box, QColor(140, 200, 255));
+    }
+    for (EntityId id : m_selection.getIds()) {
+        if (m_sceneManager->getWorldBounds(id, box)) {
+            lines.box(box, color);
+        } else {
+            lines.cross(m_sceneManager->getWorldMatrix(id).column(3).toVector3D(), 1.0f, color);
         }
-    )";
-    
-    m_gridShader->addShaderFromSourceCode(QOpenGLShader::Vertex, gridVertexShader);
-    m_gridShader->addShaderFromSourceCode(QOpenGLShader::Fragment, gridFragmentShader);
-    m_gridShader->link();
-    
-    // Gizmo shader (similar to grid shader for now)
-    m_gizmoShader = new QOpenGLShaderProgram(this);
-    m_gizmoShader->addShaderFromSourceCode(QOpenGLShader::Vertex, gridVertexShader);
-    m_gizmoShader->addShaderFromSourceCode(QOpenGLShader::Fragment, gridFragmentShader);
-    m_gizmoShader->link();
+    }
 }
 
-void ViewportWidget::initializeBuffers() {
-    // Initialize grid VAO and VBO
-    m_gridVAO.create();
-    m_gridVBO.create();
+void ViewportWidget::renderStatsOverlay() {
+    const QStringList lines = {
+        QString("Objects: %1").arg(m_frameStats.totalObjects),
+        QString("Visible: %1").arg(m_frameStats.visibleObjects),
+        QString("LODs drawn: %1").arg(m_frameStats.lodObjects),
+        QString("Frustum/range culled: %1").arg(m_frameStats.frustumCulled),
+        QString("Occlusion culled: %1").arg(m_frameStats.occlusionCulled),
+        QString("Draw calls: %1").arg(m_frameStats.drawCalls),
+        QString("BVH nodes: %1").arg(m_frameStats.nodesVisited),
+        QString("GPU meshes: %1 (%2 MB)").arg(m_frameStats.residentMeshes).arg(m_frameStats.meshBytes / (1024.0 * 1024.0), 0, 'f', 1),
+        QString("Uploaded: %1 KB").arg(m_frameStats.uploadedBytes / 1024),
+        QString("Texture arrays: %1 (%2 MB)").arg(m_frameStats.textureArrays).arg(m_frameStats.textureBytes / (1024.0 * 1024.0), 0, 'f', 1),
+        QString("Debug lines: %1 (%2 draws)").arg(m_frameStats.debugLines).arg(m_frameStats.debugDrawCalls),
+        QString("Binds: %1 shader, %2 texture, %3 mesh").arg(m_frameStats.shaderBinds)
+            .arg(m_frameStats.textureBinds).arg(m_frameStats.meshBinds),
+        QString("Pass changes: %1, uniforms: %2, skipped: %3").arg(m_frameStats.passChanges)
+            .arg(m_frameStats.uniformUpdates).arg(m_frameStats.redundantSkipped),
+        QString("Frame: %1 ms, latency: %2 ms").arg(m_frameStats.frameTimeMs, 0, 'f', 2)
+            .arg(m_frameStats.inputLatencyMs, 0, 'f', 2)
+    };
     
-    // Initialize gizmo VAO and VBO
-    m_gizmoVAO.create();
-    m_gizmoVBO.create();
+    // QPainter on top of the GL frame; it restores its own GL state
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    QFontMetrics metrics = painter.fontMetrics();
+    int width = 0;
+    for (const QString& line : lines) {
+        width = qMax(width, metrics.horizontalAdvance(line));
+    }
+    QRect background(8, 8, width + 12, metrics.height() * lines.size() + 8);
+    painter.fillRect(background, QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
+    int baseline = background.top() + 4 + metrics.ascent();
+    for (const QString& line : lines) {
+        painter.drawText(background.left() + 6, baseline, line);
+        baseline += metrics.height();
+    }
 }
 
-void ViewportWidget::setupLighting() {
-    // Setup default lighting parameters
-    // This will be used in the shaders
+void ViewportWidget::renderMarquee() {
+    QPainter painter(this);
+    painter.setPen(QPen(QColor(120, 170, 255), 1.0));
+    painter.setBrush(QColor(120, 170, 255, 40));
+    painter.drawRect(m_marqueeRect);
 }
 
-void ViewportWidget::renderScene() {
-    if (!m_basicShader || !m_cameraController) {
-        return;
-    }
-    
-    m_basicShader->bind();
-    
-    // Set matrices
-    QMatrix4x4 view = m_cameraController->getViewMatrix();
-    QMatrix4x4 projection = m_cameraController->getProjectionMatrix();
-    
-    m_basicShader->setUniformValue("view", view);
-    m_basicShader->setUniformValue("projection", projection);
-    
-    // Set lighting
-    m_basicShader->setUniformValue("lightPos", QVector3D(10.0f, 10.0f, 10.0f));
-    m_basicShader->setUniformValue("lightColor", QVector3D(1.0f, 1.0f, 1.0f));
-    m_basicShader->setUniformValue("viewPos", m_cameraController->getPosition());
-    
-    // Render entities
-    renderEntities();
+void ViewportWidget::performSelection(const QPoint& screenPos) {
+    Entity* entity = pickEntity(screenPos);
     
-    m_basicShader->release();
-}
-
-void ViewportWidget::renderEntities() {
-    for (Entity* entity : m_sceneManager->getAllEntities()) {
-        if (entity) {
-            renderEntity(entity);
+    if (entity) {
+        EntityId id = entity->getId();
+        
+        if (m_keyModifiers & Qt::ControlModifier) {
+            // Toggle selection
+            if (m_selection.contains(id)) {
+                m_sceneManager->deselectEntity(id);
+                emit entityDeselected(id);
+            } else {
+                m_sceneManager->selectEntity(id);
+                emit entitySelected(id);
+            }
+        } else {
+            // Single selection, as one delta
+            m_sceneManager->selectMultiple(QVector<EntityId>{id});
+            emit entitySelected(id);
         }
+    } else if (!(m_keyModifiers & Qt::ControlModifier)) {
+        // Clear selection if not holding Ctrl
+        m_sceneManager->clearSelection();
     }
 }
 
-void ViewportWidget::renderEntity(Entity* entity) {
-    if (!entity) {
+void ViewportWidget::performMarqueeSelection(const QRect& rect) {
+    // A click without a drag selects nothing; treat it like a click on empty space
+    if (rect.width() < 2 || rect.height() < 2) {
+        performSelection(rect.center());
         return;
     }
     
-    // Check if entity's layer is visible
-    QString layer = m_sceneManager->getEntityLayer(entity->getId());
-    if (!layer.isEmpty() && !m_sceneManager->isLayerVisible(layer)) {
-        return;
+    QVector<EntityId> ids = m_sceneManager->pickEntitiesInFrustum(getRegionFrustum(rect),
+                                                                  m_marqueeMode == MarqueeContain);
+    if (m_marqueeVisibleOnly && !removeOccludedById(rect, ids)) {
+        removeOccludedByDepth(rect, ids);
     }
     
-    MeshComponent* meshComp = entity->getComponent<MeshComponent>();
-    Transform* transform = entity->getTransform();
-    
-    if (!meshComp || !transform || !meshComp->isVisible) {
-        return;
+    // Ctrl adds to the selection, Alt removes from it, otherwise it is replaced
+    if (m_keyModifiers & Qt::ControlModifier) {
+        m_sceneManager->addToSelection(ids);
+    } else if (m_keyModifiers & Qt::AltModifier) {
+        m_sceneManager->removeFromSelection(ids);
+    } else {
+        m_sceneManager->selectMultiple(ids);
     }
+    emit selectionChanged(m_selection.getIds());
+}
+
+Frustum ViewportWidget::getRegionFrustum(const QRect& rect) const {
+    // Map the rectangle's NDC extent onto [-1, 1] after projection, so the
+    // planes extracted from the product bound just that part of the view
+    float left = 2.0f * rect.left() / width() - 1.0f;
+    float right = 2.0f * (rect.right() + 1) / width() - 1.0f;
+    float top = 1.0f - 2.0f * rect.top() / height();
+    float bottom = 1.0f - 2.0f * (rect.bottom() + 1) / height();
     
-    // Set model matrix
-    QMatrix4x4 model = transform->getMatrix();
-    m_basicShader->setUniformValue("model", model);
-    
-    // Set normal matrix
-    QMatrix3x3 normalMatrix = model.normalMatrix();
-    m_basicShader->setUniformValue("normalMatrix", normalMatrix);
-    
-    // Set object color (placeholder)
-    m_basicShader->setUniformValue("objectColor", QVector3D(0.8f, 0.8f, 0.8f));
-    m_basicShader->setUniformValue("useTexture", false);
-    
-    // TODO: Render actual mesh data
-    // For now, we'll render a simple cube as placeholder
-    renderPlaceholderCube();
+    QMatrix4x4 region;
+    region.scale(2.0f / (right - left), 2.0f / (top - bottom), 1.0f);
+    region.translate(-(left + right) * 0.5f, -(top + bottom) * 0.5f, 0.0f);
+    return Frustum(region * getProjectionMatrix() * getViewMatrix());
 }
 
-void ViewportWidget::renderGrid() {
-    if (!m_gridShader) {
+void ViewportWidget::removeOccludedByDepth(const QRect& rect, QVector<EntityId>& ids) {
+    const QRect region = getDeviceRegion(rect);
+    if (region.isEmpty() || ids.isEmpty()) {
         return;
     }
     
-    m_gridShader->bind();
+    // Read back the last frame's depth under the rectangle, in device
+    // pixels with rows bottom-up. A multisampled target cannot be read
+    // directly; then every candidate is kept.
+    const qreal ratio = devicePixelRatioF();
+    const int fullWidth = qRound(width() * ratio);
+    const int fullHeight = qRound(height() * ratio);
+    const int x0 = region.x();
+    const int y0 = region.y();
+    const int w = region.width();
+    const int h = region.height();
     
-    QMatrix4x4 mvp = m_cameraController->getViewProjectionMatrix();
-    m_gridShader->setUniformValue("mvp", mvp);
-    m_gridShader->setUniformValue("color", QVector3D(0.5f, 0.5f, 0.5f));
-    
-    // Generate grid lines
-    QVector<QVector3D> gridLines;
-    float gridExtent = 50.0f;
-    int gridCount = static_cast<int>(gridExtent / m_gridSize);
+    QVector<float> depth(w * h);
+    makeCurrent();
+    while (glGetError() != GL_NO_ERROR) {
+    }
+    glReadPixels(x0, y0, w, h, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+    bool readBack = glGetError() == GL_NO_ERROR;
+    doneCurrent();
+    if (!readBack) {
+        qWarning() << "ViewportWidget: Depth readback failed; marquee keeps occluded entities";
+        return;
+    }
     
-    // Horizontal lines
-    for (int i = -gridCount; i <= gridCount; ++i) {
-        float pos = i * m_gridSize;
-        gridLines.append(QVector3D(-gridExtent, 0, pos));
-        gridLines.append(QVector3D(gridExtent, 0, pos));
+    // Farthest depth per tile. An entity is visible if the nearest point of
+    // its bounds is in front of that in some tile under its footprint;
+    // conservative, since its surface is never nearer than its box.
+    const int tileSize = 8;
+    const int tilesX = (w + tileSize - 1) / tileSize;
+    const int tilesY = (h + tileSize - 1) / tileSize;
+    QVector<float> tileFarthest(tilesX * tilesY, 0.0f);
+    for (int y = 0; y < h; ++y) {
+        float* row = tileFarthest.data() + (y / tileSize) * tilesX;
+        for (int x = 0; x < w; ++x) {
+            row[x / tileSize] = qMax(row[x / tileSize], depth[y * w + x]);
+        }
     }
     
-    // Vertical lines
-    for (int i = -gridCount; i <= gridCount; ++i) {
-        float pos = i * m_gridSize;
-        gridLines.append(QVector3D(pos, 0, -gridExtent));
-        gridLines.append(QVector3D(pos, 0, gridExtent));
+    const QMatrix4x4 viewProjection = getProjectionMatrix() * getViewMatrix();
+    const BoundsCache& boundsCache = m_sceneManager->getBoundsCache();
+    const float depthBias = 1e-4f;
+    int kept = 0;
+    for (EntityId id : ids) {
+        BoundingBox box;
+        if (const BoundingBox* bounds = boundsCache.find(id)) {
+            box = *bounds;
+        } else {
+            QVector3D position = m_sceneManager->getWorldMatrix(id).column(3).toVector3D();
+            box = BoundingBox(position, position);
+        }
+        
+        // Footprint in the readback image and nearest window depth; a box
+        // crossing the near plane is kept without testing
+        float minX = w, minY = h, maxX = -1.0f, maxY = -1.0f;
+        float nearest = 1.0f;
+        bool crossesNear = false;
+        for (int corner = 0; corner < 8 && !crossesNear; ++corner) {
+            QVector4D clip = viewProjection * QVector4D(corner & 1 ? box.max.x() : box.min.x(),
+                                                        corner & 2 ? box.max.y() : box.min.y(),
+                                                        corner & 4 ? box.max.z() : box.min.z(), 1.0f);
+            if (clip.w() <= 1e-6f) {
+                crossesNear = true;
+                break;
+            }
+            QVector3D ndc = clip.toVector3D() / clip.w();
+            float x = (ndc.x() * 0.5f + 0.5f) * fullWidth - x0;
+            float y = (ndc.y() * 0.5f + 0.5f) * fullHeight - y0;
+            minX = qMin(minX, x);
+            maxX = qMax(maxX, x);
+            minY = qMin(minY, y);
+            maxY = qMax(maxY, y);
+            nearest = qMin(nearest, ndc.z() * 0.5f + 0.5f);
+        }
+        
+        bool visible = crossesNear;
+        if (!visible) {
+            int tileX0 = qBound(0, int(minX) / tileSize, tilesX - 1);
+            int tileX1 = qBound(0, int(maxX) / tileSize, tilesX - 1);
+            int tileY0 = qBound(0, int(minY) / tileSize, tilesY - 1);
+            int tileY1 = qBound(0, int(maxY) / tileSize, tilesY - 1);
+            for (int ty = tileY0; ty <= tileY1 && !visible; ++ty) {
+                for (int tx = tileX0; tx <= tileX1; ++tx) {
+                    if (nearest <= tileFarthest[ty * tilesX + tx] + depthBias) {
+                        visible = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (visible) {
+            ids[kept++] = id;
+        }
+    }
+    ids.resize(kept);
+}
+
+bool ViewportWidget::removeOccludedById(const QRect& rect, QVector<EntityId>& ids) {
+    if (!m_gpuPicking || !isValid()) {
+        return false;
     }
     
-    // Upload and render grid
-    m_gridVAO.bind();
-    m_gridVBO.bind();
-    m_gridVBO.allocate(gridLines.constData(), gridLines.size() * sizeof(QVector3D));
+    QSet<EntityId> seen;
+    makeCurrent();
+    bool rendered = renderIdBuffer();
+    if (rendered) {
+        m_renderer.getIdBuffer().readIds(getDeviceRegion(rect), seen);
+    }
+    doneCurrent();
+    if (!rendered) {
+        return false;
+    }
     
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(QVector3D), nullptr);
+    // Exact: kept if any pixel in the rectangle shows the entity. Entities
+    // the renderer does not draw (no mesh) have nothing to hide behind.
+    ids.erase(std::remove_if(ids.begin(), ids.end(), [&](EntityId id) {
+        return !seen.contains(id) && m_renderer.isDrawable(id);
+    }), ids.end());
+    return true;
+}
+
+Entity* ViewportWidget::pickEntity(const QPoint& screenPos) {
+    EntityId id = 0;
+    if (pickEntityId(screenPos, id)) {
+        return id ? m_sceneManager->getEntity(id) : nullptr;
+    }
     
-    glDrawArrays(GL_LINES, 0, gridLines.size());
+    // CPU fallback, for contexts without integer framebuffers and for
+    // headless use
+    QVector3D rayOrigin = m_cameraController->getPosition();
+    QVector3D rayDirection = getMouseRay(screenPos);
     
-    m_gridVAO.release();
-    m_gridShader->release();
+    return m_sceneManager->raycast(rayOrigin, rayDirection);
 }
 
-void ViewportWidget::renderBoundingBoxes() {
-    // TODO: Implement bounding box rendering
+bool ViewportWidget::pickEntityId(const QPoint& screenPos, EntityId& id) {
+    if (!m_gpuPicking || !isValid()) {
+        return false;
+    }
+    
+    makeCurrent();
+    bool rendered = renderIdBuffer();
+    if (rendered) {
+        QPoint pixel = toDevicePixel(screenPos);
+        id = m_renderer.getIdBuffer().readId(pixel.x(), pixel.y());
+    }
+    doneCurrent();
+    
+    // A locked entity still hides what is behind it, so a click on it
+    // picks nothing rather than whatever the ray would reach next
+    if (rendered && id && !isPickable(id)) {
+        id = 0;
+    }
+    return rendered;
 }
 
-void ViewportWidget::renderGizmos() {
-    // TODO: Implement gizmo rendering
+bool ViewportWidget::isPickable(EntityId id) const {
+    const LayerTable& layers = m_sceneManager->getLayerTable();
+    return m_sceneManager->getEntity(id)
+        && !(layers.getLayerBit(id) & (layers.getHiddenMask() | layers.getLockedMask()));
 }
 
-void ViewportWidget::renderSelectionOutline() {
-    // TODO: Implement selection outline rendering
+bool ViewportWidget::renderIdBuffer() {
+    // The last painted frame's draws again, without textures or state
+    // sorting, for the camera as it is now
+    updateRenderTarget();
+    return m_renderer.renderIdBuffer(SceneRenderer::View::fromCamera(*m_cameraController));
 }
 
-void ViewportWidget::renderMesh(const GTAMesh& mesh, const QMatrix4x4& modelMatrix) {
-    // TODO: Implement actual mesh rendering
+void ViewportWidget::updateHover(const QPoint& screenPos) {
+    if (!m_gpuPicking || !isValid()) {
+        return;
+    }
+    
+    // At most one id pass per painted frame; after that each move is a
+    // one-pixel read that lands in a pixel buffer
+    makeCurrent();
+    if (renderIdBuffer()) {
+        QPoint pixel = toDevicePixel(screenPos);
+        m_renderer.getIdBuffer().requestId(pixel.x(), pixel.y());
+    }
+    doneCurrent();
+    pollHover();
 }
 
-void ViewportWidget::uploadMeshToGPU(const GTAMesh& mesh) {
-    // TODO: Implement mesh upload to GPU
+void ViewportWidget::pollHover() {
+    m_hoverPollScheduled = false;
+    IdBuffer& idBuffer = m_renderer.getIdBuffer();
+    if (!idBuffer.isReadPending() || !isValid()) {
+        return;
+    }
+    
+    EntityId id = 0;
+    makeCurrent();
+    bool ready = idBuffer.pollId(id);
+    bool pending = idBuffer.isReadPending();
+    doneCurrent();
+    
+    if (ready) {
+        setHoveredEntity(id && isPickable(id) ? id : 0);
+    } else if (pending) {
+        m_hoverPollScheduled = true;
+        QTimer::singleShot(1, this, &ViewportWidget::pollHover);
+    }
 }
 
-void ViewportWidget::performSelection(const QPoint& screenPos) {
-    Entity* entity = pickEntity(screenPos);
-    
-    if (entity) {
-        EntityId id = entity->getId();
-        
-        if (m_keyModifiers & Qt::ControlModifier) {
-            // Toggle selection
-            if (m_selectedEntities.contains(id)) {
-                m_sceneManager->deselectEntity(id);
-                emit entityDeselected(id);
-            } else {
-                m_sceneManager->selectEntity(id);
-                emit entitySelected(id);
-            }
-        } else {
-            // Single selection
-            m_sceneManager->clearSelection();
-            m_sceneManager->selectEntity(id);
-            emit entitySelected(id);
-        }
-    } else if (!(m_keyModifiers & Qt::ControlModifier)) {
-        // Clear selection if not holding Ctrl
-        m_sceneManager->clearSelection();
+void ViewportWidget::setHoveredEntity(EntityId id) {
+    if (m_hoveredEntity != id) {
+        m_hoveredEntity = id;
+        emit entityHovered(id);
+        requestFrame();
     }
 }
 
-void ViewportWidget::performMarqueeSelection(const QRect& rect) {
-    // TODO: Implement marquee selection
+QPoint ViewportWidget::toDevicePixel(const QPoint& screenPos) const {
+    // Device pixels with rows bottom-up, as GL reads them
+    const qreal ratio = devicePixelRatioF();
+    const int fullHeight = qRound(height() * ratio);
+    return QPoint(qFloor(screenPos.x() * ratio), fullHeight - 1 - qFloor(screenPos.y() * ratio));
 }
 
-Entity* ViewportWidget::pickEntity(const QPoint& screenPos) {
-    QVector3D rayOrigin = m_cameraController->getPosition();
-    QVector3D rayDirection = getMouseRay(screenPos);
-    
-    return m_sceneManager->raycast(rayOrigin, rayDirection);
+QRect ViewportWidget::getDeviceRegion(const QRect& rect) const {
+    QRect region = rect.intersected(QRect(0, 0, width(), height()));
+    if (region.isEmpty()) {
+        return QRect();
+    }
+    const qreal ratio = devicePixelRatioF();
+    const int fullWidth = qRound(width() * ratio);
+    const int fullHeight = qRound(height() * ratio);
+    const int x0 = qFloor(region.left() * ratio);
+    const int y0 = qFloor((height() - region.bottom() - 1) * ratio);
+    const int w = qMax(1, qMin(fullWidth - x0, qCeil(region.width() * ratio)));
+    const int h = qMax(1, qMin(fullHeight - y0, qCeil(region.height() * ratio)));
+    return QRect(x0, y0, w, h);
 }
 
 bool ViewportWidget::isGizmoHovered(const QPoint& screenPos) {
@@ -736,70 +933,5 @@ QVector3D ViewportWidget::getWorldPosition(const QPoint& screenPos, float depth)
     return screenToWorld(screenPos, depth);
 }
 
-void ViewportWidget::renderPlaceholderCube() {
-    // Simple cube vertices for placeholder rendering
-    static const float vertices[] = {
-        // Front face
-        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
-        
-        // Back face
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
-         0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-    };
-    
-    static const unsigned int indices[] = {
-        0, 1, 2, 2, 3, 0,   // Front
-        4, 5, 6, 6, 7, 4,   // Back
-        7, 6, 2, 2, 3, 7,   // Top
-        4, 5, 1, 1, 0, 4,   // Bottom
-        4, 0, 3, 3, 7, 4,   // Left
-        1, 5, 6, 6, 2, 1    // Right
-    };
-    
-    // Create temporary buffers for cube
-    static QOpenGLBuffer cubeVBO;
-    static QOpenGLBuffer cubeEBO;
-    static QOpenGLVertexArrayObject cubeVAO;
-    static bool initialized = false;
-    
-    if (!initialized) {
-        cubeVAO.create();
-        cubeVBO.create();
-        cubeEBO.create();
-        
-        cubeVAO.bind();
-        
-        cubeVBO.bind();
-        cubeVBO.allocate(vertices, sizeof(vertices));
-        
-        cubeEBO.bind();
-        cubeEBO.allocate(indices, sizeof(indices));
-        
-        // Position attribute
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), nullptr);
-        
-        // Normal attribute
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), reinterpret_cast<void*>(3 * sizeof(float)));
-        
-        // Texture coordinate attribute
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), reinterpret_cast<void*>(6 * sizeof(float)));
-        
-        cubeVAO.release();
-        initialized = true;
-    }
-    
-    cubeVAO.bind();
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
-    cubeVAO.release();
-}
-
-#include "viewport_widget.moc"
+#include "moc_viewport_widget.cpp"
 
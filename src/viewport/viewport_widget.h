@@ -3,22 +3,25 @@
 
 #include "types.h"
 #include "camera_controller.h"
+#include "selection_set.h"
+#include "frustum.h"
+#include "scene_renderer.h"
 #include <QOpenGLWidget>
-#include <QOpenGLFunctions>
-#include <QOpenGLShaderProgram>
-#include <QOpenGLBuffer>
-#include <QOpenGLVertexArrayObject>
+#include <QOpenGLExtraFunctions>
 #include <QMatrix4x4>
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QKeyEvent>
-#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
 
 class Entity;
 class SceneManager;
 
-// 3D viewport widget for displaying and interacting with the scene
-class ViewportWidget : public QOpenGLWidget, protected QOpenGLFunctions {
+// 3D viewport widget for displaying and interacting with the scene. Drawing
+// is done by a SceneRenderer into the widget's framebuffer; the widget adds
+// input, selection, gizmos and on-demand repaints.
+class ViewportWidget : public QOpenGLWidget, protected QOpenGLExtraFunctions {
     Q_OBJECT
     
 public:
@@ -35,6 +38,12 @@ public:
         Marquee
     };
     
+    // Whether a marquee selects what it touches or only what it encloses
+    enum MarqueeMode {
+        MarqueeIntersect,
+        MarqueeContain
+    };
+    
     explicit ViewportWidget(QWidget* parent = nullptr);
     ~ViewportWidget();
     
@@ -48,13 +57,53 @@ public:
     void setShowBoundingBoxes(bool show);
     bool isShowBoundingBoxes() const;
     
+    // Mission trigger zones and path networks, drawn as lines
+    void setShowTriggerZones(bool show);
+    bool isShowTriggerZones() const;
+    void setShowPaths(bool show);
+    bool isShowPaths() const;
+    
     void setGridSize(float size);
     float getGridSize() const;
     
+    // CPU occlusion culling against IPL OCCL zones
+    void setOcclusionCullingEnabled(bool enabled);
+    bool isOcclusionCullingEnabled() const;
+    const OcclusionCuller& getOcclusionCuller() const;
+    
+    // Per-frame culling and submission counts, optionally drawn as an overlay
+    using FrameStats = SceneRenderer::FrameStats;
+    const FrameStats& getFrameStats() const;
+    
+    // On-demand rendering. Anything that changes what the viewport shows
+    // calls requestFrame(); requests coalesce into one repaint, so nothing
+    // is drawn while idle.
+    void requestFrame();
+    void setShowStats(bool show);
+    bool isShowStats() const;
+    
+    // GPU copies of model geometry; budgets can be tuned here
+    GpuMeshCache& getMeshCache();
+    
     // Selection
     void setSelectionMode(SelectionMode mode);
     SelectionMode getSelectionMode() const;
     
+    // Marquee selection. With visible-only set, only entities seen in some
+    // pixel of the rectangle are selected (from the id buffer, or the last
+    // frame's depth buffer when picking is on the CPU).
+    void setMarqueeMode(MarqueeMode mode);
+    MarqueeMode getMarqueeMode() const;
+    void setMarqueeVisibleOnly(bool visibleOnly);
+    bool isMarqueeVisibleOnly() const;
+    
+    // Picking. By default clicks, hover and visible-only marquees read
+    // entity ids rendered per pixel; turned off, or where the context has
+    // no integer framebuffers, they fall back to CPU raycasts.
+    void setGpuPickingEnabled(bool enabled);
+    bool isGpuPickingEnabled() const;
+    EntityId getHoveredEntity() const; // 0 if none
+    
     // Camera control
     CameraController* getCameraController();
     void resetCamera();
@@ -84,6 +133,7 @@ signals:
     void entitySelected(EntityId id);
     void entityDeselected(EntityId id);
     void selectionChanged(const QVector<EntityId>& selectedIds);
+    void entityHovered(EntityId id);
     void entityTransformed(EntityId id, const Transform& newTransform);
     void cameraChanged(const QVector3D& position, const QVector3D& target);
     
@@ -100,36 +150,39 @@ protected:
     void wheelEvent(QWheelEvent* event) override;
     void keyPressEvent(QKeyEvent* event) override;
     void keyReleaseEvent(QKeyEvent* event) override;
+    void leaveEvent(QEvent* event) override;
     
 private slots:
     void onSceneChanged();
-    void onSelectionChanged(const QVector<EntityId>& selectedIds);
+    void onSelectionChanged(const QVector<EntityId>& added, const QVector<EntityId>& removed);
     void onEntityTransformed();
-    void updateViewport();
+    void onFrameSwapped();
     
 private:
-    // Initialization
-    void initializeShaders();
-    void initializeBuffers();
-    void setupLighting();
-    
     // Rendering
-    void renderScene();
-    void renderEntities();
-    void renderEntity(Entity* entity);
-    void renderGrid();
-    void renderBoundingBoxes();
+    void updateRenderTarget();
     void renderGizmos();
     void renderSelectionOutline();
-    
-    // Mesh rendering
-    void renderMesh(const GTAMesh& mesh, const QMatrix4x4& modelMatrix);
-    void uploadMeshToGPU(const GTAMesh& mesh);
+    void renderStatsOverlay();
+    void renderMarquee();
     
     // Selection
     void performSelection(const QPoint& screenPos);
     void performMarqueeSelection(const QRect& rect);
+    Frustum getRegionFrustum(const QRect& rect) const;
+    void removeOccludedByDepth(const QRect& rect, QVector<EntityId>& ids);
+    bool removeOccludedById(const QRect& rect, QVector<EntityId>& ids);
     Entity* pickEntity(const QPoint& screenPos);
+    bool pickEntityId(const QPoint& screenPos, EntityId& id);
+    bool isPickable(EntityId id) const;
+    
+    // Id buffer picking; the context must be current for renderIdBuffer()
+    bool renderIdBuffer();
+    void updateHover(const QPoint& screenPos);
+    void pollHover();
+    void setHoveredEntity(EntityId id);
+    QPoint toDevicePixel(const QPoint& screenPos) const;
+    QRect getDeviceRegion(const QRect& rect) const;
     
     // Gizmo interaction
     bool isGizmoHovered(const QPoint& screenPos);
@@ -146,19 +199,26 @@ private:
     CameraController* m_cameraController;
     SceneManager* m_sceneManager;
     
-    // Rendering state
+    // Rendering state; scene settings live in the renderer
+    SceneRenderer m_renderer;
     RenderMode m_renderMode;
-    bool m_showGrid;
-    bool m_showBoundingBoxes;
+    bool m_showStats;
     bool m_showGizmos;
-    float m_gridSize;
     
     // Selection state
     SelectionMode m_selectionMode;
-    QVector<EntityId> m_selectedEntities;
+    SelectionSet m_selection; // Mirror of the scene selection, kept from deltas
     bool m_isSelecting;
     QPoint m_selectionStart;
     QRect m_marqueeRect;
+    MarqueeMode m_marqueeMode;
+    bool m_marqueeVisibleOnly;
+    
+    // Picking. The id buffer is drawn from the last painted frame when a
+    // pick needs it; hover reads complete asynchronously and are polled.
+    bool m_gpuPicking;
+    EntityId m_hoveredEntity;
+    bool m_hoverPollScheduled;
     
     // Gizmo state
     int m_gizmoMode; // 0=translate, 1=rotate, 2=scale
@@ -170,29 +230,16 @@ private:
     bool m_snapToGrid;
     float m_snapAngle;
     
-    // OpenGL resources
-    QOpenGLShaderProgram* m_basicShader;
-    QOpenGLShaderProgram* m_gridShader;
-    QOpenGLShaderProgram* m_gizmoShader;
-    
-    QOpenGLBuffer m_gridVBO;
-    QOpenGLBuffer m_gizmoVBO;
-    QOpenGLVertexArrayObject m_gridVAO;
-    QOpenGLVertexArrayObject m_gizmoVAO;
-    
-    // Mesh cache
-    struct MeshData {
-        QOpenGLBuffer vbo;
-        QOpenGLBuffer ebo;
-        QOpenGLVertexArrayObject vao;
-        int indexCount;
-        bool isUploaded;
-    };
-    QMap<QString, MeshData> m_meshCache;
+    // The renderer's counts for the last frame, plus its timing
+    FrameStats m_frameStats;
     
-    // Timing
-    QTimer* m_updateTimer;
-    qint64 m_lastFrameTime;
+    // Timing. A request's time is kept until the frame answering it is
+    // swapped, which gives the request-to-screen latency.
+    QElapsedTimer m_frameClock;
+    qint64 m_frameRequestedAt;     // First request since the last frame; -1 if none
+    qint64 m_frameAnsweredRequest; // Request the frame being swapped answers
+    double m_lastFrameTimeMs;
+    double m_lastInputLatencyMs;
     
     // Viewport dimensions
     int m_viewportWidth;